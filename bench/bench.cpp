@@ -0,0 +1,725 @@
+// solar-bench: micro-benchmarks of the hot paths, from a NOAA response
+// to a datagram on the wire:
+//   parse   - DOM vs JsonTailReader / FeedExtractor on every product, 5-minute/1-day/7-day sizes
+//   values  - scalar and time_tag parsing, full ingest into a TimeSeriesTable
+//   encode  - OSC bundles, typed and string, single values and sample batches
+//   send    - OSCSender to loopback receivers
+//   derived - vector kernels of derived.h against scalar libm loops, 7 days
+//
+// Fixtures are NOAA responses in bench/fixtures (or --fixtures DIR), named
+// like the NOAA files. Sizes that are not there are generated in the same
+// shape. Results go out as text, CSV or JSON; a JSON run can be passed back
+// as --baseline to compare two commits.
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#include "../derived.h"
+#include "../feed_schema.h"
+#include "../json_tail.h"
+#include "../logger.h"
+#include "../osc.h"
+#include "../timeseries.h"
+
+using json = nlohmann::json;
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+#ifndef SOLAR_BENCH_FIXTURES
+#define SOLAR_BENCH_FIXTURES "bench/fixtures"
+#endif
+
+// Heap accounting: every allocation in the process goes through here
+static size_t allocCount = 0;
+static size_t allocBytes = 0;
+
+void* operator new(size_t size) {
+    ++allocCount;
+    allocBytes += size;
+    if (void* p = std::malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// NOAA-shaped product: header row + one row per minute
+static std::string makePlasma(int rows) {
+    std::string out = "[[\"time_tag\",\"density\",\"speed\",\"temperature\"]";
+    char row[128];
+    for (int i = 0; i < rows; ++i) {
+        snprintf(row, sizeof(row), ",[\"2024-05-%02d %02d:%02d:00.000\",\"%.2f\",\"%.1f\",\"%d\"]",
+                 1 + i / 1440, (i / 60) % 24, i % 60, 1.0 + (i % 50) * 0.1, 350.0 + (i % 300), 50000 + i);
+        out += row;
+    }
+    return out + "]";
+}
+
+static std::string makeMag(int rows) {
+    std::string out = "[[\"time_tag\",\"bx_gsm\",\"by_gsm\",\"bz_gsm\",\"lon_gsm\",\"lat_gsm\",\"bt\"]";
+    char row[160];
+    for (int i = 0; i < rows; ++i) {
+        snprintf(row, sizeof(row),
+                 ",[\"2024-05-%02d %02d:%02d:00.000\",\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\"]",
+                 1 + i / 1440, (i / 60) % 24, i % 60, -2.0 + (i % 7), 1.5, -3.0 + (i % 5), 120.0 + i % 90,
+                 10.0, 6.5);
+        out += row;
+    }
+    return out + "]";
+}
+
+static std::string fixtureDir = SOLAR_BENCH_FIXTURES;
+
+// Fixture file, or the generated body if the file is not there
+static std::string loadFixture(const std::string& name, std::string (*generate)(int), int rows) {
+    std::ifstream in(fixtureDir + "/" + name, std::ios::binary);
+    if (in) {
+        std::stringstream body;
+        body << in.rdbuf();
+        return body.str();
+    }
+    if (!generate) {
+        fprintf(stderr, "missing fixture %s/%s\n", fixtureDir.c_str(), name.c_str());
+        exit(2);
+    }
+    return generate(rows);
+}
+
+struct Result {
+    std::string group;
+    std::string name;
+    size_t inputBytes = 0;     // bytes consumed per op (response body, values)
+    size_t outputBytes = 0;    // bytes produced per op (OSC packets)
+    uint64_t iterations = 0;
+    double nsPerOp = 0.0;      // median of the timed batches
+    double allocsPerOp = 0.0;
+    double allocBytesPerOp = 0.0;
+
+    double opsPerSecond() const { return nsPerOp > 0.0 ? 1e9 / nsPerOp : 0.0; }
+    double megabytesPerSecond() const { return inputBytes * opsPerSecond() / 1e6; }
+};
+
+static double minTimeMs = 300.0;
+static std::string filter;
+static std::vector<Result> results;
+static volatile float sink;
+
+// Calibrates the batch size to ~1/5 of the time budget, then times five
+// batches and keeps the median, which shrugs off a preempted batch
+template <typename F>
+static void measure(const char* group, const std::string& name, size_t inputBytes, size_t outputBytes,
+                    F&& op) {
+    std::string fullName = std::string(group) + "/" + name;
+    if (!filter.empty() && fullName.find(filter) == std::string::npos) return;
+
+    op();  // warm up
+    uint64_t batch = 1;
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; ++i) op();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (ms >= minTimeMs / 50 || batch >= (1u << 30)) {
+            double perOp = ms / batch;
+            batch = std::max<uint64_t>(1, (uint64_t)(minTimeMs / 5 / std::max(perOp, 1e-6)));
+            break;
+        }
+        batch *= 10;
+    }
+
+    const int batches = 5;
+    double samples[batches];
+    size_t count0 = allocCount, bytes0 = allocBytes;
+    for (int b = 0; b < batches; ++b) {
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < batch; ++i) op();
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        samples[b] = std::chrono::duration<double, std::nano>(elapsed).count() / batch;
+    }
+    std::sort(samples, samples + batches);
+
+    Result r;
+    r.group = group;
+    r.name = name;
+    r.inputBytes = inputBytes;
+    r.outputBytes = outputBytes;
+    r.iterations = batch * batches;
+    r.nsPerOp = samples[batches / 2];
+    r.allocsPerOp = double(allocCount - count0) / r.iterations;
+    r.allocBytesPerOp = double(allocBytes - bytes0) / r.iterations;
+    results.push_back(r);
+}
+
+// ---- parse ----
+
+static void benchTailProduct(const std::string& label, const std::string& body,
+                             std::initializer_list<const char*> names, std::initializer_list<int> indices) {
+    measure("parse", label + " dom", body.size(), 0, [&]() {
+        json parsed = json::parse(body);
+        auto latest = parsed[parsed.size() - 1];
+        float total = 0.0f;
+        for (int index : indices) total += std::stof(latest[index].get<std::string>());
+        sink = total;
+    });
+
+    measure("parse", label + " tail", body.size(), 0, [&]() {
+        JsonTailReader reader(body);
+        reader.selectColumns(names);
+        float total = 0.0f;
+        if (reader.previousRow()) {
+            for (size_t i = 0; i < reader.columnCount(); ++i) {
+                float v = 0.0f;
+                jsonScalarToFloat(reader.column(i), v);
+                total += v;
+            }
+        }
+        sink = total;
+    });
+}
+
+// The probabilities and regions feeds through a DOM, for comparison with the
+// schema lines below
+static void benchObjectProducts(const std::string& probabilities, const std::string& regions) {
+    measure("parse", "probabilities dom", probabilities.size(), 0, [&]() {
+        json parsed = json::parse(probabilities);
+        const json& today = parsed[0];
+        sink = (float)(today["m_class_1_day"].get<int>() + today["x_class_1_day"].get<int>());
+    });
+
+    measure("parse", "regions dom", regions.size(), 0, [&]() {
+        json parsed = json::parse(regions);
+        std::string latestDate;
+        for (const auto& region : parsed) {
+            std::string date = region.value("observed_date", std::string());
+            if (date > latestDate) latestDate = date;
+        }
+        int count = 0;
+        for (const auto& region : parsed) {
+            if (region.value("observed_date", std::string()) == latestDate) ++count;
+        }
+        sink = (float)count;
+    });
+}
+
+// FeedExtractor on a steady-state poll: the newest values, no rows newer
+// than the history. Fields are laid out as in main.cpp's schema.
+static void benchSchema(const std::string& plasma, const std::string& probabilities, const std::string& regions) {
+    static const FieldSpec fields[] = {
+        {"density", "density", FieldType::Float, 3, noOscAddress, noOscAddress, noOscAddress},
+        {"speed", "speed", FieldType::Float, 2, noOscAddress, noOscAddress, noOscAddress},
+        {"temperature", "temperature", FieldType::Float, 3, noOscAddress, noOscAddress, noOscAddress},
+        {"m_class", "m_class_1_day", FieldType::Int, 0, noOscAddress, noOscAddress, noOscAddress},
+        {"x_class", "x_class_1_day", FieldType::Int, 0, noOscAddress, noOscAddress, noOscAddress},
+        {"regions", "observed_date", FieldType::Int, 0, noOscAddress, noOscAddress, noOscAddress},
+    };
+    struct Product {
+        const char* label;
+        FeedSpec spec;
+        const std::string& body;
+    };
+    const Product products[] = {
+        {"plasma 1-day schema", {"solar wind", "", FeedShape::Table, 60, 120, 0, 3, nullptr}, plasma},
+        {"probabilities schema", {"solar probabilities", "", FeedShape::FirstObject, 60, 120, 3, 2, nullptr},
+         probabilities},
+        {"regions schema", {"solar regions", "", FeedShape::LatestCount, 60, 120, 5, 1, nullptr}, regions},
+    };
+    for (const Product& product : products) {
+        FeedExtractor extractor(product.spec, fields);
+        FeedValues latest;
+        std::vector<FeedRow> rows;
+        extractor.extract(product.body, 0, 1, latest, rows);
+        int64_t since = latest.time;
+        measure("parse", product.label, product.body.size(), 0, [&]() {
+            extractor.extract(product.body, since, 1440, latest, rows);
+            sink = latest.values[0];
+        });
+    }
+}
+
+// ---- values ----
+
+static void benchValues(const std::string& plasmaDay) {
+    static const char* numbers[] = {"4.21", "437.5", "98765", "-3.47", "1.5e2", "null"};
+    size_t numberBytes = 0;
+    JsonScalar scalars[6];
+    for (int i = 0; i < 6; ++i) {
+        scalars[i].type = JsonScalar::String;
+        scalars[i].data = numbers[i];
+        scalars[i].size = strlen(numbers[i]);
+        numberBytes += scalars[i].size;
+    }
+    measure("values", "jsonScalarToFloat x6", numberBytes, 0, [&]() {
+        float total = 0.0f, v;
+        for (const JsonScalar& s : scalars) {
+            if (jsonScalarToFloat(s, v)) total += v;
+        }
+        sink = total;
+    });
+
+    measure("values", "std::stof x5", numberBytes - 4, 0, [&]() {
+        float total = 0.0f;
+        for (int i = 0; i < 5; ++i) total += std::stof(std::string(scalars[i].data, scalars[i].size));
+        sink = total;
+    });
+
+    static const char timeTag[] = "2024-05-10 16:55:00.000";
+    measure("values", "parseTimeTag", sizeof(timeTag) - 1, 0, [&]() {
+        int64_t seconds = 0;
+        parseTimeTag(timeTag, sizeof(timeTag) - 1, seconds);
+        sink = (float)seconds;
+    });
+
+    // Cold start of the solar wind feed: every row of a day lands in the table
+    TimeSeriesTable table(2048, 3);
+    measure("values", "ingest plasma 1-day", plasmaDay.size(), 0, [&]() {
+        table = TimeSeriesTable(2048, 3);
+        JsonTailReader reader(plasmaDay);
+        reader.selectColumns({"time_tag", "density", "speed", "temperature"});
+        int64_t times[1440];
+        float values[1440][3];
+        size_t n = 0;
+        while (n < 1440 && reader.previousRow()) {
+            const JsonScalar& tag = reader.column(0);
+            if (!parseTimeTag(tag.data, tag.size, times[n])) continue;
+            for (size_t f = 0; f < 3; ++f) {
+                if (!jsonScalarToFloat(reader.column(f + 1), values[n][f])) values[n][f] = NAN;
+            }
+            ++n;
+        }
+        for (size_t i = n; i-- > 0;) table.append(times[i], values[i]);
+        sink = (float)table.size();
+    });
+}
+
+// ---- encode ----
+
+constexpr auto densAddress = oscAddress("/dens");
+constexpr auto speedAddress = oscAddress("/speed");
+constexpr auto tempAddress = oscAddress("/temp");
+constexpr auto densSampleAddress = oscAddress("/dens/sample");
+constexpr auto speedSampleAddress = oscAddress("/speed/sample");
+constexpr auto tempSampleAddress = oscAddress("/temp/sample");
+
+// One solar wind update, address and type tag encoded per value
+static size_t encodeUpdate(OSCValueMode mode) {
+    OSCBundle bundle(mode, oscTimetagFromUnix(1715360100));
+    bundle.addFloat(densAddress, 4.21f, 3);
+    bundle.addFloat(speedAddress, 437.5f, 2);
+    bundle.addFloat(tempAddress, 98765.0f, 3);
+    return bundle.size();
+}
+
+// The same with headers encoded once, as sendLatestValues does
+static size_t encodeUpdateHeaders(const OSCMessageHeader* headers) {
+    OSCBundle bundle(headers[0].mode(), oscTimetagFromUnix(1715360100));
+    bundle.add(headers[0], 4.21f, 3);
+    bundle.add(headers[1], 437.5f, 2);
+    bundle.add(headers[2], 98765.0f, 3);
+    return bundle.size();
+}
+
+// sendNewSamples for one hour of plasma rows: 60 x 3 samples over several bundles
+static size_t encodeSamples(OSCValueMode mode, size_t* packets) {
+    static const OSCAddressView addresses[] = {densSampleAddress, speedSampleAddress, tempSampleAddress};
+    OSCBundle bundle(mode, oscTimetagFromUnix(1715360100));
+    size_t bytes = 0;
+    *packets = 0;
+    for (int row = 0; row < 60; ++row) {
+        uint64_t timetag = oscTimetagFromUnix(1715356500 + row * 60);
+        float values[3] = {4.0f + row * 0.01f, 420.0f + row, 90000.0f + row * 10};
+        for (int f = 0; f < 3; ++f) {
+            if (!bundle.addSample(addresses[f], timetag, values[f], 3)) {
+                bytes += bundle.size();
+                ++*packets;
+                bundle.clear();
+                bundle.addSample(addresses[f], timetag, values[f], 3);
+            }
+        }
+    }
+    ++*packets;
+    return bytes + bundle.size();
+}
+
+static void benchEncode() {
+    size_t packets = 0;
+    measure("encode", "update bundle typed", 3 * sizeof(float), encodeUpdate(OSCValueMode::Typed),
+            [&]() { sink = (float)encodeUpdate(OSCValueMode::Typed); });
+    measure("encode", "update bundle string", 3 * sizeof(float), encodeUpdate(OSCValueMode::String),
+            [&]() { sink = (float)encodeUpdate(OSCValueMode::String); });
+    for (OSCValueMode mode : {OSCValueMode::Typed, OSCValueMode::String}) {
+        const OSCMessageHeader headers[] = {
+            OSCMessageHeader(densAddress, OSCMessageHeader::Float, mode),
+            OSCMessageHeader(speedAddress, OSCMessageHeader::Float, mode),
+            OSCMessageHeader(tempAddress, OSCMessageHeader::Float, mode),
+        };
+        std::string name = mode == OSCValueMode::Typed ? "update headers typed" : "update headers string";
+        measure("encode", name, 3 * sizeof(float), encodeUpdateHeaders(headers),
+                [&]() { sink = (float)encodeUpdateHeaders(headers); });
+    }
+    measure("encode", "samples 60x3 typed", 180 * sizeof(float), encodeSamples(OSCValueMode::Typed, &packets),
+            [&]() { sink = (float)encodeSamples(OSCValueMode::Typed, &packets); });
+    measure("encode", "samples 60x3 string", 180 * sizeof(float), encodeSamples(OSCValueMode::String, &packets),
+            [&]() { sink = (float)encodeSamples(OSCValueMode::String, &packets); });
+}
+
+// ---- send ----
+
+// UDP socket on an ephemeral loopback port, drained by its own thread so
+// the sender never runs into a full receive buffer
+class LoopbackReceiver {
+public:
+    LoopbackReceiver() {
+        fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        timeval timeout = {0, 100000};
+        setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (fd_ < 0 || bind(fd_, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+            getsockname(fd_, (sockaddr*)&addr, &len) != 0) {
+            perror("loopback receiver");
+            exit(2);
+        }
+        port_ = ntohs(addr.sin_port);
+        thread_ = std::thread([this]() {
+            char buffer[2048];
+            while (!stop_) {
+                if (recv(fd_, buffer, sizeof(buffer), 0) > 0) ++received_;
+            }
+        });
+    }
+
+    ~LoopbackReceiver() {
+        stop_ = true;
+        thread_.join();
+        close(fd_);
+    }
+
+    int port() const { return port_; }
+    uint64_t received() const { return received_; }
+
+private:
+    int fd_;
+    int port_ = 0;
+    std::atomic<bool> stop_{false};
+    std::atomic<uint64_t> received_{0};
+    std::thread thread_;
+};
+
+static void benchSend() {
+    OSCBundle bundle(OSCValueMode::Typed, oscTimetagFromUnix(1715360100));
+    bundle.addFloat(densAddress, 4.21f, 3);
+    bundle.addFloat(speedAddress, 437.5f, 2);
+    bundle.addFloat(tempAddress, 98765.0f, 3);
+
+    for (int destinations : {1, 4}) {
+        std::vector<std::unique_ptr<LoopbackReceiver>> receivers;
+        OSCSender sender;
+        for (int i = 0; i < destinations; ++i) {
+            receivers.push_back(std::unique_ptr<LoopbackReceiver>(new LoopbackReceiver));
+            sender.addDestination("127.0.0.1", receivers.back()->port());
+        }
+        std::string name = "update bundle x" + std::to_string(destinations) + " dest";
+        measure("send", name, 0, bundle.size() * destinations, [&]() { sink = (float)sender.send(bundle); });
+    }
+}
+
+// ---- output ----
+
+static void printText() {
+    printf("%-36s %9s %12s %12s %9s %10s %8s %9s\n", "benchmark", "in B", "ns/op", "ops/s", "MB/s",
+           "allocs/op", "B/op", "out B/op");
+    std::string group;
+    for (const Result& r : results) {
+        if (r.group != group) {
+            group = r.group;
+            printf("-- %s\n", group.c_str());
+        }
+        printf("%-36s %9zu %12.1f %12.0f %9.1f %10.1f %8.0f %9zu\n", r.name.c_str(), r.inputBytes, r.nsPerOp,
+               r.opsPerSecond(), r.megabytesPerSecond(), r.allocsPerOp, r.allocBytesPerOp, r.outputBytes);
+    }
+}
+
+static void printCsv() {
+    printf("group,name,input_bytes,output_bytes,iterations,ns_per_op,ops_per_sec,mb_per_sec,"
+           "allocs_per_op,alloc_bytes_per_op\n");
+    for (const Result& r : results) {
+        printf("%s,%s,%zu,%zu,%llu,%.2f,%.1f,%.3f,%.3f,%.1f\n", r.group.c_str(), r.name.c_str(), r.inputBytes,
+               r.outputBytes, (unsigned long long)r.iterations, r.nsPerOp, r.opsPerSecond(),
+               r.megabytesPerSecond(), r.allocsPerOp, r.allocBytesPerOp);
+    }
+}
+
+static json resultsJson(const std::string& label) {
+    json out;
+    out["label"] = label;
+    out["results"] = json::array();
+    for (const Result& r : results) {
+        out["results"].push_back({{"group", r.group},
+                                  {"name", r.name},
+                                  {"input_bytes", r.inputBytes},
+                                  {"output_bytes", r.outputBytes},
+                                  {"iterations", r.iterations},
+                                  {"ns_per_op", r.nsPerOp},
+                                  {"ops_per_sec", r.opsPerSecond()},
+                                  {"mb_per_sec", r.megabytesPerSecond()},
+                                  {"allocs_per_op", r.allocsPerOp},
+                                  {"alloc_bytes_per_op", r.allocBytesPerOp}});
+    }
+    return out;
+}
+
+// Prints the change against an earlier JSON run (to stderr, so the run's own
+// output stays machine-readable). Returns false if anything got slower than
+// the threshold or started allocating more.
+static bool compareWithBaseline(const std::string& path, double maxRegressionPercent) {
+    std::ifstream in(path);
+    json baseline;
+    try {
+        in >> baseline;
+    } catch (const std::exception& e) {
+        fprintf(stderr, "cannot read baseline %s: %s\n", path.c_str(), e.what());
+        return false;
+    }
+
+    std::map<std::string, json> previous;
+    for (const json& r : baseline["results"]) {
+        previous[r["group"].get<std::string>() + "/" + r["name"].get<std::string>()] = r;
+    }
+
+    bool ok = true;
+    fprintf(stderr, "\ncompared with %s (%s)\n", path.c_str(), baseline.value("label", std::string()).c_str());
+    for (const Result& r : results) {
+        std::string key = r.group + "/" + r.name;
+        auto it = previous.find(key);
+        if (it == previous.end()) continue;
+        double oldNs = it->second["ns_per_op"].get<double>();
+        double oldAllocs = it->second["allocs_per_op"].get<double>();
+        double change = oldNs > 0.0 ? (r.nsPerOp / oldNs - 1.0) * 100.0 : 0.0;
+        bool regressed = change > maxRegressionPercent || r.allocsPerOp > oldAllocs + 0.01;
+        if (regressed) ok = false;
+        fprintf(stderr, "%-44s %12.1f -> %12.1f ns/op %+7.1f%%  allocs %.1f -> %.1f%s\n", key.c_str(), oldNs,
+                r.nsPerOp, change, oldAllocs, r.allocsPerOp, regressed ? "  REGRESSION" : "");
+    }
+    return ok;
+}
+
+// ---- derived ----
+
+static void benchDerived() {
+    const size_t n = 7 * 24 * 60;
+    std::vector<float> density(n), speed(n), bt(n), bz(n), by(n), lon(n);
+    for (size_t i = 0; i < n; ++i) {
+        density[i] = 1.0f + (i % 50) * 0.1f;
+        speed[i] = 350.0f + (i % 300);
+        bt[i] = 4.0f + (i % 9);
+        bz[i] = -3.0f + (i % 7);
+        by[i] = -2.0f + (i % 5);
+        lon[i] = (float)(i % 360);
+    }
+    std::vector<float> out(n), sinHalf(n), transverse(n);
+    size_t columnBytes = n * sizeof(float);
+
+    measure("derived", "pressure 7-day", 2 * columnBytes, columnBytes, [&]() {
+        dynamicPressure(density.data(), speed.data(), out.data(), n);
+        sink = out[n - 1];
+    });
+    measure("derived", "pressure 7-day scalar", 2 * columnBytes, columnBytes, [&]() {
+        for (size_t i = 0; i < n; ++i) out[i] = 1.6726e-6f * density[i] * std::pow(speed[i], 2.0f);
+        sink = out[n - 1];
+    });
+
+    measure("derived", "clock angle 7-day", 2 * columnBytes, 2 * columnBytes, [&]() {
+        clockAngle(by.data(), bz.data(), sinHalf.data(), transverse.data(), n);
+        sink = sinHalf[n - 1];
+    });
+    measure("derived", "newell 7-day", 3 * columnBytes, columnBytes, [&]() {
+        newellCoupling(speed.data(), transverse.data(), sinHalf.data(), out.data(), n);
+        sink = out[n - 1];
+    });
+    // The textbook form: atan2, then fractional powers per row
+    measure("derived", "clock angle + newell 7-day scalar", 3 * columnBytes, columnBytes, [&]() {
+        for (size_t i = 0; i < n; ++i) {
+            float theta = std::atan2(by[i], bz[i]);
+            float b = std::sqrt(by[i] * by[i] + bz[i] * bz[i]);
+            out[i] = std::pow(speed[i], 4.0f / 3.0f) * std::pow(b, 2.0f / 3.0f) *
+                     std::pow(std::fabs(std::sin(theta / 2.0f)), 8.0f / 3.0f);
+        }
+        sink = out[n - 1];
+    });
+    measure("derived", "epsilon 7-day", 3 * columnBytes, columnBytes, [&]() {
+        akasofuEpsilon(speed.data(), bt.data(), sinHalf.data(), out.data(), n);
+        sink = out[n - 1];
+    });
+
+    measure("derived", "stats 7-day", columnBytes, 0, [&]() {
+        sink = columnStats(speed.data(), n).std;
+    });
+    measure("derived", "stats 7-day scalar", columnBytes, 0, [&]() {
+        double sum = 0.0, squares = 0.0;
+        float lo = speed[0], hi = speed[0];
+        for (size_t i = 0; i < n; ++i) {
+            sum += speed[i];
+            lo = std::min(lo, speed[i]);
+            hi = std::max(hi, speed[i]);
+        }
+        double mean = sum / n;
+        for (size_t i = 0; i < n; ++i) squares += (speed[i] - mean) * (speed[i] - mean);
+        sink = (float)std::sqrt(squares / n) + lo + hi;
+    });
+
+    // What processFeed pays per new magnetometer row: copy, join and all windows
+    TimeSeriesTable plasma(n, 3), mag(n, 4);
+    for (size_t i = 0; i < n; ++i) {
+        const float p[] = {density[i], speed[i], 100000.0f};
+        const float m[] = {lon[i], bt[i], bz[i], by[i]};
+        plasma.append(1714521600 + (int64_t)i * 60, p);
+        mag.append(1714521600 + (int64_t)i * 60, m);
+    }
+    DerivedIndices indices({10, 60, 1440});
+    measure("derived", "update 10/60/1440 min", 0, 0, [&]() {
+        sink = indices.update(plasma, mag).newell;
+    });
+}
+
+// ---- log ----
+
+// The producer side of the logger. The writer drains the ring only every
+// 20 ms, so batches are kept below its capacity and the ring is emptied
+// between them (untimed); a plain measure() would time the ring-full path.
+static void benchLog() {
+    const char* name = "warning, text + 2 numbers";
+    if (!filter.empty() && (std::string("log/") + name).find(filter) == std::string::npos) return;
+
+    Logger log(4096);
+    LoggerOptions options;
+    options.terminal = false;
+    options.repeatWindowSeconds = 0;
+    log.start(options);
+
+    const int batch = 2048, batches = 25;
+    double samples[batches];
+    size_t allocs = 0, allocated = 0;
+    uint64_t pushed = 0;
+    for (int b = 0; b < batches; ++b) {
+        size_t count0 = allocCount, bytes0 = allocBytes;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < batch; ++i) {
+            LogLine(log, LogLevel::Warning, "bench") << "Fetch of " << "solar wind" << " failed: HTTP " << 500
+                                                    << ", retry in " << logFixed(1) << 2.5 << " s";
+        }
+        auto elapsed = std::chrono::steady_clock::now() - start;
+        samples[b] = std::chrono::duration<double, std::nano>(elapsed).count() / batch;
+        allocs += allocCount - count0;
+        allocated += allocBytes - bytes0;
+        pushed += batch;
+        while (log.written() + log.dropped() < pushed) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::sort(samples, samples + batches);
+    log.stop();
+
+    Result r;
+    r.group = "log";
+    r.name = name;
+    r.iterations = (uint64_t)batch * batches;
+    r.nsPerOp = samples[batches / 2];
+    r.allocsPerOp = double(allocs) / r.iterations;
+    r.allocBytesPerOp = double(allocated) / r.iterations;
+    results.push_back(r);
+}
+
+static void usage() {
+    fprintf(stderr,
+            "usage: solar-bench [--format text|csv|json] [--filter SUBSTR] [--min-time MS]\n"
+            "                   [--fixtures DIR] [--label TEXT] [--baseline FILE.json]\n"
+            "                   [--max-regression PERCENT]\n");
+}
+
+int main(int argc, char* argv[]) {
+    std::string format = "text";
+    std::string label;
+    std::string baselinePath;
+    double maxRegression = 10.0;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--format" && hasValue) {
+            format = argv[++i];
+        } else if (arg == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && hasValue) {
+            minTimeMs = std::max(1.0, atof(argv[++i]));
+        } else if (arg == "--fixtures" && hasValue) {
+            fixtureDir = argv[++i];
+        } else if (arg == "--label" && hasValue) {
+            label = argv[++i];
+        } else if (arg == "--baseline" && hasValue) {
+            baselinePath = argv[++i];
+        } else if (arg == "--max-regression" && hasValue) {
+            maxRegression = atof(argv[++i]);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (format != "text" && format != "csv" && format != "json") {
+        usage();
+        return 2;
+    }
+
+    // NOAA publishes plasma and mag in 5-minute, 2-hour, 1-day and 7-day
+    // files at one row per minute; Kp, probabilities and regions come in one size
+    struct Size { const char* name; int rows; };
+    const Size sizes[] = {{"5-minute", 6}, {"1-day", 1440}, {"7-day", 10080}};
+    for (const Size& size : sizes) {
+        std::string plasma = loadFixture(std::string("plasma-") + size.name + ".json", makePlasma, size.rows);
+        std::string mag = loadFixture(std::string("mag-") + size.name + ".json", makeMag, size.rows);
+        benchTailProduct(std::string("plasma ") + size.name, plasma, {"density", "speed", "temperature"},
+                         {1, 2, 3});
+        benchTailProduct(std::string("mag ") + size.name, mag, {"lon_gsm", "bt", "bz_gsm"}, {4, 6, 3});
+    }
+    std::string kp = loadFixture("noaa-planetary-k-index.json", nullptr, 0);
+    benchTailProduct("kp", kp, {"Kp"}, {1});
+    benchObjectProducts(loadFixture("solar_probabilities.json", nullptr, 0),
+                        loadFixture("solar_regions.json", nullptr, 0));
+    benchSchema(loadFixture("plasma-1-day.json", makePlasma, 1440), loadFixture("solar_probabilities.json", nullptr, 0),
+                loadFixture("solar_regions.json", nullptr, 0));
+
+    benchValues(loadFixture("plasma-1-day.json", makePlasma, 1440));
+    benchEncode();
+    benchSend();
+    benchDerived();
+    benchLog();
+
+    if (format == "json") {
+        printf("%s\n", resultsJson(label).dump(2).c_str());
+    } else if (format == "csv") {
+        printCsv();
+    } else {
+        printText();
+    }
+
+    fflush(stdout);
+    if (!baselinePath.empty() && !compareWithBaseline(baselinePath, maxRegression)) return 1;
+    return 0;
+}
@@ -0,0 +1,296 @@
+#include "derived.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+// Four float lanes; the compiler maps these to SSE2 or NEON registers
+typedef float float4 __attribute__((vector_size(16)));
+typedef int32_t int4 __attribute__((vector_size(16)));
+
+// Loads up to four values; missing lanes are set to fill. The full case is
+// a fixed-size copy, i.e. one unaligned vector load.
+static inline float4 load4(const float* p, size_t lanes, float fill = 0.0f) {
+    float4 v;
+    if (lanes == 4) {
+        memcpy(&v, p, sizeof(v));
+    } else {
+        v = float4{fill, fill, fill, fill};
+        for (size_t i = 0; i < lanes; ++i) v[i] = p[i];
+    }
+    return v;
+}
+
+static inline void store4(float* p, float4 v, size_t lanes) {
+    if (lanes == 4) {
+        memcpy(p, &v, sizeof(v));
+    } else {
+        for (size_t i = 0; i < lanes; ++i) p[i] = v[i];
+    }
+}
+
+static inline float4 splat4(float x) {
+    return float4{x, x, x, x};
+}
+
+static inline float4 select4(int4 mask, float4 a, float4 b) {
+    return (float4)((mask & (int4)a) | (~mask & (int4)b));
+}
+
+// Calls kernel(i, lanes) over [0, n): whole vectors, then one partial one,
+// so the main loop sees a constant lane count
+template <typename Kernel>
+static inline void forEachVector(size_t n, Kernel kernel) {
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) kernel(i, (size_t)4);
+    if (i < n) kernel(i, n - i);
+}
+
+// 1/sqrt(x): bit-level estimate refined by two Newton steps, about 1e-7
+// relative error. Finite for x = 0, so x * rsqrt4(x) gives 0 there.
+static inline float4 rsqrt4(float4 x) {
+    float4 y = (float4)(0x5f375a86 - ((int4)x >> 1));
+    y = y * (1.5f - 0.5f * x * y * y);
+    y = y * (1.5f - 0.5f * x * y * y);
+    return y;
+}
+
+// Cube root for x >= 0: exponent-third estimate, then three Newton steps
+static inline float4 cbrt4(float4 x) {
+    float4 y = (float4)((int4)x / 3 + 0x2a5137a0);
+    y = (2.0f * y + x / (y * y)) * (1.0f / 3.0f);
+    y = (2.0f * y + x / (y * y)) * (1.0f / 3.0f);
+    y = (2.0f * y + x / (y * y)) * (1.0f / 3.0f);
+    return select4(x == 0.0f, splat4(0.0f), y);
+}
+
+// Cadence of the magnetometer product, for a southward run with no row before it
+static const int64_t defaultRowSeconds = 60;
+
+// m_p * 1e6 cm^-3 * (1e3 m/s)^2 in nPa
+static const float pressureFactor = 1.6726e-6f;
+// (4 pi / mu0) * (7 R_E)^2 * 1e3 (km/s) * 1e-18 (nT^2) in W, then GW
+static const float epsilonFactor = 1.98889e7f / 1e9f;
+
+void dynamicPressure(const float* density, const float* speed, float* out, size_t n) {
+    forEachVector(n, [&](size_t i, size_t lanes) {
+        float4 v = load4(speed + i, lanes);
+        store4(out + i, pressureFactor * load4(density + i, lanes) * v * v, lanes);
+    });
+}
+
+void clockAngle(const float* by, const float* bz, float* sinHalfSquared, float* transverse, size_t n) {
+    forEachVector(n, [&](size_t i, size_t lanes) {
+        float4 y = load4(by + i, lanes);
+        float4 z = load4(bz + i, lanes);
+        float4 ySquared = y * y;
+        float4 yzSquared = ySquared + z * z;
+        float4 inverse = rsqrt4(yzSquared);
+        float4 yz = yzSquared * inverse;
+
+        // sin^2(theta/2) = (1 - Bz/B_yz) / 2; for northward Bz the same as
+        // By^2 / (2 B_yz (B_yz + Bz)), which does not cancel near theta = 0
+        float4 s = select4(z > 0.0f, 0.5f * ySquared * inverse / (yz + z), 0.5f * (1.0f - z * inverse));
+        s = select4(yzSquared != 0.0f, s, splat4(0.0f));
+        store4(sinHalfSquared + i, s, lanes);
+        store4(transverse + i, yz, lanes);
+    });
+}
+
+void newellCoupling(const float* speed, const float* transverse, const float* sinHalfSquared, float* out, size_t n) {
+    // v^4/3 B^2/3 (s)^4/3 = v s (v B^2 s)^1/3 with s = sin^2(theta/2)
+    forEachVector(n, [&](size_t i, size_t lanes) {
+        float4 v = load4(speed + i, lanes);
+        float4 b = load4(transverse + i, lanes);
+        float4 s = load4(sinHalfSquared + i, lanes);
+        store4(out + i, v * s * cbrt4(v * b * b * s), lanes);
+    });
+}
+
+void akasofuEpsilon(const float* speed, const float* bt, const float* sinHalfSquared, float* out, size_t n) {
+    forEachVector(n, [&](size_t i, size_t lanes) {
+        float4 b = load4(bt + i, lanes);
+        float4 s = load4(sinHalfSquared + i, lanes);
+        store4(out + i, epsilonFactor * load4(speed + i, lanes) * b * b * s * s, lanes);
+    });
+}
+
+ColumnStats columnStats(const float* values, size_t n) {
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float infinity = std::numeric_limits<float>::infinity();
+    float4 sum = splat4(0.0f);
+    float4 lo = splat4(infinity);
+    float4 hi = splat4(-infinity);
+    int4 count = {0, 0, 0, 0};
+
+    // NaN lanes (gaps, and the padding of the last load) are masked out
+    forEachVector(n, [&](size_t i, size_t lanes) {
+        float4 v = load4(values + i, lanes, nan);
+        int4 valid = v == v;
+        sum += select4(valid, v, splat4(0.0f));
+        lo = select4(valid & (v < lo), v, lo);
+        hi = select4(valid & (v > hi), v, hi);
+        count -= valid;
+    });
+
+    ColumnStats stats;
+    double total = 0.0;
+    for (int lane = 0; lane < 4; ++lane) {
+        stats.count += (size_t)count[lane];
+        total += sum[lane];
+    }
+    if (stats.count == 0) return stats;
+    stats.min = std::min(std::min(lo[0], lo[1]), std::min(lo[2], lo[3]));
+    stats.max = std::max(std::max(hi[0], hi[1]), std::max(hi[2], hi[3]));
+    stats.mean = (float)(total / stats.count);
+
+    // Second pass around the mean: no cancellation for large offsets such as speed
+    float4 mean = splat4(stats.mean);
+    float4 squares = splat4(0.0f);
+    forEachVector(n, [&](size_t i, size_t lanes) {
+        float4 v = load4(values + i, lanes, nan);
+        float4 d = v - mean;
+        squares += select4(v == v, d * d, splat4(0.0f));
+    });
+    double variance = ((double)squares[0] + squares[1] + squares[2] + squares[3]) / stats.count;
+    stats.std = (float)std::sqrt(variance);
+    return stats;
+}
+
+const char* DerivedIndices::seriesName(Series series) {
+    static const char* names[SeriesCount] = {"dens", "speed", "bt", "bzGSM", "pdyn", "newell", "epsilon"};
+    return names[series];
+}
+
+DerivedIndices::DerivedIndices(const std::vector<int>& windowMinutes, float southThreshold)
+    : windows_(windowMinutes), southThreshold_(southThreshold), maxWindowSeconds_(60) {
+    for (int minutes : windows_) maxWindowSeconds_ = std::max(maxWindowSeconds_, minutes * 60);
+}
+
+// Copies one table's rows with time >= since into times and the given columns
+static size_t copyColumns(const TimeSeriesTable& table, int64_t since, std::vector<int64_t>& times,
+                          std::vector<float>* const* columns, const size_t* fields, size_t count) {
+    size_t capacity = table.size();
+    times.resize(std::max(times.size(), capacity));
+    size_t rows = 0;
+    for (size_t c = 0; c < count; ++c) {
+        std::vector<float>& column = *columns[c];
+        column.resize(std::max(column.size(), capacity));
+        rows = table.copyWindow(fields[c], since, c == 0 ? times.data() : nullptr, column.data(), capacity);
+    }
+    return rows;
+}
+
+// Rows [begin, end) of a sorted time column with time >= since
+static size_t windowStart(const std::vector<int64_t>& times, size_t rows, int64_t since) {
+    return std::lower_bound(times.begin(), times.begin() + rows, since) - times.begin();
+}
+
+DerivedIndices::Result DerivedIndices::update(const TimeSeriesTable& plasma, const TimeSeriesTable& mag) {
+    Result result;
+    result.stats.assign(windows_.size() * SeriesCount, ColumnStats());
+    if (plasma.size() == 0 && mag.size() == 0) return result;
+
+    // Windows end at the newest row of either product
+    int64_t newest = std::max(plasma.watermark(), mag.watermark());
+    int64_t since = newest - maxWindowSeconds_ + 1;
+
+    std::vector<float>* plasmaColumns[] = {&density_, &speed_};
+    const size_t plasmaFields[] = {0, 1};
+    size_t plasmaRows = plasma.size() ? copyColumns(plasma, since, plasmaTimes_, plasmaColumns, plasmaFields, 2) : 0;
+    std::vector<float>* magColumns[] = {&bt_, &bz_, &by_};
+    const size_t magFields[] = {1, 2, 3};
+    size_t magRows = mag.size() ? copyColumns(mag, since, magTimes_, magColumns, magFields, 3) : 0;
+
+    pressure_.resize(std::max(pressure_.size(), plasmaRows));
+    dynamicPressure(density_.data(), speed_.data(), pressure_.data(), plasmaRows);
+    if (plasmaRows && !std::isnan(pressure_[plasmaRows - 1])) {
+        result.pressureValid = true;
+        result.pressure = pressure_[plasmaRows - 1];
+    }
+
+    // Join the two products on time_tag (both sorted)
+    size_t joinCapacity = std::min(plasmaRows, magRows);
+    for (std::vector<float>* column : {&joinedSpeed_, &joinedBt_, &joinedBz_, &joinedBy_, &sinHalfSquared_,
+                                       &transverse_, &newell_, &epsilon_}) {
+        column->resize(std::max(column->size(), joinCapacity));
+    }
+    joinedTimes_.resize(std::max(joinedTimes_.size(), joinCapacity));
+    size_t joined = 0;
+    for (size_t p = 0, m = 0; p < plasmaRows && m < magRows;) {
+        if (plasmaTimes_[p] < magTimes_[m]) {
+            ++p;
+        } else if (magTimes_[m] < plasmaTimes_[p]) {
+            ++m;
+        } else {
+            joinedTimes_[joined] = plasmaTimes_[p];
+            joinedSpeed_[joined] = speed_[p];
+            joinedBt_[joined] = bt_[m];
+            joinedBz_[joined] = bz_[m];
+            joinedBy_[joined] = by_[m];
+            ++joined;
+            ++p;
+            ++m;
+        }
+    }
+
+    clockAngle(joinedBy_.data(), joinedBz_.data(), sinHalfSquared_.data(), transverse_.data(), joined);
+    newellCoupling(joinedSpeed_.data(), transverse_.data(), sinHalfSquared_.data(), newell_.data(), joined);
+    akasofuEpsilon(joinedSpeed_.data(), joinedBt_.data(), sinHalfSquared_.data(), epsilon_.data(), joined);
+    if (joined && !std::isnan(newell_[joined - 1]) && !std::isnan(epsilon_[joined - 1])) {
+        result.couplingValid = true;
+        result.newell = newell_[joined - 1];
+        result.epsilon = epsilon_[joined - 1];
+    }
+
+    // Southward run: walk back from the newest magnetometer row (the run may
+    // be longer than any window, so this reads the table itself). Each row
+    // stands for the interval up to it, so the run counts from the last row
+    // that was not southward; one that reaches the oldest stored row counts
+    // that row for one row interval.
+    int64_t runEnd = 0, runStart = 0, newerStart = 0, boundary = 0;
+    for (size_t i = mag.size(); i-- > 0;) {
+        float bz = mag.valueAt(2, i);
+        if (std::isnan(bz)) continue;
+        if (bz >= southThreshold_) {
+            if (runEnd) boundary = mag.timeAt(i);
+            break;
+        }
+        if (!runEnd) runEnd = mag.timeAt(i);
+        newerStart = runStart;
+        runStart = mag.timeAt(i);
+    }
+    for (size_t i = mag.size(); i-- > 0;) {
+        if (std::isnan(mag.valueAt(2, i))) continue;
+        result.southValid = true;
+        break;
+    }
+    if (boundary) {
+        result.southMinutes = (float)(runEnd - boundary) / 60.0f;
+    } else if (runEnd) {
+        int64_t interval = newerStart ? newerStart - runStart : defaultRowSeconds;
+        result.southMinutes = (float)(runEnd - runStart + interval) / 60.0f;
+    }
+
+    struct Source {
+        const std::vector<int64_t>* times;
+        size_t rows;
+        const float* values;
+    };
+    const Source sources[SeriesCount] = {
+        {&plasmaTimes_, plasmaRows, density_.data()}, {&plasmaTimes_, plasmaRows, speed_.data()},
+        {&magTimes_, magRows, bt_.data()},            {&magTimes_, magRows, bz_.data()},
+        {&plasmaTimes_, plasmaRows, pressure_.data()}, {&joinedTimes_, joined, newell_.data()},
+        {&joinedTimes_, joined, epsilon_.data()},
+    };
+    for (size_t w = 0; w < windows_.size(); ++w) {
+        int64_t windowSince = newest - windows_[w] * 60 + 1;
+        for (int s = 0; s < SeriesCount; ++s) {
+            const Source& source = sources[s];
+            size_t begin = windowStart(*source.times, source.rows, windowSince);
+            result.stats[w * SeriesCount + s] = columnStats(source.values + begin, source.rows - begin);
+        }
+    }
+    return result;
+}
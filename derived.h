@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "timeseries.h"
+
+// Column kernels over n contiguous rows, four lanes at a time (GCC/Clang
+// vector extensions: SSE2 on x86-64, NEON on ARM). A NaN in any input gives
+// NaN in the output.
+
+// Solar wind dynamic pressure in nPa from density (cm^-3) and speed (km/s)
+void dynamicPressure(const float* density, const float* speed, float* out, size_t n);
+
+// Clock-angle term shared by the coupling functions: sin^2(theta/2) with
+// theta = atan2(By, Bz) in GSM, and the transverse field sqrt(By^2 + Bz^2)
+void clockAngle(const float* by, const float* bz, float* sinHalfSquared, float* transverse, size_t n);
+
+// Newell et al. (2007) dPhi/dt = v^4/3 Bt^2/3 sin^8/3(theta/2), in
+// (km/s)^4/3 nT^2/3, with Bt the transverse field
+void newellCoupling(const float* speed, const float* transverse, const float* sinHalfSquared, float* out, size_t n);
+
+// Akasofu epsilon = (4 pi / mu0) v B^2 sin^4(theta/2) l0^2, l0 = 7 Earth
+// radii, in GW, with B the total field
+void akasofuEpsilon(const float* speed, const float* bt, const float* sinHalfSquared, float* out, size_t n);
+
+struct ColumnStats {
+    size_t count = 0;  // non-NaN values
+    float mean = 0.0f;
+    float std = 0.0f;  // population standard deviation
+    float min = 0.0f;
+    float max = 0.0f;
+};
+
+// NaN values are skipped; all zero if there are none
+ColumnStats columnStats(const float* values, size_t n);
+
+// Derived space-weather indices over the newest rows of the plasma
+// (density, speed, temperature) and magnetometer (lon_gsm, bt, bz_gsm, by_gsm)
+// tables. Rows of the two products are joined on time_tag. Column buffers
+// are kept between updates; a steady-state update only allocates its Result.
+class DerivedIndices {
+public:
+    enum Series { Density, Speed, Bt, BzGsm, Pressure, Newell, Epsilon, SeriesCount };
+    static const char* seriesName(Series series);
+
+    struct Result {
+        bool pressureValid = false;
+        bool couplingValid = false;  // newell and epsilon
+        float pressure = 0.0f;       // newest row
+        float newell = 0.0f;
+        float epsilon = 0.0f;
+        bool southValid = false;
+        float southMinutes = 0.0f;   // current southward-Bz run
+        // stats[w * SeriesCount + s] for windows()[w]
+        std::vector<ColumnStats> stats;
+    };
+
+    // Rolling statistics over each window (minutes)
+    explicit DerivedIndices(const std::vector<int>& windowMinutes, float southThreshold = 0.0f);
+
+    // Recomputes everything; the caller keeps the tables from changing
+    Result update(const TimeSeriesTable& plasma, const TimeSeriesTable& mag);
+
+    const std::vector<int>& windows() const { return windows_; }
+
+private:
+    std::vector<int> windows_;
+    float southThreshold_;
+    int maxWindowSeconds_;
+
+    // Plasma window
+    std::vector<int64_t> plasmaTimes_;
+    std::vector<float> density_, speed_, pressure_;
+    // Magnetometer window
+    std::vector<int64_t> magTimes_;
+    std::vector<float> by_, bt_, bz_;
+    // Joined on time_tag
+    std::vector<int64_t> joinedTimes_;
+    std::vector<float> joinedSpeed_, joinedBt_, joinedBz_, joinedBy_;
+    std::vector<float> sinHalfSquared_, transverse_, newell_, epsilon_;
+};
@@ -0,0 +1,152 @@
+#include "feed_schema.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "logger.h"
+
+// Gaps (null, "" or "null") leave the field unset; anything else that is
+// not a number (or a string holding one, "35") is reported
+static bool parseScalar(const JsonScalar& value, float& out) {
+    if (value.isNull()) return false;
+    if (jsonScalarToFloat(value, out)) return true;
+    logWarning("parse") << "Invalid value encountered: " << value.text();
+    return false;
+}
+
+// Byte order of two strings; an unset one sorts first
+static int compareText(const JsonScalar& a, const JsonScalar& b) {
+    if (!b.data) return a.data ? 1 : 0;
+    if (!a.data) return -1;
+    int order = memcmp(a.data, b.data, std::min(a.size, b.size));
+    if (order != 0) return order;
+    return a.size < b.size ? -1 : a.size > b.size ? 1 : 0;
+}
+
+// time_tag of the reader's current row (column 0)
+static bool rowTime(const JsonTailReader& reader, int64_t& time) {
+    const JsonScalar& timeTag = reader.column(0);
+    return timeTag.type == JsonScalar::String && parseTimeTag(timeTag.data, timeTag.size, time);
+}
+
+// Reads the newest row, then walks back to the newest row already stored
+template <>
+FeedExtractor::Status FeedExtractor::extractShape<FeedShape::Table>(const std::string& body, int64_t since,
+                                                                     size_t maxRows, FeedValues& latest,
+                                                                     std::vector<FeedRow>& rows) {
+    JsonTailReader reader(body);
+    if (!reader.selectColumns(columns_.data(), columns_.size(), columnCache_)) {
+        if (reader.empty()) return NoData;
+        error_ = reader.error();
+        return Malformed;
+    }
+    if (!reader.previousRow()) {
+        if (reader.ok()) return NoData;
+        error_ = reader.error();
+        return Malformed;
+    }
+
+    size_t fieldCount = columns_.size() - 1;
+    if (!rowTime(reader, latest.time)) latest.time = 0;
+    for (size_t f = 0; f < fieldCount; ++f) {
+        if (parseScalar(reader.column(f + 1), latest.values[f])) latest.validMask |= 1u << f;
+    }
+
+    do {
+        int64_t time;
+        if (!rowTime(reader, time)) continue;
+        if (time <= since || rows.size() >= maxRows) break;
+
+        FeedRow row;
+        row.time = time;
+        for (size_t f = 0; f < fieldCount; ++f) {
+            if (!jsonScalarToFloat(reader.column(f + 1), row.values[f])) {
+                row.values[f] = std::numeric_limits<float>::quiet_NaN();
+            }
+        }
+        rows.push_back(row);
+    } while (reader.previousRow());
+    // A broken row ends the walk like the start of the array does: returning
+    // the rows after it would move the watermark past the ones before it
+    if (!reader.ok()) {
+        error_ = reader.error();
+        rows.clear();
+        return Malformed;
+    }
+
+    std::reverse(rows.begin(), rows.end());
+    return Ok;
+}
+
+template <>
+FeedExtractor::Status FeedExtractor::extractShape<FeedShape::FirstObject>(const std::string& body, int64_t,
+                                                                           size_t, FeedValues& latest,
+                                                                           std::vector<FeedRow>&) {
+    JsonObjectReader reader(body, keyCache_);
+    if (!reader.nextObject()) {
+        if (reader.ok()) return NoData;
+        error_ = reader.error();
+        return Malformed;
+    }
+    for (size_t f = 0; f < keyCache_.count; ++f) {
+        if (parseScalar(reader.value(f), latest.values[f])) latest.validMask |= 1u << f;
+    }
+    return Ok;
+}
+
+// Counts the objects whose key equals the newest value of it
+template <>
+FeedExtractor::Status FeedExtractor::extractShape<FeedShape::LatestCount>(const std::string& body, int64_t,
+                                                                           size_t, FeedValues& latest,
+                                                                           std::vector<FeedRow>&) {
+    JsonScalar newest[JsonObjectReader::maxKeys];
+    size_t counts[JsonObjectReader::maxKeys] = {};
+    JsonObjectReader reader(body, keyCache_);
+    while (reader.nextObject()) {
+        for (size_t f = 0; f < keyCache_.count; ++f) {
+            // Dates compare as strings ("2024-05-10")
+            const JsonScalar& value = reader.value(f);
+            if (value.type != JsonScalar::String || value.size == 0) continue;
+            int order = compareText(value, newest[f]);
+            if (order > 0) {
+                newest[f] = value;
+                counts[f] = 0;
+            }
+            if (order >= 0) ++counts[f];
+        }
+    }
+    if (!reader.ok()) {
+        error_ = reader.error();
+        return Malformed;
+    }
+
+    for (size_t f = 0; f < keyCache_.count; ++f) {
+        if (counts[f] == 0) continue;
+        latest.values[f] = (float)counts[f];
+        latest.validMask |= 1u << f;
+    }
+    return latest.validMask ? Ok : NoData;
+}
+
+FeedExtractor::FeedExtractor(const FeedSpec& feed, const FieldSpec* fields) {
+    if (feed.shape == FeedShape::Table) columns_.push_back("time_tag");
+    for (size_t f = 0; f < feed.fieldCount; ++f) columns_.push_back(fields[feed.firstField + f].key);
+
+    if (feed.shape != FeedShape::Table) keyCache_ = JsonObjectReader::KeyCache(columns_.data(), columns_.size());
+
+    switch (feed.shape) {
+        case FeedShape::Table: method_ = &FeedExtractor::extractShape<FeedShape::Table>; break;
+        case FeedShape::FirstObject: method_ = &FeedExtractor::extractShape<FeedShape::FirstObject>; break;
+        case FeedShape::LatestCount: method_ = &FeedExtractor::extractShape<FeedShape::LatestCount>; break;
+    }
+}
+
+FeedExtractor::Status FeedExtractor::extract(const std::string& body, int64_t since, size_t maxRows,
+                                             FeedValues& latest, std::vector<FeedRow>& rows) {
+    error_.clear();
+    latest.time = 0;
+    latest.validMask = 0;
+    rows.clear();
+    return (this->*method_)(body, since, maxRows, latest, rows);
+}
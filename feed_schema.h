@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "json_tail.h"
+#include "osc.h"
+#include "timeseries.h"
+
+// How a NOAA product lays out its JSON
+enum class FeedShape {
+    Table,        // array of arrays, header row first, newest row last (products/...)
+    FirstObject,  // array of objects, the values are in the first one (solar_probabilities)
+    LatestCount,  // array of objects, the value is how many share the newest key (solar_regions)
+};
+
+enum class FieldType { Float, Int };
+
+// One value of a product. Its row in the field table is its archive column,
+// shared-memory slot and index into the snapshot.
+struct FieldSpec {
+    const char* name;        // archive, shared memory and metrics label: "bz_gsm"
+    const char* key;         // header column (Table), object key, or the key counted by (LatestCount)
+    FieldType type;
+    int precision;           // decimals in string mode
+    OSCAddressView address;  // latest value: "/bzGSM"
+    OSCAddressView sample;   // every new row: "/bzGSM/sample" (Table feeds); size 0: none
+    OSCAddressView smooth;   // --stream-hz frames; size 0: none
+};
+
+constexpr OSCAddressView noOscAddress(nullptr, 0);
+
+// One product: where it lives, how its JSON is laid out and how often to
+// poll it. Its fields are fields[firstField, firstField + fieldCount) of
+// the field table; a Table feed's history has one column per field.
+struct FeedSpec {
+    const char* name;
+    const char* url;
+    FeedShape shape;
+    int intervalSeconds;       // poll period while the product keeps changing
+    int maxIntervalSeconds;    // back-off ceiling while it does not
+    size_t firstField;
+    size_t fieldCount;
+    TimeSeriesTable* history;  // new rows are kept here (Table feeds); may be null
+};
+
+// A data row newer than the history, in the feed's field order
+struct FeedRow {
+    int64_t time;
+    float values[JsonTailReader::maxColumns];
+};
+
+// Newest values of one response, in the feed's field order
+struct FeedValues {
+    int64_t time = 0;        // time_tag of the newest row; 0 for products without one
+    uint32_t validMask = 0;  // bit i: values[i] was parsed
+    float values[JsonTailReader::maxColumns];
+};
+
+// Reads one feed's responses as its spec describes. The extractor for the
+// feed's shape is picked once, at construction, along with the column or
+// key list, and column and key positions are cached between responses, so
+// a response costs no lookups in the schema and no name matching. One
+// response at a time per extractor (the scheduler never overlaps polls of a
+// feed).
+class FeedExtractor {
+public:
+    enum Status { Ok, NoData, Malformed };
+
+    FeedExtractor(const FeedSpec& feed, const FieldSpec* fields);
+
+    // Parses the newest values. Table feeds also return the rows newer
+    // than since, oldest first, at most maxRows.
+    Status extract(const std::string& body, int64_t since, size_t maxRows, FeedValues& latest,
+                   std::vector<FeedRow>& rows);
+    // Why the last extract() failed
+    const std::string& error() const { return error_; }
+
+private:
+    typedef Status (FeedExtractor::*Method)(const std::string& body, int64_t since, size_t maxRows,
+                                            FeedValues& latest, std::vector<FeedRow>& rows);
+    template <FeedShape shape>
+    Status extractShape(const std::string& body, int64_t since, size_t maxRows, FeedValues& latest,
+                        std::vector<FeedRow>& rows);
+
+    Method method_ = nullptr;
+    std::vector<const char*> columns_;  // column or key per field; Table feeds start with time_tag
+    // Where the columns or keys were found in the last response; checked,
+    // not searched for, on the next one
+    JsonTailReader::ColumnCache columnCache_;
+    JsonObjectReader::KeyCache keyCache_;
+    std::string error_;
+};
@@ -0,0 +1,381 @@
+#include "fetcher.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+#include "logger.h"
+
+// Function to write data from curl response
+static size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* buffer) {
+    size_t totalSize = size * nmemb;
+    if (buffer) {
+        buffer->append((char*)contents, totalSize);
+        return totalSize;
+    }
+    return 0;
+}
+
+// Returns the trimmed value if the header line is "<name>: value"
+static bool matchHeader(const char* line, size_t len, const char* name, std::string& value) {
+    size_t nameLen = strlen(name);
+    if (len <= nameLen || line[nameLen] != ':' || strncasecmp(line, name, nameLen) != 0) {
+        return false;
+    }
+    size_t begin = nameLen + 1;
+    size_t end = len;
+    while (begin < end && isspace((unsigned char)line[begin])) ++begin;
+    while (end > begin && isspace((unsigned char)line[end - 1])) --end;
+    value.assign(line + begin, end - begin);
+    return true;
+}
+
+// Connection setup and stall limits; the overall timeout is per feed
+static const long connectTimeoutMs = 5000;
+static const long lowSpeedLimit = 64;  // below this many bytes/s...
+static const long lowSpeedTime = 5;    // ...for this many seconds the transfer counts as stalled
+// Hedging needs a few samples first, and never fires sooner than this
+static const size_t minLatencySamples = 8;
+static const std::chrono::milliseconds minHedgeDelay(250);
+
+FeedFetcher::FeedFetcher() {
+    multi_ = curl_multi_init();
+    // Multiplex all streams over one HTTP/2 connection when the server allows it
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, 4L);
+}
+
+FeedFetcher::~FeedFetcher() {
+    for (auto& feed : feeds_) {
+        for (Transfer* t : {&feed->primary, &feed->hedge}) {
+            if (!t->easy) continue;
+            curl_multi_remove_handle(multi_, t->easy);
+            curl_easy_cleanup(t->easy);
+            curl_slist_free_all(t->headers);
+        }
+    }
+    curl_multi_cleanup(multi_);
+}
+
+size_t FeedFetcher::addFeed(const std::string& url, Callback onComplete, std::chrono::milliseconds timeout) {
+    std::unique_ptr<Feed> feed(new Feed);
+    feed->index = feeds_.size();
+    feed->url = url;
+    feed->callback = onComplete;
+    feed->timeout = timeout;
+    feed->primary.feed = feed.get();
+    feed->hedge.feed = feed.get();
+    if (!setupHandle(feed->primary, false)) {
+        logError("fetch") << "curl_easy_init() failed for " << url;
+    }
+    feeds_.push_back(std::move(feed));
+    return feeds_.size() - 1;
+}
+
+void FeedFetcher::invalidate(size_t index) {
+    if (index >= feeds_.size()) return;
+    feeds_[index]->etag.clear();
+    feeds_[index]->lastModified.clear();
+}
+
+CacheStats FeedFetcher::cacheStats() const {
+    CacheStats total;
+    for (const auto& feed : feeds_) {
+        total.hits += feed->stats.hits;
+        total.misses += feed->stats.misses;
+    }
+    return total;
+}
+
+std::chrono::milliseconds FeedFetcher::latencyP95(size_t index) const {
+    if (index >= feeds_.size()) return std::chrono::milliseconds(0);
+    const Feed& feed = *feeds_[index];
+    if (feed.latencyCount == 0) return std::chrono::milliseconds(0);
+
+    uint32_t sorted[latencyWindow];
+    std::copy(feed.latencies, feed.latencies + feed.latencyCount, sorted);
+    size_t rank = (feed.latencyCount * 95 + 99) / 100 - 1;
+    std::nth_element(sorted, sorted + rank, sorted + feed.latencyCount);
+    return std::chrono::milliseconds(sorted[rank]);
+}
+
+void FeedFetcher::recordLatency(Feed& feed) {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - feed.started);
+    feed.latencies[feed.latencyNext] = (uint32_t)elapsed.count();
+    feed.latencyNext = (feed.latencyNext + 1) % latencyWindow;
+    if (feed.latencyCount < latencyWindow) ++feed.latencyCount;
+}
+
+size_t FeedFetcher::headerCallback(char* data, size_t size, size_t nitems, void* userdata) {
+    Transfer* t = static_cast<Transfer*>(userdata);
+    size_t len = size * nitems;
+
+    // A new status line starts a new response (redirects, 100-continue)
+    if (len >= 5 && strncmp(data, "HTTP/", 5) == 0) {
+        t->pendingEtag.clear();
+        t->pendingLastModified.clear();
+        t->pendingMaxAge = -1;
+        return len;
+    }
+    std::string value;
+    if (matchHeader(data, len, "ETag", value)) {
+        t->pendingEtag = value;
+    } else if (matchHeader(data, len, "Last-Modified", value)) {
+        t->pendingLastModified = value;
+    } else if (matchHeader(data, len, "Cache-Control", value)) {
+        size_t pos = value.find("max-age=");
+        if (pos != std::string::npos) {
+            t->pendingMaxAge = strtol(value.c_str() + pos + 8, nullptr, 10);
+        }
+    }
+    return len;
+}
+
+bool FeedFetcher::setupHandle(Transfer& t, bool hedge) {
+    t.easy = curl_easy_init();
+    if (!t.easy) return false;
+
+    curl_easy_setopt(t.easy, CURLOPT_URL, t.feed->url.c_str());
+    curl_easy_setopt(t.easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(t.easy, CURLOPT_WRITEDATA, &t.result.body);
+    curl_easy_setopt(t.easy, CURLOPT_HEADERFUNCTION, headerCallback);
+    curl_easy_setopt(t.easy, CURLOPT_HEADERDATA, &t);
+    curl_easy_setopt(t.easy, CURLOPT_PRIVATE, &t);
+    curl_easy_setopt(t.easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+    curl_easy_setopt(t.easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(t.easy, CURLOPT_FOLLOWLOCATION, 1L);
+    // The JSON products compress ~10x; curl decodes transparently
+    curl_easy_setopt(t.easy, CURLOPT_ACCEPT_ENCODING, "gzip, deflate");
+
+    // No SIGALRM for resolver timeouts: other threads are running
+    curl_easy_setopt(t.easy, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(t.easy, CURLOPT_CONNECTTIMEOUT_MS, connectTimeoutMs);
+    curl_easy_setopt(t.easy, CURLOPT_LOW_SPEED_LIMIT, lowSpeedLimit);
+    curl_easy_setopt(t.easy, CURLOPT_LOW_SPEED_TIME, lowSpeedTime);
+
+    if (hedge) {
+        // The original may be stuck on the shared connection: go around it
+        curl_easy_setopt(t.easy, CURLOPT_FRESH_CONNECT, 1L);
+    } else if (t.feed->url.compare(0, 8, "https://") == 0) {
+        // Wait for an existing connection to multiplex on rather than opening a new one.
+        // Only over TLS, where ALPN settles HTTP/2 at the handshake; on plain HTTP curl
+        // would wait for the first response, and a stalled one would hold up every feed.
+        curl_easy_setopt(t.easy, CURLOPT_PIPEWAIT, 1L);
+    }
+    return true;
+}
+
+void FeedFetcher::prepareRequest(Transfer& t, std::chrono::milliseconds timeout) {
+    const Feed& feed = *t.feed;
+    t.result = FetchResult();
+    t.pendingEtag.clear();
+    t.pendingLastModified.clear();
+    t.pendingMaxAge = -1;
+
+    curl_slist_free_all(t.headers);
+    t.headers = nullptr;
+    if (!feed.etag.empty()) {
+        t.headers = curl_slist_append(t.headers, ("If-None-Match: " + feed.etag).c_str());
+    }
+    if (!feed.lastModified.empty()) {
+        t.headers = curl_slist_append(t.headers, ("If-Modified-Since: " + feed.lastModified).c_str());
+    }
+    curl_easy_setopt(t.easy, CURLOPT_HTTPHEADER, t.headers);
+    curl_easy_setopt(t.easy, CURLOPT_TIMEOUT_MS, (long)timeout.count());
+}
+
+void FeedFetcher::launch(Transfer& t, std::chrono::milliseconds timeout) {
+    prepareRequest(t, timeout);
+    t.active = true;
+    curl_multi_add_handle(multi_, t.easy);
+}
+
+void FeedFetcher::cancel(Transfer& t) {
+    if (!t.active) return;
+    curl_multi_remove_handle(multi_, t.easy);
+    t.active = false;
+    t.result = FetchResult();
+}
+
+void FeedFetcher::finishRequest(Feed& feed, Transfer& t, CURLcode code) {
+    t.result.code = code;
+    t.result.maxAgeSeconds = t.pendingMaxAge;
+
+    if (code != CURLE_OK) {
+        logWarning("fetch") << "Fetch of " << feed.url << " failed: " << curl_easy_strerror(code);
+    } else if (t.result.httpStatus == 304) {
+        t.result.notModified = true;
+        ++feed.stats.hits;
+    } else if (t.result.httpStatus >= 400) {
+        logWarning("fetch") << "Fetch of " << feed.url << " failed: HTTP " << t.result.httpStatus;
+    } else {
+        feed.etag = t.pendingEtag;
+        feed.lastModified = t.pendingLastModified;
+        ++feed.stats.misses;
+    }
+}
+
+void FeedFetcher::start(size_t index) {
+    if (index >= feeds_.size()) return;
+    Feed& feed = *feeds_[index];
+    if (feed.inFlight) return;
+
+    if (!feed.primary.easy) {
+        feed.primary.result = FetchResult();
+        feed.primary.result.code = CURLE_FAILED_INIT;
+        complete(feed, feed.primary.result);
+        return;
+    }
+    feed.inFlight = true;
+    feed.hedged = false;
+    feed.started = Clock::now();
+    launch(feed.primary, feed.timeout);
+}
+
+void FeedFetcher::complete(Feed& feed, FetchResult& result) {
+    feed.inFlight = false;
+    if (feed.callback) {
+        feed.callback(feed.index, std::move(result));
+    }
+    result = FetchResult();
+}
+
+void FeedFetcher::readTimings(Transfer& t) {
+    // Times are cumulative from the start of the request
+    curl_off_t dns = 0, connect = 0, tls = 0, pretransfer = 0, firstByte = 0, total = 0, bytes = 0;
+    curl_easy_getinfo(t.easy, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+    curl_easy_getinfo(t.easy, CURLINFO_CONNECT_TIME_T, &connect);
+    curl_easy_getinfo(t.easy, CURLINFO_APPCONNECT_TIME_T, &tls);
+    curl_easy_getinfo(t.easy, CURLINFO_PRETRANSFER_TIME_T, &pretransfer);
+    curl_easy_getinfo(t.easy, CURLINFO_STARTTRANSFER_TIME_T, &firstByte);
+    curl_easy_getinfo(t.easy, CURLINFO_TOTAL_TIME_T, &total);
+    curl_easy_getinfo(t.easy, CURLINFO_SIZE_DOWNLOAD_T, &bytes);
+
+    FetchTimings& timings = t.result.timings;
+    timings.dns = dns;
+    timings.connect = std::max<int64_t>(0, connect - dns);
+    timings.tls = tls > 0 ? std::max<int64_t>(0, tls - connect) : 0;
+    timings.wait = std::max<int64_t>(0, firstByte - pretransfer);
+    timings.transfer = std::max<int64_t>(0, total - firstByte);
+    timings.total = total;
+    timings.bytes = bytes;
+}
+
+void FeedFetcher::transferDone(Transfer& t, CURLcode code) {
+    Feed& feed = *t.feed;
+    t.active = false;
+    t.result.code = code;
+    curl_easy_getinfo(t.easy, CURLINFO_RESPONSE_CODE, &t.result.httpStatus);
+    bool success = code == CURLE_OK && t.result.httpStatus < 400;
+
+    Transfer& other = &t == &feed.primary ? feed.hedge : feed.primary;
+    if (!success && other.active) {
+        // The other request may still make it; report only if both fail
+        t.result = FetchResult();
+        return;
+    }
+    cancel(other);
+    if (success && &t == &feed.hedge) ++hedgeStats_.won;
+
+    readTimings(t);
+    finishRequest(feed, t, code);
+    if (success) recordLatency(feed);
+    complete(feed, t.result);
+}
+
+std::chrono::milliseconds FeedFetcher::hedgeDelay(const Feed& feed) const {
+    // Until the feed's latency is known, hedge halfway through the timeout
+    if (feed.latencyCount < minLatencySamples) return feed.timeout / 2;
+    std::chrono::milliseconds p95 = latencyP95(feed.index);
+    // Leave the hedge at least a quarter of the budget
+    return std::min(std::max(p95, minHedgeDelay), feed.timeout * 3 / 4);
+}
+
+int FeedFetcher::startDueHedges() {
+    int started = 0;
+    Clock::time_point now = Clock::now();
+    for (auto& f : feeds_) {
+        Feed& feed = *f;
+        if (!feed.inFlight || feed.hedged || !feed.primary.active) continue;
+        if (now < feed.started + hedgeDelay(feed)) continue;
+
+        feed.hedged = true;
+        auto remaining = feed.timeout - std::chrono::duration_cast<std::chrono::milliseconds>(now - feed.started);
+        if (remaining.count() <= 0) continue;
+        if (!feed.hedge.easy && !setupHandle(feed.hedge, true)) continue;
+        launch(feed.hedge, remaining);
+        ++hedgeStats_.sent;
+        ++started;
+    }
+    return started;
+}
+
+int FeedFetcher::msUntilNextHedge() const {
+    int wait = -1;
+    Clock::time_point now = Clock::now();
+    for (const auto& f : feeds_) {
+        const Feed& feed = *f;
+        if (!feed.inFlight || feed.hedged || !feed.primary.active) continue;
+        auto due = std::chrono::duration_cast<std::chrono::milliseconds>(feed.started + hedgeDelay(feed) - now);
+        int ms = (int)std::max<int64_t>(0, due.count());
+        if (wait < 0 || ms < wait) wait = ms;
+    }
+    return wait;
+}
+
+int FeedFetcher::abortAll() {
+    int cancelled = 0;
+    for (auto& feed : feeds_) {
+        if (!feed->inFlight) continue;
+        cancel(feed->primary);
+        cancel(feed->hedge);
+        feed->inFlight = false;
+        ++cancelled;
+    }
+    return cancelled;
+}
+
+void FeedFetcher::wakeup() {
+    curl_multi_wakeup(multi_);
+}
+
+int FeedFetcher::poll(int timeoutMs) {
+    int stillRunning = 0;
+    int finished = 0;
+    auto drain = [&]() {
+        // Hand over each finished transfer right away
+        int queued = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi_, &queued)) {
+            if (msg->msg != CURLMSG_DONE) continue;
+
+            Transfer* t = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char**)&t);
+            CURLcode code = msg->data.result;
+            curl_multi_remove_handle(multi_, msg->easy_handle);
+            if (!t || !t->active) continue;
+
+            bool wasInFlight = t->feed->inFlight;
+            transferDone(*t, code);
+            if (wasInFlight && !t->feed->inFlight) ++finished;
+        }
+    };
+
+    startDueHedges();
+    CURLMcode mc = curl_multi_perform(multi_, &stillRunning);
+    if (mc != CURLM_OK) {
+        logError("fetch") << "curl_multi_perform() failed: " << curl_multi_strerror(mc);
+    }
+    drain();
+
+    // Sleeps until there is socket activity, the timeout, a hedge falls due, or wakeup()
+    int hedgeWait = msUntilNextHedge();
+    if (hedgeWait >= 0 && hedgeWait < timeoutMs) timeoutMs = hedgeWait;
+    curl_multi_poll(multi_, nullptr, 0, timeoutMs, nullptr);
+
+    startDueHedges();
+    curl_multi_perform(multi_, &stillRunning);
+    drain();
+    return finished;
+}
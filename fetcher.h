@@ -0,0 +1,154 @@
+#pragma once
+
+#include <curl/curl.h>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Phases of the request that answered, from curl_easy_getinfo (microseconds).
+// On a reused connection dns, connect and tls are 0.
+struct FetchTimings {
+    int64_t dns = 0;
+    int64_t connect = 0;
+    int64_t tls = 0;
+    int64_t wait = 0;       // request sent -> first byte of the response
+    int64_t transfer = 0;   // first byte -> last byte
+    int64_t total = 0;
+    int64_t bytes = 0;      // downloaded, before decompression
+};
+
+// Result of one transfer, handed to the feed callback as soon as it lands
+struct FetchResult {
+    CURLcode code = CURLE_OK;
+    long httpStatus = 0;
+    bool notModified = false;   // 304: body is empty, reuse the last decoded values
+    long maxAgeSeconds = -1;    // Cache-Control: max-age, -1 if absent
+    std::string body;
+    FetchTimings timings;
+
+    bool ok() const {
+        return code == CURLE_OK && httpStatus < 400 && (notModified || !body.empty());
+    }
+};
+
+struct CacheStats {
+    unsigned long hits = 0;     // 304 Not Modified
+    unsigned long misses = 0;   // full response downloaded
+};
+
+struct HedgeStats {
+    unsigned long sent = 0;     // second requests issued
+    unsigned long won = 0;      // ...that finished before the original
+};
+
+// Concurrent fetch engine on top of a single curl multi handle.
+// Every feed keeps its own easy handle between fetches, so connections,
+// TLS sessions and the DNS cache are reused, and on HTTP/2 all feeds to
+// services.swpc.noaa.gov share one multiplexed connection.
+// Every transfer is bounded by the feed's timeout. A request still running
+// past the feed's p95 latency gets a hedged duplicate on a fresh connection;
+// whichever finishes first wins and the other is dropped.
+// Apart from wakeup(), all methods must be called from one thread.
+class FeedFetcher {
+public:
+    // The result is handed over by value; the feed's buffer is reused
+    typedef std::function<void(size_t index, FetchResult&& result)> Callback;
+
+    FeedFetcher();
+    ~FeedFetcher();
+
+    FeedFetcher(const FeedFetcher&) = delete;
+    FeedFetcher& operator=(const FeedFetcher&) = delete;
+
+    // Registers a feed, returns its index. The timeout covers the whole
+    // request, hedge included.
+    size_t addFeed(const std::string& url, Callback onComplete,
+                   std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+    // Puts the feed's transfer in flight; no-op if it already is
+    void start(size_t index);
+    bool inFlight(size_t index) const { return feeds_[index]->inFlight; }
+
+    // Drives all transfers for up to timeoutMs and runs the callbacks of the
+    // ones that finished, in completion order. Returns the number finished.
+    int poll(int timeoutMs);
+
+    // Interrupts a poll() in progress; safe from any thread
+    void wakeup();
+
+    // Drops stored validators so the next fetch of the feed is unconditional
+    void invalidate(size_t index);
+
+    // Cancels every transfer in flight without running callbacks (shutdown).
+    // Returns the number cancelled.
+    int abortAll();
+
+    CacheStats cacheStats() const;
+    HedgeStats hedgeStats() const { return hedgeStats_; }
+    // 95th percentile of the feed's recent request latency, 0 until known
+    std::chrono::milliseconds latencyP95(size_t index) const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    static const size_t latencyWindow = 32;
+
+    struct Feed;
+
+    // One request on the wire. A feed has a primary and, once it runs late,
+    // a hedge; each keeps its own handle, body and response headers.
+    struct Transfer {
+        Feed* feed = nullptr;
+        CURL* easy = nullptr;
+        curl_slist* headers = nullptr;
+        FetchResult result;
+        std::string pendingEtag;
+        std::string pendingLastModified;
+        long pendingMaxAge = -1;
+        bool active = false;
+    };
+
+    struct Feed {
+        size_t index = 0;
+        std::string url;
+        Callback callback;
+        std::chrono::milliseconds timeout{10000};
+
+        Transfer primary;
+        Transfer hedge;
+
+        // Validators of the last full response, sent back as If-None-Match/If-Modified-Since
+        std::string etag;
+        std::string lastModified;
+        CacheStats stats;
+
+        bool inFlight = false;
+        bool hedged = false;
+        Clock::time_point started;
+
+        // Recent request latencies in ms, ring buffer
+        uint32_t latencies[latencyWindow];
+        size_t latencyCount = 0;
+        size_t latencyNext = 0;
+    };
+
+    static size_t headerCallback(char* data, size_t size, size_t nitems, void* userdata);
+    bool setupHandle(Transfer& transfer, bool hedge);
+    void prepareRequest(Transfer& transfer, std::chrono::milliseconds timeout);
+    void launch(Transfer& transfer, std::chrono::milliseconds timeout);
+    void cancel(Transfer& transfer);
+    void finishRequest(Feed& feed, Transfer& transfer, CURLcode code);
+    void transferDone(Transfer& transfer, CURLcode code);
+    void readTimings(Transfer& transfer);
+    void complete(Feed& feed, FetchResult& result);
+    void recordLatency(Feed& feed);
+    std::chrono::milliseconds hedgeDelay(const Feed& feed) const;
+    int startDueHedges();
+    int msUntilNextHedge() const;
+
+    CURLM* multi_;
+    std::vector<std::unique_ptr<Feed>> feeds_;
+    HedgeStats hedgeStats_;
+};
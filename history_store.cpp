@@ -0,0 +1,327 @@
+#include "history_store.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const char storeMagic[8] = {'S', 'D', 'C', 'H', 'I', 'S', 'T', '1'};
+static const uint32_t storeVersion = 2;  // 2: per-field data times
+static const size_t headerPage = 4096;
+static const size_t slotSize = 64;
+static const size_t defaultBlockRows = 4096;
+
+struct HistoryStore::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t fieldCount;
+    uint32_t blockRows;
+    uint32_t reserved;
+    uint64_t sequence;       // the valid slot with the higher sequence wins
+    uint64_t committedRows;  // rows that are durable on disk
+    uint64_t checksum;       // FNV-1a of everything above
+};
+
+static uint64_t fnv1a(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string systemError(const std::string& what) {
+    return what + ": " + strerror(errno);
+}
+
+HistoryStore::HistoryStore() {}
+
+HistoryStore::~HistoryStore() {
+    close();
+}
+
+size_t HistoryStore::blockBytes() const {
+    size_t raw = blockRows_ * (sizeof(int64_t) + sizeof(uint32_t) + fieldCount_ * (sizeof(float) + sizeof(int64_t)));
+    return (raw + headerPage - 1) / headerPage * headerPage;
+}
+
+size_t HistoryStore::blockOffset(size_t block) const {
+    return headerPage + block * blockBytes();
+}
+
+// Block layout: times[blockRows], masks[blockRows], one float column per
+// field, then one data-time column per field (8-byte aligned: blockRows is
+// a multiple of 8)
+int64_t* HistoryStore::timesOf(size_t block) const {
+    return reinterpret_cast<int64_t*>(data_ + blockOffset(block));
+}
+
+uint32_t* HistoryStore::masksOf(size_t block) const {
+    return reinterpret_cast<uint32_t*>(data_ + blockOffset(block) + blockRows_ * sizeof(int64_t));
+}
+
+float* HistoryStore::columnOf(size_t block, size_t field) const {
+    size_t offset = blockOffset(block) + blockRows_ * (sizeof(int64_t) + sizeof(uint32_t));
+    return reinterpret_cast<float*>(data_ + offset + field * blockRows_ * sizeof(float));
+}
+
+int64_t* HistoryStore::fieldTimesOf(size_t block, size_t field) const {
+    size_t offset = blockOffset(block) + blockRows_ * (sizeof(int64_t) + sizeof(uint32_t) + fieldCount_ * sizeof(float));
+    return reinterpret_cast<int64_t*>(data_ + offset + field * blockRows_ * sizeof(int64_t));
+}
+
+int64_t HistoryStore::timeAtUnlocked(size_t row) const {
+    return timesOf(row / blockRows_)[row % blockRows_];
+}
+
+// The new mapping comes first: if it fails, the old one stays in use and the
+// rows appended so far can still be committed
+bool HistoryStore::mapFile(size_t size) {
+    void* p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+        error_ = systemError("mmap " + path_);
+        return false;
+    }
+    if (data_) munmap(data_, mappedSize_);
+    data_ = static_cast<unsigned char*>(p);
+    mappedSize_ = size;
+    return true;
+}
+
+bool HistoryStore::grow() {
+    size_t newSize = mappedSize_ + blockBytes();
+    if (ftruncate(fd_, (off_t)newSize) != 0) {
+        error_ = systemError("ftruncate " + path_);
+        return false;
+    }
+    return mapFile(newSize);
+}
+
+bool HistoryStore::writeHeader(uint64_t committed) {
+    static_assert(sizeof(Header) <= slotSize, "header slot overflow");
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, storeMagic, sizeof(storeMagic));
+    header.version = storeVersion;
+    header.fieldCount = (uint32_t)fieldCount_;
+    header.blockRows = (uint32_t)blockRows_;
+    header.sequence = sequence_ + 1;
+    header.committedRows = committed;
+    header.checksum = fnv1a(&header, offsetof(Header, checksum));
+
+    // Alternate slots, so the previous header survives a torn write
+    memcpy(data_ + (header.sequence % 2) * slotSize, &header, sizeof(header));
+    if (msync(data_, headerPage, MS_SYNC) != 0) {
+        error_ = systemError("msync " + path_);
+        return false;
+    }
+    sequence_ = header.sequence;
+    return true;
+}
+
+bool HistoryStore::open(const std::string& path, size_t fieldCount) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (data_) {
+        error_ = "already open";
+        return false;
+    }
+    if (fieldCount == 0 || fieldCount > maxFields) {
+        error_ = "unsupported field count";
+        return false;
+    }
+    path_ = path;
+    fieldCount_ = fieldCount;
+
+    fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd_ < 0) {
+        error_ = systemError("open " + path);
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd_, &st) != 0) {
+        error_ = systemError("fstat " + path);
+        ::close(fd_);
+        fd_ = -1;
+        return false;
+    }
+
+    bool ok;
+    if (st.st_size == 0) {
+        // New file: header page plus the first block
+        blockRows_ = defaultBlockRows;
+        sequence_ = 0;
+        ok = ftruncate(fd_, (off_t)(headerPage + blockBytes())) == 0;
+        if (!ok) error_ = systemError("ftruncate " + path);
+        ok = ok && mapFile(headerPage + blockBytes()) && writeHeader(0);
+        rows_ = committed_ = 0;
+    } else {
+        ok = (size_t)st.st_size >= headerPage && mapFile((size_t)st.st_size);
+        if (!ok && error_.empty()) error_ = path + " is truncated";
+
+        const Header* best = nullptr;
+        bool otherVersion = false;
+        for (size_t slot = 0; ok && slot < 2; ++slot) {
+            const Header* h = reinterpret_cast<const Header*>(data_ + slot * slotSize);
+            if (memcmp(h->magic, storeMagic, sizeof(storeMagic)) != 0) continue;
+            if (h->checksum != fnv1a(h, offsetof(Header, checksum))) continue;
+            if (h->version != storeVersion) {
+                otherVersion = true;
+                continue;
+            }
+            if (!best || h->sequence > best->sequence) best = h;
+        }
+        if (ok && !best && otherVersion) {
+            error_ = path + " was written in another format version";
+            ok = false;
+        } else if (ok && !best) {
+            error_ = path + " has no valid header";
+            ok = false;
+        } else if (ok && best->fieldCount != fieldCount) {
+            error_ = path + " was written with a different set of fields";
+            ok = false;
+        } else if (ok) {
+            blockRows_ = best->blockRows;
+            sequence_ = best->sequence;
+            rows_ = committed_ = (size_t)best->committedRows;
+            size_t blocks = blockRows_ ? (mappedSize_ - headerPage) / blockBytes() : 0;
+            if (blockRows_ == 0 || committed_ > blocks * blockRows_) {
+                error_ = path + " is shorter than its header says";
+                ok = false;
+            }
+        }
+    }
+
+    if (!ok) {
+        if (data_) munmap(data_, mappedSize_);
+        data_ = nullptr;
+        mappedSize_ = 0;
+        ::close(fd_);
+        fd_ = -1;
+    }
+    return ok;
+}
+
+void HistoryStore::close() {
+    sync();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (data_) munmap(data_, mappedSize_);
+    data_ = nullptr;
+    mappedSize_ = 0;
+    if (fd_ >= 0) ::close(fd_);
+    fd_ = -1;
+}
+
+bool HistoryStore::append(int64_t time, uint32_t validMask, const float* values, const int64_t* fieldTimes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!data_) return false;
+
+    size_t capacity = (mappedSize_ - headerPage) / blockBytes() * blockRows_;
+    if (rows_ == capacity && !grow()) return false;
+
+    if (rows_ > 0) time = std::max(time, timeAtUnlocked(rows_ - 1));
+
+    size_t block = rows_ / blockRows_;
+    size_t i = rows_ % blockRows_;
+    timesOf(block)[i] = time;
+    masksOf(block)[i] = validMask;
+    for (size_t f = 0; f < fieldCount_; ++f) {
+        columnOf(block, f)[i] = values[f];
+        fieldTimesOf(block, f)[i] = fieldTimes ? fieldTimes[f] : time;
+    }
+    ++rows_;
+    return true;
+}
+
+std::string HistoryStore::error() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return error_;
+}
+
+bool HistoryStore::sync() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!data_ || rows_ == committed_) return true;
+
+    // Data first, then the header that makes it visible
+    size_t from = blockOffset(committed_ / blockRows_);
+    size_t to = blockOffset((rows_ - 1) / blockRows_ + 1);
+    if (msync(data_ + from, to - from, MS_SYNC) != 0) {
+        error_ = systemError("msync " + path_);
+        return false;
+    }
+    if (!writeHeader(rows_)) return false;
+    committed_ = rows_;
+    return true;
+}
+
+size_t HistoryStore::rowCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return rows_;
+}
+
+size_t HistoryStore::committedRows() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return committed_;
+}
+
+bool HistoryStore::lastRow(int64_t& time, uint32_t& validMask, float* values, int64_t* fieldTimes) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!data_ || rows_ == 0) return false;
+
+    size_t block = (rows_ - 1) / blockRows_;
+    size_t i = (rows_ - 1) % blockRows_;
+    time = timesOf(block)[i];
+    validMask = masksOf(block)[i];
+    for (size_t f = 0; f < fieldCount_; ++f) {
+        values[f] = columnOf(block, f)[i];
+        if (fieldTimes) fieldTimes[f] = fieldTimesOf(block, f)[i];
+    }
+    return true;
+}
+
+int64_t HistoryStore::firstTime() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return data_ && rows_ > 0 ? timeAtUnlocked(0) : 0;
+}
+
+size_t HistoryStore::lowerBound(int64_t time) const {
+    size_t lo = 0, hi = rows_;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (timeAtUnlocked(mid) < time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+size_t HistoryStore::query(size_t field, int64_t from, int64_t to, int64_t* times, float* values,
+                           size_t maxRows) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!data_ || field >= fieldCount_) return 0;
+
+    size_t begin = lowerBound(from);
+    size_t end = lowerBound(to);
+    // Keep the newest rows if the range is larger than the output
+    if (end - begin > maxRows) begin = end - maxRows;
+
+    size_t written = 0;
+    for (size_t row = begin; row < end; ++row, ++written) {
+        size_t block = row / blockRows_;
+        size_t i = row % blockRows_;
+        if (times) times[written] = timesOf(block)[i];
+        if (values) {
+            bool valid = (masksOf(block)[i] >> field) & 1u;
+            values[written] = valid ? columnOf(block, field)[i] : std::numeric_limits<float>::quiet_NaN();
+        }
+    }
+    return written;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Append-only on-disk archive of snapshots, one row per publication:
+// time, a validity bitmap, one float column per field and, per field, the
+// time of the data the value came from (its NOAA time_tag).
+//
+// The file is a header page followed by fixed-size blocks of blockRows
+// rows, each block stored column by column, and is accessed through mmap.
+// Rows become durable on sync(): the data pages are flushed first, then the
+// committed row count is written to one of two checksummed header slots.
+// After a crash the newest intact slot wins, so a torn write loses at most
+// the rows appended since the last sync, never the file.
+class HistoryStore {
+public:
+    static const size_t maxFields = 32;  // validity bitmap is 32 bits wide
+
+    HistoryStore();
+    ~HistoryStore();
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    // Opens or creates the file. An existing file must have the same field
+    // count. Returns false (with error() set) if the store is unusable.
+    bool open(const std::string& path, size_t fieldCount);
+    void close();
+    bool isOpen() const { return data_ != nullptr; }
+    std::string error() const;
+
+    // Rows must come in time order; an earlier time is clamped to the last one.
+    // values[f] counts only if bit f of validMask is set; fieldTimes[f] is its
+    // data time (time itself without fieldTimes). False if the file
+    // could not grow: the store stays open with the rows it already holds,
+    // and the next append tries again.
+    bool append(int64_t time, uint32_t validMask, const float* values, const int64_t* fieldTimes = nullptr);
+
+    // Flushes appended rows and commits them
+    bool sync();
+
+    size_t rowCount() const;
+    size_t committedRows() const;
+
+    // Newest row, with its per-field data times if fieldTimes is given;
+    // false if the store is empty
+    bool lastRow(int64_t& time, uint32_t& validMask, float* values, int64_t* fieldTimes = nullptr) const;
+    int64_t firstTime() const;
+
+    // Rows with from <= time < to, oldest first; invalid values come out as
+    // NaN. Returns rows written.
+    size_t query(size_t field, int64_t from, int64_t to, int64_t* times, float* values, size_t maxRows) const;
+
+private:
+    struct Header;
+
+    size_t blockBytes() const;
+    size_t blockOffset(size_t block) const;
+    int64_t* timesOf(size_t block) const;
+    uint32_t* masksOf(size_t block) const;
+    float* columnOf(size_t block, size_t field) const;
+    int64_t* fieldTimesOf(size_t block, size_t field) const;
+    int64_t timeAtUnlocked(size_t row) const;
+    size_t lowerBound(int64_t time) const;
+
+    bool mapFile(size_t size);
+    bool grow();
+    bool writeHeader(uint64_t committed);
+
+    mutable std::mutex mutex_;
+    std::string path_;
+    std::string error_;
+    int fd_ = -1;
+    unsigned char* data_ = nullptr;
+    size_t mappedSize_ = 0;
+
+    size_t fieldCount_ = 0;
+    size_t blockRows_ = 0;
+    size_t rows_ = 0;        // appended, visible to queries
+    size_t committed_ = 0;   // durable
+    uint64_t sequence_ = 0;  // of the newest header slot
+};
@@ -0,0 +1,436 @@
+#include "json_tail.h"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+static bool isJsonSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+bool JsonScalar::isNull() const {
+    if (type == Missing || type == Null) return true;
+    if (type != String) return false;
+    return size == 0 || (size == 4 && (memcmp(data, "null", 4) == 0 || memcmp(data, "NULL", 4) == 0));
+}
+
+// Copies the literal into a NUL-terminated stack buffer for strto*
+static bool scalarLiteral(const JsonScalar& value, char (&buffer)[64]) {
+    if (value.isNull() || (value.type != JsonScalar::String && value.type != JsonScalar::Number)) return false;
+    if (value.size >= sizeof(buffer)) return false;
+    memcpy(buffer, value.data, value.size);
+    buffer[value.size] = '\0';
+    return true;
+}
+
+bool jsonScalarToFloat(const JsonScalar& value, float& out) {
+    char buffer[64];
+    if (!scalarLiteral(value, buffer)) return false;
+    char* end = nullptr;
+    errno = 0;
+    float parsed = strtof(buffer, &end);
+    if (end == buffer || errno == ERANGE) return false;
+    out = parsed;
+    return true;
+}
+
+bool jsonScalarToInt(const JsonScalar& value, int& out) {
+    char buffer[64];
+    if (!scalarLiteral(value, buffer)) return false;
+    char* end = nullptr;
+    errno = 0;
+    long parsed = strtol(buffer, &end, 10);
+    if (end == buffer || errno == ERANGE) return false;
+    out = (int)parsed;
+    return true;
+}
+
+JsonTailReader::JsonTailReader(const char* data, size_t size) : data_(data), size_(size) {
+    size_t begin = skipSpaceForward(0);
+    size_t end = size_;
+    while (end > begin && isJsonSpace(data_[end - 1])) --end;
+
+    if (begin >= end || data_[begin] != '[' || data_[end - 1] != ']') {
+        error_ = "response is not a JSON array";
+        return;
+    }
+    cursor_ = end - 1;
+
+    headerBegin_ = skipSpaceForward(begin + 1);
+    if (headerBegin_ == cursor_) {
+        // "[]": nothing published, which is not malformed
+        empty_ = true;
+        return;
+    }
+    if (headerBegin_ > cursor_ || data_[headerBegin_] != '[') {
+        error_ = "response has no header row";
+        return;
+    }
+    // The header row is scanned forward once, when columns are selected
+    headerEnd_ = headerBegin_;
+}
+
+size_t JsonTailReader::skipSpaceForward(size_t pos) const {
+    while (pos < size_ && isJsonSpace(data_[pos])) ++pos;
+    return pos;
+}
+
+size_t JsonTailReader::skipSpaceBack(size_t pos) const {
+    while (pos > 0 && isJsonSpace(data_[pos])) --pos;
+    return pos;
+}
+
+bool JsonTailReader::selectColumns(std::initializer_list<const char*> names) {
+    return selectColumns(names.begin(), names.size());
+}
+
+bool JsonTailReader::selectColumns(const char* const* names, size_t count) {
+    if (!ok() || empty_) return false;
+    if (count > maxColumns) {
+        error_ = "too many columns selected";
+        return false;
+    }
+    columnCount_ = count;
+    for (size_t i = 0; i < columnCount_; ++i) columns_[i] = -1;
+
+    // The array's own ']' is not the header's: "[[...]" is truncated
+    if (!parseRow(headerBegin_, cursor_, true, names, count)) return false;
+    for (size_t i = 0; i < columnCount_; ++i) {
+        if (columns_[i] < 0) {
+            error_ = "selected column is missing from the header row";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool JsonTailReader::selectColumns(const char* const* names, size_t count, ColumnCache& cache) {
+    if (!ok() || empty_) return false;
+    // The cached header ends with its ']', so matching bytes are the same header
+    size_t cached = cache.header.size();
+    if (cached != 0 && cache.count == count && cursor_ - headerBegin_ >= cached &&
+        memcmp(data_ + headerBegin_, cache.header.data(), cached) == 0) {
+        headerEnd_ = headerBegin_ + cached - 1;
+        columnCount_ = count;
+        for (size_t i = 0; i < count; ++i) columns_[i] = cache.columns[i];
+        return true;
+    }
+
+    if (!selectColumns(names, count)) return false;
+    cache.header.assign(data_ + headerBegin_, headerEnd_ - headerBegin_ + 1);
+    for (size_t i = 0; i < count; ++i) cache.columns[i] = columns_[i];
+    cache.count = count;
+    ++cache.resolves;
+    return true;
+}
+
+bool JsonTailReader::selectColumnIndices(std::initializer_list<int> indices) {
+    if (!ok() || empty_) return false;
+    if (indices.size() > maxColumns) {
+        error_ = "too many columns selected";
+        return false;
+    }
+    columnCount_ = 0;
+    for (int index : indices) columns_[columnCount_++] = index;
+    // Still walk the header so we know where the data rows start
+    return parseRow(headerBegin_, cursor_, true, nullptr, 0);
+}
+
+bool JsonTailReader::findRowStart(size_t end, size_t& begin) const {
+    // Walks back from the row's ']' to its '[' while skipping string contents.
+    // A quote is escaped if an odd number of backslashes precede it.
+    bool inString = false;
+    int depth = 0;
+    for (size_t pos = end; pos > headerEnd_; --pos) {
+        char c = data_[pos];
+        if (c == '"') {
+            size_t slashes = 0;
+            while (pos - slashes > 0 && data_[pos - slashes - 1] == '\\') ++slashes;
+            if (slashes % 2 == 0) inString = !inString;
+            continue;
+        }
+        if (inString) continue;
+        if (c == ']') {
+            ++depth;
+        } else if (c == '[') {
+            if (--depth == 0) {
+                begin = pos;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool JsonTailReader::previousRow() {
+    if (!ok() || headerEnd_ == headerBegin_) return false;
+
+    size_t pos = skipSpaceBack(cursor_ - 1);
+    if (pos <= headerEnd_) return false;  // only the header is left
+    if (data_[pos] == ',') pos = skipSpaceBack(pos - 1);
+    if (pos <= headerEnd_) return false;
+    if (data_[pos] != ']') {
+        error_ = "row is not an array";
+        return false;
+    }
+
+    size_t rowBegin = 0;
+    if (!findRowStart(pos, rowBegin)) {
+        error_ = "unbalanced row";
+        return false;
+    }
+    if (!parseRow(rowBegin, pos + 1, false, nullptr, 0)) return false;
+    cursor_ = rowBegin;
+    return true;
+}
+
+bool JsonTailReader::parseRow(size_t begin, size_t end, bool header, const char* const* names, size_t nameCount) {
+    if (!header) {
+        for (size_t i = 0; i < columnCount_; ++i) values_[i] = JsonScalar();
+    }
+
+    size_t pos = begin + 1;
+    int index = 0;
+    while (true) {
+        pos = skipSpaceForward(pos);
+        if (pos >= end) break;
+        if (data_[pos] == ']') {
+            if (header) headerEnd_ = pos;
+            return true;
+        }
+
+        JsonScalar value;
+        char c = data_[pos];
+        if (c == '"') {
+            size_t start = ++pos;
+            while (pos < end && data_[pos] != '"') {
+                if (data_[pos] == '\\') ++pos;
+                ++pos;
+            }
+            if (pos >= end) break;
+            value.type = JsonScalar::String;
+            value.data = data_ + start;
+            value.size = pos - start;
+            ++pos;
+        } else {
+            size_t start = pos;
+            while (pos < end && data_[pos] != ',' && data_[pos] != ']' && !isJsonSpace(data_[pos])) ++pos;
+            value.data = data_ + start;
+            value.size = pos - start;
+            if (value.size == 4 && memcmp(value.data, "null", 4) == 0) {
+                value.type = JsonScalar::Null;
+            } else if (c == 't' || c == 'f') {
+                value.type = JsonScalar::Boolean;
+            } else if (c == '-' || (c >= '0' && c <= '9')) {
+                value.type = JsonScalar::Number;
+            } else {
+                error_ = "unexpected token in row";
+                return false;
+            }
+        }
+
+        if (header) {
+            for (size_t slot = 0; slot < nameCount; ++slot) {
+                const char* name = names[slot];
+                if (value.type == JsonScalar::String && strlen(name) == value.size &&
+                    memcmp(name, value.data, value.size) == 0) {
+                    columns_[slot] = index;
+                }
+            }
+        } else {
+            for (size_t i = 0; i < columnCount_; ++i) {
+                if (columns_[i] == index) values_[i] = value;
+            }
+        }
+        ++index;
+
+        pos = skipSpaceForward(pos);
+        if (pos < end && data_[pos] == ',') ++pos;
+    }
+
+    error_ = "unterminated row";
+    return false;
+}
+
+JsonObjectReader::KeyCache::KeyCache(const char* const* names, size_t n) : count(n < maxKeys ? n : maxKeys) {
+    for (size_t i = 0; i < count; ++i) {
+        keys[i] = names[i];
+        sizes[i] = strlen(names[i]);
+        members[i] = -1;
+    }
+}
+
+JsonObjectReader::JsonObjectReader(const char* data, size_t size, KeyCache& cache)
+    : data_(data), size_(size), cache_(cache) {
+    size_t begin = skipSpace(0);
+    if (begin >= size_ || data_[begin] != '[') {
+        error_ = "response is not a JSON array";
+        return;
+    }
+    pos_ = begin + 1;
+}
+
+size_t JsonObjectReader::skipSpace(size_t pos) const {
+    while (pos < size_ && isJsonSpace(data_[pos])) ++pos;
+    return pos;
+}
+
+bool JsonObjectReader::nextObject() {
+    while (ok()) {
+        size_t pos = skipSpace(pos_);
+        if (pos >= size_) {
+            error_ = "unterminated array";
+            return false;
+        }
+        if (data_[pos] == ']') return false;
+
+        bool isObject = data_[pos] == '{';
+        if (isObject) {
+            objectBegin_ = pos;
+            // The cached layout first; on a mismatch, by name
+            if (!parseObject(false) && (!ok() || !parseObject(true))) return false;
+        } else {
+            // Items that are not objects are skipped
+            JsonScalar ignored;
+            if (!parseValue(pos, ignored)) return false;
+            pos_ = pos;
+        }
+
+        pos_ = skipSpace(pos_);
+        if (pos_ < size_ && data_[pos_] == ',') ++pos_;
+        if (isObject) return true;
+    }
+    return false;
+}
+
+bool JsonObjectReader::parseObject(bool byName) {
+    for (size_t i = 0; i < cache_.count; ++i) {
+        values_[i] = JsonScalar();
+        if (byName) cache_.members[i] = -1;
+    }
+    if (byName) ++cache_.resolves;
+
+    size_t found = 0;
+    size_t pos = skipSpace(objectBegin_ + 1);
+    int member = 0;
+    if (pos < size_ && data_[pos] == '}') {
+        ++pos;
+    } else {
+        while (true) {
+            JsonScalar key, value;
+            if (pos >= size_ || data_[pos] != '"' || !parseString(pos, key)) {
+                if (ok()) error_ = "malformed object key";
+                return false;
+            }
+            pos = skipSpace(pos);
+            if (pos >= size_ || data_[pos] != ':') {
+                error_ = "missing ':' in object";
+                return false;
+            }
+            pos = skipSpace(pos + 1);
+            if (!parseValue(pos, value)) return false;
+
+            for (size_t i = 0; i < cache_.count; ++i) {
+                bool sameKey = key.size == cache_.sizes[i] && memcmp(key.data, cache_.keys[i], key.size) == 0;
+                if (byName) {
+                    if (!sameKey) continue;
+                    cache_.members[i] = member;
+                } else if (cache_.members[i] != member) {
+                    continue;
+                } else if (!sameKey) {
+                    return false;  // laid out differently
+                }
+                values_[i] = value;
+                ++found;
+            }
+            ++member;
+
+            pos = skipSpace(pos);
+            if (pos < size_ && data_[pos] == ',') {
+                pos = skipSpace(pos + 1);
+                continue;
+            }
+            if (pos < size_ && data_[pos] == '}') {
+                ++pos;
+                break;
+            }
+            error_ = "unterminated object";
+            return false;
+        }
+    }
+
+    // A key missing from this object also sends it back to matching by name
+    if (!byName && found != cache_.count) return false;
+    pos_ = pos;
+    return true;
+}
+
+bool JsonObjectReader::parseString(size_t& pos, JsonScalar& out) {
+    size_t start = ++pos;
+    while (pos < size_ && data_[pos] != '"') {
+        if (data_[pos] == '\\') ++pos;
+        ++pos;
+    }
+    if (pos >= size_) {
+        error_ = "unterminated string";
+        return false;
+    }
+    out.type = JsonScalar::String;
+    out.data = data_ + start;
+    out.size = pos - start;
+    ++pos;
+    return true;
+}
+
+bool JsonObjectReader::parseValue(size_t& pos, JsonScalar& out) {
+    if (pos >= size_) {
+        error_ = "missing value";
+        return false;
+    }
+    char c = data_[pos];
+    if (c == '"') return parseString(pos, out);
+    // Nested objects and arrays are not read, only stepped over
+    if (c == '{' || c == '[') return skipNested(pos);
+
+    size_t start = pos;
+    while (pos < size_ && data_[pos] != ',' && data_[pos] != '}' && data_[pos] != ']' && !isJsonSpace(data_[pos])) {
+        ++pos;
+    }
+    out.data = data_ + start;
+    out.size = pos - start;
+    if (out.size == 4 && memcmp(out.data, "null", 4) == 0) {
+        out.type = JsonScalar::Null;
+    } else if (c == 't' || c == 'f') {
+        out.type = JsonScalar::Boolean;
+    } else if (c == '-' || (c >= '0' && c <= '9')) {
+        out.type = JsonScalar::Number;
+    } else {
+        error_ = "unexpected token in object";
+        return false;
+    }
+    return true;
+}
+
+bool JsonObjectReader::skipNested(size_t& pos) {
+    int depth = 0;
+    bool inString = false;
+    for (; pos < size_; ++pos) {
+        char c = data_[pos];
+        if (inString) {
+            if (c == '\\') {
+                ++pos;
+            } else if (c == '"') {
+                inString = false;
+            }
+        } else if (c == '"') {
+            inString = true;
+        } else if (c == '{' || c == '[') {
+            ++depth;
+        } else if ((c == '}' || c == ']') && --depth == 0) {
+            ++pos;
+            return true;
+        }
+    }
+    error_ = "unbalanced object";
+    return false;
+}
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+
+// One scalar of a row, pointing into the response buffer (no copies)
+struct JsonScalar {
+    enum Type { Missing, Null, String, Number, Boolean };
+
+    Type type = Missing;
+    const char* data = nullptr;  // string contents without quotes, or the literal
+    size_t size = 0;
+
+    // Empty, JSON null and the "null" strings NOAA uses for gaps
+    bool isNull() const;
+    std::string text() const { return data ? std::string(data, size) : std::string(); }
+};
+
+bool jsonScalarToFloat(const JsonScalar& value, float& out);
+bool jsonScalarToInt(const JsonScalar& value, int& out);
+
+// Reads the NOAA "array of arrays" products (header row first, then one row
+// per sample) starting from the end of the buffer. Only the rows that are
+// asked for are tokenized and only the selected columns are kept, so no DOM
+// is built and nothing is allocated.
+class JsonTailReader {
+public:
+    static const size_t maxColumns = 16;
+
+    // Column indices resolved from one header row. Kept by the caller
+    // between responses of the same product; while the header row is byte
+    // for byte the same, selecting columns is one memcmp.
+    struct ColumnCache {
+        std::string header;  // '[' to ']' of the header row the indices belong to
+        int columns[maxColumns];
+        size_t count = 0;
+        uint64_t resolves = 0;  // times the names had to be matched
+    };
+
+    JsonTailReader(const char* data, size_t size);
+    explicit JsonTailReader(const std::string& body) : JsonTailReader(body.data(), body.size()) {}
+
+    // Looks the names up in the header row; fails if any is missing, and
+    // without an error on an empty array
+    bool selectColumns(std::initializer_list<const char*> names);
+    bool selectColumns(const char* const* names, size_t count);
+    // The same, through the cache: names are only matched when the header
+    // row differs from the one the cache was filled from
+    bool selectColumns(const char* const* names, size_t count, ColumnCache& cache);
+    bool selectColumnIndices(std::initializer_list<int> indices);
+
+    // Steps to the previous data row, starting with the last one.
+    // Returns false once only the header row is left or on malformed input.
+    bool previousRow();
+
+    // Value of the i-th selected column in the current row
+    const JsonScalar& column(size_t i) const { return values_[i]; }
+    size_t columnCount() const { return columnCount_; }
+
+    bool ok() const { return error_ == nullptr; }
+    const char* error() const { return error_; }
+    // "[]": no header row and no data, but not malformed either
+    bool empty() const { return empty_; }
+
+private:
+    bool parseRow(size_t begin, size_t end, bool header, const char* const* names, size_t nameCount);
+    bool findRowStart(size_t end, size_t& begin) const;
+    size_t skipSpaceBack(size_t pos) const;
+    size_t skipSpaceForward(size_t pos) const;
+
+    const char* data_;
+    size_t size_;
+    size_t headerBegin_ = 0;    // '[' of the header row
+    size_t headerEnd_ = 0;      // ']' of the header row
+    size_t cursor_ = 0;         // '[' of the current row, or the closing ']' before the first step
+    int columns_[maxColumns];
+    JsonScalar values_[maxColumns];
+    size_t columnCount_ = 0;
+    bool empty_ = false;
+    const char* error_ = nullptr;
+};
+
+// Reads the NOAA "array of objects" products (solar_probabilities,
+// solar_regions) front to back, one flat object at a time, without a DOM.
+// Selected keys are found by their position in the object: the positions
+// are resolved by name once and kept in a KeyCache, and on later objects
+// and responses each one is only confirmed with a memcmp of the key. An
+// object laid out differently is matched by name again. Nested values are
+// skipped.
+class JsonObjectReader {
+public:
+    static const size_t maxKeys = JsonTailReader::maxColumns;
+
+    struct KeyCache {
+        const char* keys[maxKeys];
+        size_t sizes[maxKeys];
+        int members[maxKeys];  // position of the key in the object, -1: not seen yet
+        size_t count = 0;
+        uint64_t resolves = 0;  // objects whose keys had to be matched by name
+
+        KeyCache() = default;
+        KeyCache(const char* const* names, size_t count);
+    };
+
+    JsonObjectReader(const char* data, size_t size, KeyCache& cache);
+    JsonObjectReader(const std::string& body, KeyCache& cache) : JsonObjectReader(body.data(), body.size(), cache) {}
+
+    // Steps to the next object of the array, starting with the first one.
+    // Returns false at the end of the array or on malformed input.
+    bool nextObject();
+
+    // Value of the i-th key in the current object; Missing if it has none
+    const JsonScalar& value(size_t i) const { return values_[i]; }
+
+    bool ok() const { return error_ == nullptr; }
+    const char* error() const { return error_; }
+
+private:
+    bool parseObject(bool byName);
+    bool parseString(size_t& pos, JsonScalar& out);
+    bool parseValue(size_t& pos, JsonScalar& out);
+    bool skipNested(size_t& pos);
+    size_t skipSpace(size_t pos) const;
+
+    const char* data_;
+    size_t size_;
+    KeyCache& cache_;
+    size_t pos_ = 0;        // next object or the closing ']'
+    size_t objectBegin_ = 0;
+    JsonScalar values_[maxKeys];
+    const char* error_ = nullptr;
+};
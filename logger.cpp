@@ -0,0 +1,491 @@
+#include "logger.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// std::min() takes it by reference, which needs a definition before C++17
+const size_t LogRecord::payloadSize;
+
+Logger logger;
+
+namespace {
+
+// Payload fields: tag byte, then the value
+const char StringTag = 'S';    // u16 length + bytes
+const char IntegerTag = 'I';   // int64
+const char UnsignedTag = 'U';  // uint64
+const char DoubleTag = 'D';    // double + int8 digits
+
+uint32_t threadId() {
+    static std::atomic<uint32_t> next{1};
+    thread_local uint32_t id = next.fetch_add(1, std::memory_order_relaxed);
+    return id;
+}
+
+int64_t nowMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+const char* levelName(LogLevel level) {
+    switch (level) {
+        case LogLevel::Info: return "info";
+        case LogLevel::Warning: return "warning";
+        case LogLevel::Error: return "error";
+    }
+    return "";
+}
+
+// 2024-05-10T16:55:00.123Z
+void appendTime(std::string& out, int64_t micros) {
+    std::time_t seconds = (std::time_t)(micros / 1000000);
+    std::tm utc;
+    gmtime_r(&seconds, &utc);
+    char buffer[40];
+    size_t n = std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S", &utc);
+    snprintf(buffer + n, sizeof(buffer) - n, ".%03dZ", (int)(micros / 1000 % 1000));
+    out += buffer;
+}
+
+void appendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char escape[8];
+                    snprintf(escape, sizeof(escape), "\\u%04x", c);
+                    out += escape;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+// Payload -> text
+void formatPayload(const LogRecord& record, std::string& out) {
+    const char* p = record.payload;
+    const char* end = record.payload + record.size;
+    char number[64];
+    while (p < end) {
+        char tag = *p++;
+        if (tag == StringTag) {
+            uint16_t size;
+            memcpy(&size, p, sizeof(size));
+            p += sizeof(size);
+            out.append(p, size);
+            p += size;
+        } else if (tag == IntegerTag) {
+            int64_t value;
+            memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            snprintf(number, sizeof(number), "%lld", (long long)value);
+            out += number;
+        } else if (tag == UnsignedTag) {
+            uint64_t value;
+            memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            snprintf(number, sizeof(number), "%llu", (unsigned long long)value);
+            out += number;
+        } else if (tag == DoubleTag) {
+            double value;
+            memcpy(&value, p, sizeof(value));
+            p += sizeof(value);
+            int8_t digits = *p++;
+            if (digits < 0) {
+                snprintf(number, sizeof(number), "%g", value);
+            } else {
+                snprintf(number, sizeof(number), "%.*f", (int)digits, value);
+            }
+            out += number;
+        } else {
+            break;
+        }
+    }
+}
+
+void writeAll(int fd, const std::string& data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t n = ::write(fd, data.data() + done, data.size() - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        done += (size_t)n;
+    }
+}
+
+}  // namespace
+
+Logger::Logger(size_t capacity) {
+    capacity_ = 1;
+    while (capacity_ < capacity) capacity_ <<= 1;
+    slots_.reset(new Slot[capacity_]);
+    for (size_t i = 0; i < capacity_; ++i) slots_[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+Logger::~Logger() {
+    stop();
+}
+
+bool Logger::start(const LoggerOptions& options) {
+    if (running_) return true;
+    options_ = options;
+    colors_ = options_.terminal && options_.format == LogFormat::Text && isatty(STDERR_FILENO);
+    if (!options_.filePath.empty() && !openFile()) return false;
+
+    stopping_ = false;
+    running_ = true;
+    thread_ = std::thread(&Logger::run, this);
+    return true;
+}
+
+void Logger::stop() {
+    if (running_) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+        running_ = false;
+    } else {
+        // Never started (or already stopped): whatever is left goes out here
+        drain();
+    }
+    flushRepeats(nowMicros(), true);
+    writeOut();
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+// Bounded MPMC queue (Vyukov): a slot's sequence says whose turn it is
+bool Logger::push(const LogRecord& record) {
+    uint64_t position = head_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots_[position & (capacity_ - 1)];
+        uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        int64_t difference = (int64_t)(sequence - position);
+        if (difference == 0) {
+            if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+        } else if (difference < 0) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        } else {
+            position = head_.load(std::memory_order_relaxed);
+        }
+    }
+    memcpy(&slot->record, &record, offsetof(LogRecord, payload) + record.size);
+    slot->sequence.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+bool Logger::pop(LogRecord& record) {
+    Slot& slot = slots_[tail_ & (capacity_ - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != tail_ + 1) return false;
+    memcpy(&record, &slot.record, offsetof(LogRecord, payload) + slot.record.size);
+    slot.sequence.store(tail_ + capacity_, std::memory_order_release);
+    ++tail_;
+    return true;
+}
+
+void Logger::report(const std::string& text) {
+    // Set when an abort marker could not be pushed either: the writer may
+    // still hold this thread's partial report, so it is discarded first
+    static thread_local bool abortPending = false;
+
+    LogRecord record;
+    record.timeMicros = nowMicros();
+    record.source = "console";
+    record.thread = threadId();
+    record.level = LogLevel::Info;
+    if (abortPending) {
+        record.kind = LogRecord::ReportAbort;
+        record.size = 0;
+        if (!push(record)) return;
+        abortPending = false;
+    }
+
+    size_t offset = 0;
+    do {
+        size_t size = std::min(text.size() - offset, LogRecord::payloadSize);
+        record.kind = offset + size < text.size() ? LogRecord::ReportChunk : LogRecord::ReportEnd;
+        record.size = (uint16_t)size;
+        memcpy(record.payload, text.data() + offset, size);
+        if (!push(record)) {
+            // A lost chunk would glue the fragments around it together
+            if (offset > 0) {
+                record.kind = LogRecord::ReportAbort;
+                record.size = 0;
+                abortPending = !push(record);
+            }
+            return;
+        }
+        offset += size;
+    } while (offset < text.size());
+}
+
+// Woken every 20 ms: producers never signal, so pushing stays syscall-free
+void Logger::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        lock.unlock();
+        drain();
+        lock.lock();
+        wake_.wait_for(lock, std::chrono::milliseconds(20), [this] { return stopping_; });
+    }
+    lock.unlock();
+    drain();
+}
+
+void Logger::drain() {
+    LogRecord record;
+    size_t batch = 0;
+    while (pop(record)) {
+        handle(record);
+        if (++batch % 256 == 0) writeOut();
+    }
+    int64_t now = nowMicros();
+    if (now - lastRepeatSweep_ >= 1000000) {
+        flushRepeats(now, false);
+        lastRepeatSweep_ = now;
+    }
+    writeOut();
+}
+
+void Logger::handle(const LogRecord& record) {
+    if (record.kind == LogRecord::ReportAbort) {
+        partialReports_.erase(record.thread);
+        return;
+    }
+    if (record.kind != LogRecord::Message) {
+        std::string& partial = partialReports_[record.thread];
+        partial.append(record.payload, record.size);
+        if (record.kind == LogRecord::ReportEnd) {
+            emit(record.timeMicros, record.level, record.source, partial, true);
+            partialReports_.erase(record.thread);
+        }
+        return;
+    }
+
+    text_.clear();
+    formatPayload(record, text_);
+    if (record.level != LogLevel::Info && options_.repeatWindowSeconds > 0) {
+        // The first occurrence is written, the rest of the window only counted
+        std::string key = std::string(record.source) + '\n' + text_;
+        auto it = repeats_.find(key);
+        if (it != repeats_.end()) {
+            ++it->second.count;
+            suppressed_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        repeats_[key] = Repeat{record.timeMicros, 0, record.level, record.source, text_};
+    }
+    emit(record.timeMicros, record.level, record.source, text_, false);
+}
+
+// Closes repeat windows that ran out, writing how often they repeated
+void Logger::flushRepeats(int64_t nowMicros, bool all) {
+    int64_t window = (int64_t)options_.repeatWindowSeconds * 1000000;
+    for (auto it = repeats_.begin(); it != repeats_.end();) {
+        const Repeat& repeat = it->second;
+        if (!all && nowMicros - repeat.windowStart < window) {
+            ++it;
+            continue;
+        }
+        if (repeat.count > 0) {
+            emit(nowMicros, repeat.level, repeat.source,
+                 repeat.text + " (repeated " + std::to_string(repeat.count) + " more times)", false);
+        }
+        it = repeats_.erase(it);
+    }
+}
+
+void Logger::emit(int64_t timeMicros, LogLevel level, const char* source, const std::string& text,
+                  bool isReport) {
+    std::string json;
+    if (options_.format == LogFormat::Json) {
+        json = "{\"time\":\"";
+        appendTime(json, timeMicros);
+        json += "\",\"level\":\"";
+        json += levelName(level);
+        json += "\",\"source\":\"";
+        json += source;
+        json += "\",\"message\":";
+        appendJsonString(json, text);
+        json += "}\n";
+    }
+
+    if (options_.terminal && (!options_.quiet || level != LogLevel::Info)) {
+        int fd = level == LogLevel::Info ? STDOUT_FILENO : STDERR_FILENO;
+        std::string& batch = fd == STDOUT_FILENO ? stdoutBatch_ : stderrBatch_;
+        // Keep stdout and stderr in order on a shared terminal
+        std::string& other = fd == STDOUT_FILENO ? stderrBatch_ : stdoutBatch_;
+        if (!other.empty()) {
+            writeAll(fd == STDOUT_FILENO ? STDERR_FILENO : STDOUT_FILENO, other);
+            other.clear();
+        }
+        if (options_.format == LogFormat::Json) {
+            batch += json;
+        } else {
+            if (colors_ && level != LogLevel::Info) batch += level == LogLevel::Error ? "\033[31m" : "\033[33m";
+            batch += text;
+            if (colors_ && level != LogLevel::Info) batch += "\033[0m";
+            if (!isReport) batch += '\n';
+        }
+    }
+
+    if (fd_ >= 0) {
+        if (options_.format == LogFormat::Json) {
+            fileBatch_ += json;
+        } else if (isReport) {
+            fileBatch_ += text;
+        } else {
+            appendTime(fileBatch_, timeMicros);
+            fileBatch_ += ' ';
+            fileBatch_ += levelName(level);
+            fileBatch_ += ' ';
+            fileBatch_ += source;
+            fileBatch_ += ": ";
+            fileBatch_ += text;
+            fileBatch_ += '\n';
+        }
+    }
+    written_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Logger::writeOut() {
+    if (!stdoutBatch_.empty()) writeAll(STDOUT_FILENO, stdoutBatch_);
+    if (!stderrBatch_.empty()) writeAll(STDERR_FILENO, stderrBatch_);
+    stdoutBatch_.clear();
+    stderrBatch_.clear();
+
+    if (fd_ >= 0 && !fileBatch_.empty()) {
+        if (fileBytes_ > 0 && fileBytes_ + fileBatch_.size() > options_.maxFileBytes) rotate();
+        if (fd_ >= 0) {
+            writeAll(fd_, fileBatch_);
+            fileBytes_ += fileBatch_.size();
+        }
+    }
+    fileBatch_.clear();
+}
+
+bool Logger::openFile() {
+    fd_ = ::open(options_.filePath.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        error_ = options_.filePath + ": " + strerror(errno);
+        return false;
+    }
+    struct stat st;
+    fileBytes_ = fstat(fd_, &st) == 0 ? (size_t)st.st_size : 0;
+    return true;
+}
+
+// path -> path.1 -> ... -> path.N, the oldest falls off
+void Logger::rotate() {
+    ::close(fd_);
+    fd_ = -1;
+    const std::string& path = options_.filePath;
+    if (options_.keepFiles > 0) {
+        for (int i = options_.keepFiles - 1; i >= 1; --i) {
+            std::rename((path + "." + std::to_string(i)).c_str(), (path + "." + std::to_string(i + 1)).c_str());
+        }
+        std::rename(path.c_str(), (path + ".1").c_str());
+    } else {
+        unlink(path.c_str());
+    }
+    openFile();
+}
+
+LogLine::LogLine(Logger& logger, LogLevel level, const char* source) : logger_(&logger) {
+    record_.timeMicros = nowMicros();
+    record_.source = source;
+    record_.thread = threadId();
+    record_.level = level;
+    record_.kind = LogRecord::Message;
+    record_.size = 0;
+}
+
+LogLine::LogLine(LogLine&& other) : logger_(other.logger_), digits_(other.digits_) {
+    memcpy(&record_, &other.record_, offsetof(LogRecord, payload) + other.record_.size);
+    other.logger_ = nullptr;
+}
+
+LogLine::~LogLine() {
+    if (logger_) logger_->push(record_);
+}
+
+LogLine& LogLine::text(const char* data, size_t size) {
+    size_t room = LogRecord::payloadSize - record_.size;
+    if (room <= 1 + sizeof(uint16_t)) return *this;
+    size = std::min(size, room - 1 - sizeof(uint16_t));
+    char* p = record_.payload + record_.size;
+    *p++ = StringTag;
+    uint16_t length = (uint16_t)size;
+    memcpy(p, &length, sizeof(length));
+    memcpy(p + sizeof(length), data, size);
+    record_.size += (uint16_t)(1 + sizeof(length) + size);
+    return *this;
+}
+
+LogLine& LogLine::operator<<(const char* text) {
+    return this->text(text, strlen(text));
+}
+
+LogLine& LogLine::operator<<(const std::string& text) {
+    return this->text(text.data(), text.size());
+}
+
+LogLine& LogLine::operator<<(char c) {
+    return text(&c, 1);
+}
+
+LogLine& LogLine::integer(int64_t value) {
+    if (LogRecord::payloadSize - record_.size < 1 + sizeof(value)) return *this;
+    char* p = record_.payload + record_.size;
+    *p = IntegerTag;
+    memcpy(p + 1, &value, sizeof(value));
+    record_.size += (uint16_t)(1 + sizeof(value));
+    return *this;
+}
+
+LogLine& LogLine::unsignedInteger(uint64_t value) {
+    if (LogRecord::payloadSize - record_.size < 1 + sizeof(value)) return *this;
+    char* p = record_.payload + record_.size;
+    *p = UnsignedTag;
+    memcpy(p + 1, &value, sizeof(value));
+    record_.size += (uint16_t)(1 + sizeof(value));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(double value) {
+    if (LogRecord::payloadSize - record_.size < 2 + sizeof(value)) return *this;
+    char* p = record_.payload + record_.size;
+    *p = DoubleTag;
+    memcpy(p + 1, &value, sizeof(value));
+    p[1 + sizeof(value)] = (char)digits_;
+    record_.size += (uint16_t)(2 + sizeof(value));
+    return *this;
+}
+
+LogLine& LogLine::operator<<(LogFixed fixed) {
+    digits_ = (int8_t)std::max(-1, std::min(fixed.digits, 20));
+    return *this;
+}
@@ -0,0 +1,179 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+enum class LogLevel : uint8_t { Info, Warning, Error };
+enum class LogFormat { Text, Json };
+
+struct LoggerOptions {
+    LogFormat format = LogFormat::Text;
+    bool terminal = true;             // stdout (info, reports) and stderr (warnings, errors)
+    bool quiet = false;               // terminal: warnings and errors only
+    std::string filePath;             // everything, rotated by size; empty: no file
+    size_t maxFileBytes = 10 << 20;
+    int keepFiles = 3;                // path.1 ... path.N
+    int repeatWindowSeconds = 10;     // identical warnings/errors within it are counted, not written
+};
+
+// One ring slot. Values are stored as tagged binary fields and only turned
+// into text by the writer thread.
+struct LogRecord {
+    static const size_t payloadSize = 232;
+    // ReportAbort: the rest of the report was dropped, discard what arrived
+    enum Kind : uint8_t { Message, ReportChunk, ReportEnd, ReportAbort };
+
+    int64_t timeMicros;      // Unix microseconds
+    const char* source;      // string literal: "fetch", "osc" ...
+    uint32_t thread;         // small per-thread id, keeps report chunks apart
+    LogLevel level;
+    Kind kind;
+    uint16_t size;           // payload bytes used
+    char payload[payloadSize];
+};
+
+// Asynchronous logger. Producers copy a fixed-size record into a bounded
+// lock-free ring (no locks, no allocation, no syscalls) and never block: when
+// the ring is full the record is dropped and counted. A background thread
+// formats, colours, folds repeated warnings and errors, and writes batches
+// to the terminal and to a size-rotated file, as text or JSON lines.
+class Logger {
+public:
+    explicit Logger(size_t capacity = 4096);
+    ~Logger();
+
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    // Records pushed before start() are kept and written once it runs
+    bool start(const LoggerOptions& options);
+    // Writes everything pushed so far, then stops the writer thread
+    void stop();
+    const std::string& error() const { return error_; }
+
+    // Returns false (and counts a drop) if the ring is full
+    bool push(const LogRecord& record);
+    // A multi-line block, written as is (the console screens). Written whole
+    // or not at all: if the ring is full, the chunks already pushed are
+    // discarded.
+    void report(const std::string& text);
+
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+    uint64_t suppressed() const { return suppressed_.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence;
+        LogRecord record;
+    };
+    struct Repeat {
+        int64_t windowStart;
+        uint64_t count;
+        LogLevel level;
+        const char* source;
+        std::string text;
+    };
+
+    bool pop(LogRecord& record);
+    void run();
+    void drain();
+    void handle(const LogRecord& record);
+    void emit(int64_t timeMicros, LogLevel level, const char* source, const std::string& text, bool isReport);
+    void flushRepeats(int64_t nowMicros, bool all);
+    void writeOut();
+    bool openFile();
+    void rotate();
+
+    size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    alignas(64) std::atomic<uint64_t> head_{0};
+    alignas(64) uint64_t tail_ = 0;  // writer thread only
+
+    LoggerOptions options_;
+    std::string error_;
+    bool colors_ = false;
+    int fd_ = -1;
+    size_t fileBytes_ = 0;
+
+    // Writer-thread state
+    std::unordered_map<uint32_t, std::string> partialReports_;
+    std::unordered_map<std::string, Repeat> repeats_;
+    int64_t lastRepeatSweep_ = 0;
+    std::string stdoutBatch_, stderrBatch_, fileBatch_;
+    std::string text_;
+
+    std::thread thread_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+    std::atomic<bool> running_{false};
+
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+    std::atomic<uint64_t> suppressed_{0};
+};
+
+extern Logger logger;
+
+// Fixed decimals for the floating-point values that follow
+struct LogFixed {
+    int digits;
+};
+inline LogFixed logFixed(int digits) {
+    return LogFixed{digits};
+}
+
+// Builds one record on the stack and pushes it when it goes out of scope:
+//
+//     logError("fetch") << "Fetch of " << url << " failed: HTTP " << status;
+//
+// Strings are copied (cut short if the record fills up), numbers are stored
+// as binary and formatted by the writer thread.
+class LogLine {
+public:
+    LogLine(Logger& logger, LogLevel level, const char* source);
+    LogLine(LogLine&& other);
+    ~LogLine();
+
+    LogLine(const LogLine&) = delete;
+    LogLine& operator=(const LogLine&) = delete;
+
+    LogLine& operator<<(const char* text);
+    LogLine& operator<<(const std::string& text);
+    LogLine& operator<<(char c);
+    LogLine& operator<<(int value) { return integer(value); }
+    LogLine& operator<<(long value) { return integer(value); }
+    LogLine& operator<<(long long value) { return integer(value); }
+    LogLine& operator<<(unsigned value) { return unsignedInteger(value); }
+    LogLine& operator<<(unsigned long value) { return unsignedInteger(value); }
+    LogLine& operator<<(unsigned long long value) { return unsignedInteger(value); }
+    LogLine& operator<<(double value);
+    LogLine& operator<<(LogFixed fixed);
+
+private:
+    LogLine& text(const char* data, size_t size);
+    LogLine& integer(int64_t value);
+    LogLine& unsignedInteger(uint64_t value);
+
+    Logger* logger_;
+    int8_t digits_ = -1;  // -1: shortest form
+    LogRecord record_;
+};
+
+inline LogLine logInfo(const char* source) {
+    return LogLine(logger, LogLevel::Info, source);
+}
+inline LogLine logWarning(const char* source) {
+    return LogLine(logger, LogLevel::Warning, source);
+}
+inline LogLine logError(const char* source) {
+    return LogLine(logger, LogLevel::Error, source);
+}
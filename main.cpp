@@ -4,504 +4,1498 @@
 #include <thread>
 #include <chrono>
 #include <curl/curl.h>
-#include "nlohmann/json.hpp"
-#include <arpa/inet.h>
-#include <unistd.h>
 #include <iomanip>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
 #include <csignal>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "derived.h"
+#include "feed_schema.h"
+#include "fetcher.h"
+#include "history_store.h"
+#include "json_tail.h"
+#include "logger.h"
+#include "metrics.h"
+#include "mock_noaa.h"
+#include "osc.h"
+#include "osc_control.h"
+#include "osc_sink.h"
+#include "recorder.h"
+#include "scheduler.h"
+#include "seqlock.h"
+#include "shm_output.h"
+#include "stream.h"
+#include "timeseries.h"
 
 volatile sig_atomic_t running = 0;
+// Читается обработчиком сигнала на любом потоке: атомарный и без блокировок
+std::atomic<FeedFetcher*> activeFetcher{nullptr};
+static_assert(ATOMIC_POINTER_LOCK_FREE == 2, "the signal handler needs a lock-free pointer");
 
-void signalHandler(int signal) {
+void signalHandler(int) {
     running = 0;
-    std::cout << "\nTermination signal received. Terminating..." << std::endl;
+    // Cut the current poll short (curl_multi_wakeup only writes to a socket)
+    FeedFetcher* fetcher = activeFetcher.load(std::memory_order_relaxed);
+    if (fetcher) fetcher->wakeup();
+    // Only async-signal-safe calls here: no streams, no locks, no logger
+    static const char message[] = "\nTermination signal received. Terminating...\n";
+    if (write(STDOUT_FILENO, message, sizeof(message) - 1) < 0) return;
 }
 
-using json = nlohmann::json;
+// Поля в порядке колонок архива; те же номера видят читатели общей памяти (solar_shm.h)
+enum ArchiveField {
+    DensityField = SOLAR_SHM_DENSITY, SpeedField = SOLAR_SHM_SPEED, TemperatureField = SOLAR_SHM_TEMPERATURE,
+    MClassField = SOLAR_SHM_M_CLASS, XClassField = SOLAR_SHM_X_CLASS, LonGsmField = SOLAR_SHM_LON_GSM,
+    BtField = SOLAR_SHM_BT, BzGsmField = SOLAR_SHM_BZ_GSM, ByGsmField = SOLAR_SHM_BY_GSM, KpField = SOLAR_SHM_KP,
+    RegionsField = SOLAR_SHM_REGIONS,
+    ArchiveFieldCount
+};
+static_assert(ArchiveFieldCount <= SOLAR_SHM_MAX_FIELDS, "shared memory holds SOLAR_SHM_MAX_FIELDS fields");
 
-// Структура для хранения всех солнечных данных + флаги валидности
+// Последние значения всех полей по номеру поля + флаги валидности
 struct SolarData {
-    float density = 0.0f;
-    float speed = 0.0f;
-    float temperature = 0.0f;
-    int m_class = 0;
-    int x_class = 0;
-    float lon_gsm = 0.0f;
-    float bt = 0.0f;
-    float bz_gsm = 0.0f;
-    float kp = 0.0f;
-    
-    bool density_valid = false;
-    bool speed_valid = false;
-    bool temperature_valid = false;
-    bool m_class_valid = false;
-    bool x_class_valid = false;
-    bool lon_gsm_valid = false;
-    bool bt_valid = false;
-    bool bz_gsm_valid = false;
-    bool kp_valid = false;
+    float values[ArchiveFieldCount] = {};
+    // Время данных (Unix, сек): time_tag строки NOAA, для вероятностей и
+    // областей - момент получения. 0, пока данных не было
+    int64_t times[ArchiveFieldCount] = {};
+    uint32_t validMask = 0;
+
+    bool valid(size_t field) const { return ((validMask >> field) & 1u) != 0; }
 };
 
-// Глобальный объект для хранения последних валидных данных
-SolarData lastValidData;
+// Последние валидные данные. Обработчики фидов публикуют снимок целиком,
+// читатели (OSC, консоль) получают согласованную копию без блокировок
+Seqlock<SolarData> solarSnapshot;
+
+// Архив снимков на диске (--history), по строке на публикацию
+HistoryStore archive;
+
+// Запись сырых ответов NOAA (--record) для последующего --replay
+FeedRecorder recorder;
+
+// Общая память для программ на этой же машине (--shm)
+SharedMemoryOutput sharedOutput;
+
+// При воспроизведении (--replay) время идёт по записи, а не по часам;
+// атомарно: его читают и другие потоки (метрики по HTTP)
+std::atomic<int64_t> replayClockMillis{0};
+
+int64_t unixNow() {
+    int64_t replayMillis = replayClockMillis.load(std::memory_order_relaxed);
+    if (replayMillis) return replayMillis / 1000;
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Архив перестал расти (диск, mmap): сообщается один раз, пока запись не наладится
+bool archiveFailing = false;  // под блокировкой снимка
+
+// Публикует снимок и дописывает его в архив; порядок строк в архиве
+// совпадает с порядком публикаций
+template <typename F>
+SolarData publishSnapshot(F mutate) {
+    return solarSnapshot.update([&](SolarData& d) {
+        mutate(d);
+        if (archive.isOpen()) {
+            bool appended = archive.append(unixNow(), d.validMask, d.values, d.times);
+            if (!appended && !archiveFailing) {
+                logError("history") << "History is not growing, new rows are not archived: " << archive.error();
+            } else if (appended && archiveFailing) {
+                logInfo("history") << "History is growing again";
+            }
+            archiveFailing = !appended;
+        }
+        if (sharedOutput.isOpen()) sharedOutput.publishSnapshot(d.validMask, d.values, d.times);
+    });
+}
+
+// Один открытый сокет на все адресаты OSC
+OSCSender oscSender;
+
+// Typed OSC arguments by default, --osc-strings keeps the old ",s" payloads
+OSCValueMode oscValueMode = OSCValueMode::Typed;
+
+// Счётчики и гистограммы этапов: /metrics/* по OSC и Prometheus (--metrics-*)
+MetricsRegistry metrics;
+
+// OSC-адреса, выровненные на этапе компиляции
+constexpr auto densAddress = oscAddress("/dens");
+constexpr auto speedAddress = oscAddress("/speed");
+constexpr auto tempAddress = oscAddress("/temp");
+constexpr auto mXrayAddress = oscAddress("/m_xray");
+constexpr auto xXrayAddress = oscAddress("/x_xray");
+constexpr auto phiGsmAddress = oscAddress("/phiGSM");
+constexpr auto btAddress = oscAddress("/bt");
+constexpr auto bzGsmAddress = oscAddress("/bzGSM");
+constexpr auto byGsmAddress = oscAddress("/byGSM");
+constexpr auto kpAddress = oscAddress("/kp");
+constexpr auto regionsAddress = oscAddress("/regions");
+
+// Каждая новая строка NOAA уходит отдельным сэмплом (timetag + значение)
+constexpr auto densSampleAddress = oscAddress("/dens/sample");
+constexpr auto speedSampleAddress = oscAddress("/speed/sample");
+constexpr auto tempSampleAddress = oscAddress("/temp/sample");
+constexpr auto phiGsmSampleAddress = oscAddress("/phiGSM/sample");
+constexpr auto btSampleAddress = oscAddress("/bt/sample");
+constexpr auto bzGsmSampleAddress = oscAddress("/bzGSM/sample");
+constexpr auto byGsmSampleAddress = oscAddress("/byGSM/sample");
+constexpr auto kpSampleAddress = oscAddress("/kp/sample");
+
+// История в памяти: 7 суток минутных строк, Kp раз в 3 часа
+TimeSeriesTable plasmaSeries(7 * 24 * 60, 3);   // density, speed, temperature
+TimeSeriesTable magSeries(7 * 24 * 60, 4);      // lon_gsm, bt, bz_gsm, by_gsm
+TimeSeriesTable kpSeries(512, 1);               // kp
+
+// История пишется обработчиками фидов и читается консолью
+std::mutex historyMutex;
+
+// Интерполированный поток (--stream-hz), выключен по умолчанию
+std::unique_ptr<InterpolatedStream> smoothStream;
+const size_t noStreamChannel = (size_t)-1;
+size_t fieldStreamChannels[ArchiveFieldCount];  // канал потока по полю, noStreamChannel - без него
+
+constexpr auto densSmoothAddress = oscAddress("/dens/smooth");
+constexpr auto speedSmoothAddress = oscAddress("/speed/smooth");
+constexpr auto tempSmoothAddress = oscAddress("/temp/smooth");
+constexpr auto phiGsmSmoothAddress = oscAddress("/phiGSM/smooth");
+constexpr auto btSmoothAddress = oscAddress("/bt/smooth");
+constexpr auto bzGsmSmoothAddress = oscAddress("/bzGSM/smooth");
+constexpr auto byGsmSmoothAddress = oscAddress("/byGSM/smooth");
+constexpr auto kpSmoothAddress = oscAddress("/kp/smooth");
+
+// Производные индексы по истории плазмы и магнитометра (--derived-windows)
+std::unique_ptr<DerivedIndices> derivedIndices;
+DerivedIndices::Result lastDerived;             // для консоли, под historyMutex
+std::vector<std::string> derivedStatAddresses;  // [окно * серия * 4]: mean, std, min, max
+LatencyHistogram derivedTime;
+
+constexpr auto pdynAddress = oscAddress("/derived/pdyn");
+constexpr auto newellAddress = oscAddress("/derived/newell");
+constexpr auto epsilonAddress = oscAddress("/derived/epsilon");
+constexpr auto bzSouthAddress = oscAddress("/derived/bz_south_minutes");
+
+// Схема фидов: по строке на поле, в порядке колонок архива. Новое поле NOAA -
+// строка здесь (и в ArchiveField), новый продукт - строка в feedTable
+constexpr FieldSpec fieldTable[ArchiveFieldCount] = {
+    {"density", "density", FieldType::Float, 3, densAddress, densSampleAddress, densSmoothAddress},
+    {"speed", "speed", FieldType::Float, 2, speedAddress, speedSampleAddress, speedSmoothAddress},
+    {"temperature", "temperature", FieldType::Float, 3, tempAddress, tempSampleAddress, tempSmoothAddress},
+    {"m_class", "m_class_1_day", FieldType::Int, 0, mXrayAddress, noOscAddress, noOscAddress},
+    {"x_class", "x_class_1_day", FieldType::Int, 0, xXrayAddress, noOscAddress, noOscAddress},
+    {"lon_gsm", "lon_gsm", FieldType::Float, 3, phiGsmAddress, phiGsmSampleAddress, phiGsmSmoothAddress},
+    {"bt", "bt", FieldType::Float, 2, btAddress, btSampleAddress, btSmoothAddress},
+    {"bz_gsm", "bz_gsm", FieldType::Float, 3, bzGsmAddress, bzGsmSampleAddress, bzGsmSmoothAddress},
+    {"by_gsm", "by_gsm", FieldType::Float, 3, byGsmAddress, byGsmSampleAddress, byGsmSmoothAddress},
+    {"kp", "Kp", FieldType::Float, 2, kpAddress, kpSampleAddress, kpSmoothAddress},
+    {"regions", "observed_date", FieldType::Int, 0, regionsAddress, noOscAddress, noOscAddress},
+};
+
+// Продукты NOAA; поля каждого - подряд идущие строки fieldTable, у табличных
+// история с колонкой на поле. Минутные продукты опрашиваются каждую минуту,
+// медленные реже и отступают, пока не меняются
+constexpr FeedSpec feedTable[] = {
+    {"solar wind", "https://services.swpc.noaa.gov/products/solar-wind/plasma-5-minute.json", FeedShape::Table,
+     60, 120, DensityField, 3, &plasmaSeries},
+    {"magnetometer", "https://services.swpc.noaa.gov/products/solar-wind/mag-5-minute.json", FeedShape::Table,
+     60, 120, LonGsmField, 4, &magSeries},
+    // Kp is published every 3 hours
+    {"Kp-index", "https://services.swpc.noaa.gov/products/noaa-planetary-k-index.json", FeedShape::Table,
+     10 * 60, 30 * 60, KpField, 1, &kpSeries},
+    // Flare probabilities change about once a day
+    {"solar probabilities", "https://services.swpc.noaa.gov/json/solar_probabilities.json", FeedShape::FirstObject,
+     30 * 60, 2 * 3600, MClassField, 2, nullptr},
+    {"solar regions", "https://services.swpc.noaa.gov/json/solar_regions.json", FeedShape::LatestCount,
+     60 * 60, 3 * 3600, RegionsField, 1, nullptr},
+};
+
+// Поля фидов не выходят за fieldTable и помещаются в строку JsonTailReader
+constexpr bool feedTableValid() {
+    for (const FeedSpec& spec : feedTable) {
+        if (spec.fieldCount == 0 || spec.firstField + spec.fieldCount > ArchiveFieldCount) return false;
+        if (spec.fieldCount + 1 > JsonTailReader::maxColumns) return false;
+    }
+    return true;
+}
+static_assert(feedTableValid(), "feedTable refers to fields outside fieldTable");
+
+// Заголовки OSC по полю, закодированные один раз под oscValueMode
+OSCMessageHeader latestHeaders[ArchiveFieldCount];
+OSCMessageHeader sampleHeaders[ArchiveFieldCount];  // пустой - поле без сэмплов
+
+// Фид схемы во время работы
+struct Feed {
+    const FeedSpec* spec;
+    std::unique_ptr<FeedExtractor> extractor;
+    size_t newRows = 0;  // строк принято за текущий цикл, под historyMutex
+    LatencyHistogram* parseTime = nullptr;  // solar_parse_seconds фида
+
+    // Итог последнего processFeed() для sendFeed(); фид обрабатывается одним воркером за раз
+    bool pendingSend = false;
+    SolarData sent;
+    std::vector<FeedRow> rows;
+    DerivedIndices::Result derived;
+    bool haveDerived = false;
+};
+std::vector<std::unique_ptr<Feed>> schemaFeeds;
+
+// Собирает схему при запуске: извлекатель на фид, заголовки OSC на поле
+void compileSchema() {
+    for (size_t f = 0; f < ArchiveFieldCount; ++f) {
+        const FieldSpec& field = fieldTable[f];
+        OSCMessageHeader::Argument argument =
+            field.type == FieldType::Int ? OSCMessageHeader::Int : OSCMessageHeader::Float;
+        latestHeaders[f] = OSCMessageHeader(field.address, argument, oscValueMode);
+        if (field.sample.size) {
+            sampleHeaders[f] = OSCMessageHeader(field.sample, OSCMessageHeader::Sample, oscValueMode);
+        }
+        fieldStreamChannels[f] = noStreamChannel;
+    }
+    for (const FeedSpec& spec : feedTable) {
+        schemaFeeds.push_back(std::unique_ptr<Feed>(new Feed));
+        schemaFeeds.back()->spec = &spec;
+        schemaFeeds.back()->extractor.reset(new FeedExtractor(spec, fieldTable));
+    }
+}
 
 // Простой и чистый вывод всех данных
-void printSolarData(const SolarData& data) {
+void printSolarData(std::ostream& out, const SolarData& data) {
     auto now = std::chrono::system_clock::now();
     std::time_t nowTime = std::chrono::system_clock::to_time_t(now);
     std::tm* localTime = std::localtime(&nowTime);
     char timeBuffer[9];
     std::strftime(timeBuffer, sizeof(timeBuffer), "%H:%M:%S", localTime);
     
-    std::cout << "\n";
-    std::cout << "─────────────────────────────────────────" << std::endl;
-    std::cout << "  SOLAR DATA UPDATE: " << timeBuffer << std::endl;
-    std::cout << "─────────────────────────────────────────" << std::endl;
+    out << "\n";
+    out << "─────────────────────────────────────────\n";
+    out << "  SOLAR DATA UPDATE: " << timeBuffer << "\n";
+    out << "─────────────────────────────────────────\n";
     
     // Solar Wind
-    std::cout << "  SOLAR WIND                                         " << std::endl;
-    std::cout << "    • Density:     " << std::fixed << std::setprecision(2) 
-              << std::setw(6) << data.density << " p/cc" << std::endl;
-    std::cout << "    • Speed:       " << std::fixed << std::setprecision(1) 
-              << std::setw(6) << data.speed << " km/s" << std::endl;
+    out << "  SOLAR WIND                                         \n";
+    out << "    • Density:     " << std::fixed << std::setprecision(2) 
+        << std::setw(6) << data.values[DensityField] << " p/cc\n";
+    out << "    • Speed:       " << std::fixed << std::setprecision(1) 
+        << std::setw(6) << data.values[SpeedField] << " km/s\n";
     
     // Temperature formatting
     std::string tempStr;
     std::stringstream tempSs;
-    if (data.temperature >= 1000.0f) {
-        tempSs << std::fixed << std::setprecision(1) << (data.temperature / 1000.0f) << "k";
+    float temperature = data.values[TemperatureField];
+    if (temperature >= 1000.0f) {
+        tempSs << std::fixed << std::setprecision(1) << (temperature / 1000.0f) << "k";
         tempStr = tempSs.str();
     } else {
-        tempSs << std::fixed << std::setprecision(0) << data.temperature;
+        tempSs << std::fixed << std::setprecision(0) << temperature;
         tempStr = tempSs.str();
     }
-    std::cout << "    • Temperature: " << std::setw(6) << tempStr << " K" << std::endl;
+    out << "    • Temperature: " << std::setw(6) << tempStr << " K\n";
     
-    std::cout << "                                                    " << std::endl;
+    out << "                                                    \n";
     
     // Flares
-    std::cout << "  SOLAR FLARES (1-day probability)                  " << std::endl;
-    std::cout << "    • M-class:     " << std::setw(3) << data.m_class << "%" << std::endl;
-    std::cout << "    • X-class:     " << std::setw(3) << data.x_class << "%" << std::endl;
+    out << "  SOLAR FLARES (1-day probability)                  \n";
+    out << "    • M-class:     " << std::setw(3) << (int)data.values[MClassField] << "%\n";
+    out << "    • X-class:     " << std::setw(3) << (int)data.values[XClassField] << "%\n";
     
-    std::cout << "                                                    " << std::endl;
+    out << "                                                    \n";
     
     // Magnetometer
-    std::cout << "  MAGNETOMETER                                      " << std::endl;
-    std::cout << "    • Phi GSM:     " << std::fixed << std::setprecision(2) 
-              << std::setw(6) << data.lon_gsm << "°" << std::endl;
-    std::cout << "    • Bt:          " << std::fixed << std::setprecision(2) 
-              << std::setw(6) << data.bt << " nT" << std::endl;
-    std::cout << "    • Bz GSM:      " << std::fixed << std::setprecision(2) 
-              << std::setw(6) << data.bz_gsm << " nT" << std::endl;
+    out << "  MAGNETOMETER                                      \n";
+    out << "    • Phi GSM:     " << std::fixed << std::setprecision(2) 
+        << std::setw(6) << data.values[LonGsmField] << "°\n";
+    out << "    • Bt:          " << std::fixed << std::setprecision(2) 
+        << std::setw(6) << data.values[BtField] << " nT\n";
+    out << "    • Bz GSM:      " << std::fixed << std::setprecision(2) 
+        << std::setw(6) << data.values[BzGsmField] << " nT\n";
+    out << "    • By GSM:      " << std::fixed << std::setprecision(2)
+        << std::setw(6) << data.values[ByGsmField] << " nT\n";
     
-    std::cout << "                                                    " << std::endl;
+    out << "                                                    \n";
     
     // Kp-index
-    std::cout << "  PLANETARY K-INDEX                                 " << std::endl;
-    std::cout << "    • Kp:          " << std::fixed << std::setprecision(1) 
-              << std::setw(4) << data.kp << std::endl;
+    out << "  PLANETARY K-INDEX                                 \n";
+    out << "    • Kp:          " << std::fixed << std::setprecision(1) 
+        << std::setw(4) << data.values[KpField] << "\n";
+    
+    out << "                                                    \n";
     
-    std::cout << "─────────────────────────────────────────" << std::endl;
+    // Active regions
+    out << "  ACTIVE REGIONS                                    \n";
+    out << "    • Numbered:    " << std::setw(3) << (int)data.values[RegionsField] << "\n";
+    
+    out << "─────────────────────────────────────────\n";
+}
+
+// min / mean / max поля за последний час; без строки, пока у таблицы нет данных
+void printWindowLine(std::ostream& out, const char* label, const TimeSeriesTable& table, size_t field,
+                     int precision) {
+    WindowStats st = table.recentStats(field, 3600);
+    if (st.count == 0) return;
+    out << "    • " << label << std::fixed << std::setprecision(precision)
+        << std::setw(8) << st.min << " / " << std::setw(8) << st.mean
+        << " / " << std::setw(8) << st.max << "\n";
 }
 
-// Function to write data from curl response
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* buffer) {
-    size_t totalSize = size * nmemb;
-    if (buffer) {
-        buffer->append((char*)contents, totalSize);
-        return totalSize;
+// Статистика за последний час по накопленной истории
+void printHistorySummary(std::ostream& out) {
+    out << "  HISTORY (+new rows this update)\n";
+    out << "    • Stored:     ";
+    for (const std::unique_ptr<Feed>& feed : schemaFeeds) {
+        if (!feed->spec->history) continue;
+        out << (feed == schemaFeeds.front() ? " " : ", ") << feed->spec->name << " " << feed->spec->history->size()
+            << " (+" << feed->newRows << ")";
     }
-    return 0;
+    out << "\n";
+
+    out << "  LAST HOUR (min / mean / max)\n";
+    printWindowLine(out, "Speed:   ", plasmaSeries, 1, 1);
+    printWindowLine(out, "Density: ", plasmaSeries, 0, 2);
+    printWindowLine(out, "Bt:      ", magSeries, 1, 2);
+    printWindowLine(out, "Bz GSM:  ", magSeries, 2, 2);
+
+    if (derivedIndices) {
+        const DerivedIndices::Result& d = lastDerived;
+        out << "  DERIVED\n";
+        if (d.pressureValid) {
+            out << "    • Pdyn:        " << std::fixed << std::setprecision(2) << std::setw(8) << d.pressure
+                << " nPa\n";
+        }
+        if (d.couplingValid) {
+            out << "    • Newell:      " << std::setprecision(0) << std::setw(8) << d.newell << "\n";
+            out << "    • Epsilon:     " << std::setprecision(1) << std::setw(8) << d.epsilon << " GW\n";
+        }
+        if (d.southValid) {
+            out << "    • Bz south:    " << std::setprecision(0) << std::setw(8) << d.southMinutes << " min\n";
+        }
+    }
+    out << "─────────────────────────────────────────\n";
 }
 
-std::string getCurrentTimestamp() {
-    auto now = std::chrono::system_clock::now();
-    std::time_t nowTime = std::chrono::system_clock::to_time_t(now);
-    std::stringstream ss;
-    ss << std::put_time(std::localtime(&nowTime), "%Y-%m-%d %H:%M:%S");
-    return ss.str();
+void printStreamReport(std::ostream& out, bool withHistogram) {
+    if (!smoothStream) return;
+    const JitterHistogram& jitter = smoothStream->jitter();
+    out << "  STREAM " << std::defaultfloat << std::setprecision(6) << smoothStream->rateHz() << " Hz, "
+        << smoothingName(smoothStream->smoothing()) << ": " << smoothStream->frames() << " frames, "
+        << smoothStream->missedFrames() << " missed\n";
+    out << "    • Jitter:      p50 < " << (uint64_t)jitter.quantileMicros(0.50) << " us, p99 < "
+        << (uint64_t)jitter.quantileMicros(0.99) << " us, max " << std::fixed << std::setprecision(1)
+        << jitter.maxMicros() << " us\n";
+    if (withHistogram) {
+        jitter.print(out);
+    }
 }
 
-// Function to fetch data from the API
-std::string fetchData(const std::string& url) {
-    CURL* curl;
-    CURLcode res;
-    std::string response;
+std::string formatLocalTime(int64_t unixSeconds, const char* format) {
+    std::time_t t = (std::time_t)unixSeconds;
+    char buffer[32];
+    std::strftime(buffer, sizeof(buffer), format, std::localtime(&t));
+    return buffer;
+}
+
+// Архив: объём и экстремумы за сутки прямо из файла, без парсинга
+void printArchiveSummary(std::ostream& out) {
+    if (!archive.isOpen()) return;
+    size_t rows = archive.rowCount();
+    out << "  ARCHIVE: " << rows << " snapshots";
+    if (rows > 0) out << " since " << formatLocalTime(archive.firstTime(), "%Y-%m-%d %H:%M");
+    out << "\n";
 
-    curl = curl_easy_init();
-    if (curl) {
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        res = curl_easy_perform(curl);
-        if (res != CURLE_OK) {
-            std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
+    static std::vector<float> window(8192);
+    int64_t now = unixNow();
+    auto extreme = [&](ArchiveField field, bool wantMax, float& result) {
+        size_t n = archive.query(field, now - 24 * 3600, now + 1, nullptr, window.data(), window.size());
+        bool found = false;
+        for (size_t i = 0; i < n; ++i) {
+            if (std::isnan(window[i])) continue;
+            if (!found || (wantMax ? window[i] > result : window[i] < result)) result = window[i];
+            found = true;
         }
-        curl_easy_cleanup(curl);
+        return found;
+    };
+    float value = 0.0f;
+    out << "    • Last 24h:   " << std::fixed;
+    if (extreme(SpeedField, true, value)) out << " speed max " << std::setprecision(1) << value << " km/s";
+    if (extreme(BzGsmField, false, value)) out << " Bz min " << std::setprecision(2) << value << " nT";
+    if (extreme(KpField, true, value)) out << " Kp max " << std::setprecision(1) << value;
+    out << "\n";
+}
+
+// Добавляет сообщение в бандл; не влезло - отправляет полный бандл и
+// добавляет в пустой. add(bundle) возвращает false, если места нет
+template <typename Add>
+void addOrFlush(OSCBundle& bundle, Add add) {
+    if (add(bundle)) return;
+    oscSender.send(bundle);
+    bundle.clear();
+    add(bundle);
+}
+
+// Последние значения полей фида одним OSC-бандлом (по бандлу на MTU)
+void sendLatestValues(const FeedSpec& spec, const SolarData& data) {
+    OSCBundle bundle(oscValueMode);
+    for (size_t field = spec.firstField; field < spec.firstField + spec.fieldCount; ++field) {
+        if (!data.valid(field)) continue;
+        addOrFlush(bundle, [&](OSCBundle& b) {
+            return b.add(latestHeaders[field], data.values[field], fieldTable[field].precision);
+        });
     }
-    return response;
+    oscSender.send(bundle);
 }
 
-std::vector<char> createOSCMessage(const std::string& addressPattern, const std::string& arguments) {
-    std::vector<char> message;
+// Новые сэмплы становятся опорными точками интерполяции
+void streamNewSamples(const FeedSpec& spec, const std::vector<FeedRow>& rows) {
+    if (!smoothStream) return;
+    for (const FeedRow& row : rows) {
+        for (size_t f = 0; f < spec.fieldCount; ++f) {
+            size_t channel = fieldStreamChannels[spec.firstField + f];
+            if (channel != noStreamChannel) smoothStream->push(channel, row.time, row.values[f]);
+        }
+    }
+}
 
-    // Add address pattern (e.g., "/density") and pad to 4-byte alignment
-    std::string address = addressPattern;
-    while (address.size() % 4 != 0) {
-        address += '\0';
+// Новые строки NOAA - в кольцо общей памяти
+void shareNewSamples(const FeedSpec& spec, const std::vector<FeedRow>& rows) {
+    if (!sharedOutput.isOpen()) return;
+    for (const FeedRow& row : rows) {
+        for (size_t f = 0; f < spec.fieldCount; ++f) {
+            if (std::isnan(row.values[f])) continue;
+            sharedOutput.push((uint32_t)(spec.firstField + f), SOLAR_SHM_SAMPLE, row.time * 1000000, row.values[f]);
+        }
     }
-    message.insert(message.end(), address.begin(), address.end());
+}
 
-    // Add type tag string ",s" (indicating a single string argument) and pad to 4-byte alignment
-    std::string typeTag = ",s";
-    while (typeTag.size() % 4 != 0) {
-        typeTag += '\0';
+// Пересчёт производных индексов; вызывается под historyMutex после новых строк
+bool updateDerived(DerivedIndices::Result& result) {
+    if (!derivedIndices) return false;
+    {
+        StageTimer timer(derivedTime);
+        result = derivedIndices->update(plasmaSeries, magSeries);
     }
-    message.insert(message.end(), typeTag.begin(), typeTag.end());
+    lastDerived = result;
+    return true;
+}
+
+// Производные индексы и статистика окон, по бандлу на MTU
+void sendDerivedData(const DerivedIndices::Result& result) {
+    OSCBundle bundle(oscValueMode);
+    auto add = [&](const OSCAddressView& address, float value, int precision) {
+        addOrFlush(bundle, [&](OSCBundle& b) { return b.addFloat(address, value, precision); });
+    };
 
-    // Add argument (string value) and pad to 4-byte alignment
-    std::string argumentStr = arguments + '\0';
-    while (argumentStr.size() % 4 != 0) {
-        argumentStr += '\0';
+    if (result.pressureValid) add(pdynAddress, result.pressure, 3);
+    if (result.couplingValid) {
+        add(newellAddress, result.newell, 1);
+        add(epsilonAddress, result.epsilon, 3);
     }
-    message.insert(message.end(), argumentStr.begin(), argumentStr.end());
+    if (result.southValid) add(bzSouthAddress, result.southMinutes, 0);
+    for (size_t i = 0; i < result.stats.size(); ++i) {
+        const ColumnStats& stats = result.stats[i];
+        if (stats.count == 0) continue;
+        const float values[] = {stats.mean, stats.std, stats.min, stats.max};
+        for (size_t k = 0; k < 4; ++k) {
+            const std::string& address = derivedStatAddresses[i * 4 + k];
+            add(OSCAddressView(address.data(), address.size()), values[k], 3);
+        }
+    }
+    oscSender.send(bundle);
+}
 
-    return message;
+// /derived/<серия>/<окно>m/{mean,std,min,max} с NUL-выравниванием OSC
+void buildDerivedAddresses(const std::vector<int>& windows) {
+    static const char* statNames[] = {"mean", "std", "min", "max"};
+    derivedStatAddresses.clear();
+    for (int minutes : windows) {
+        for (int s = 0; s < DerivedIndices::SeriesCount; ++s) {
+            for (const char* stat : statNames) {
+                std::string address = std::string("/derived/") +
+                                      DerivedIndices::seriesName((DerivedIndices::Series)s) + "/" +
+                                      std::to_string(minutes) + "m/" + stat;
+                address.resize((address.size() + 4) & ~size_t(3), '\0');
+                derivedStatAddresses.push_back(address);
+            }
+        }
+    }
 }
 
-void sendOSCMessage(const std::string& address, const std::string& value, const std::string& ip, int port) {
-    int sockfd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (sockfd < 0) {
-        std::cerr << "Socket creation failed" << std::endl;
-        return;
+// "10,60" -> {10, 60}; false на пустом или неположительном окне
+bool parseWindows(const std::string& text, std::vector<int>& windows) {
+    windows.clear();
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        int minutes = std::atoi(item.c_str());
+        if (minutes <= 0 || minutes > 7 * 24 * 60) return false;
+        windows.push_back(minutes);
     }
+    return !windows.empty();
+}
 
-    sockaddr_in server_addr = {};
-    server_addr.sin_family = AF_INET;
-    server_addr.sin_port = htons(port);
+// Отправляет только новые сэмплы, по бандлу на MTU. headers и fields - по
+// полю строки; поле с пустым заголовком не отправляется
+void sendNewSamples(const std::vector<FeedRow>& rows, const OSCMessageHeader* headers, const FieldSpec* fields,
+                    size_t fieldCount) {
+    if (rows.empty()) return;
 
-    if (inet_pton(AF_INET, ip.c_str(), &server_addr.sin_addr) <= 0) {
-        std::cerr << "Invalid address" << std::endl;
-        close(sockfd);
-        return;
+    OSCBundle bundle(oscValueMode);
+    for (const FeedRow& row : rows) {
+        uint64_t timetag = oscTimetagFromUnix(row.time);
+        for (size_t f = 0; f < fieldCount; ++f) {
+            if (std::isnan(row.values[f]) || headers[f].empty()) continue;
+            addOrFlush(bundle, [&](OSCBundle& b) {
+                return b.addSample(headers[f], timetag, row.values[f], fields[f].precision);
+            });
+        }
     }
+    oscSender.send(bundle);
+}
 
-    std::vector<char> oscMessage = createOSCMessage(address, value);
+// Общий обработчик фидов схемы: последние значения - в снимок, новые
+// строки - в историю, поток и общую память. По OSC их отправляет sendFeed()
+bool processFeed(Feed& feed, const std::string& jsonData) {
+    const FeedSpec& spec = *feed.spec;
+    TimeSeriesTable* history = spec.history;
+    std::vector<FeedRow>& newRows = feed.rows;
+    feed.pendingSend = false;
+    FeedValues latest;
+    // История фида пишется только его обработчиком, водяной знак читается без блокировки
+    auto parseStart = std::chrono::steady_clock::now();
+    FeedExtractor::Status status = feed.extractor->extract(jsonData, history ? history->watermark() : 0,
+                                                           history ? history->capacity() : 0, latest, newRows);
+    if (feed.parseTime) {
+        feed.parseTime->record(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - parseStart));
+    }
+    if (status == FeedExtractor::NoData) {
+        // Опубликованный снимок сохраняет последние валидные значения
+        logWarning("parse") << "No " << spec.name << " data available. Using last valid values.";
+        return false;
+    }
+    if (status == FeedExtractor::Malformed) {
+        logError("parse") << "Error parsing " << spec.name << " JSON: " << feed.extractor->error();
+        return false;
+    }
+
+    // Пропуск в строке оставляет последнее валидное значение поля вместе с его временем
+    bool changed = false;
+    // Время строки таблицы; у продуктов без time_tag - время опроса
+    int64_t time = spec.shape == FeedShape::Table ? latest.time : unixNow();
+    feed.sent = publishSnapshot([&](SolarData& d) {
+        for (size_t f = 0; f < spec.fieldCount; ++f) {
+            size_t field = spec.firstField + f;
+            if (!((latest.validMask >> f) & 1u)) continue;
+            changed = changed || !d.valid(field) || d.values[field] != latest.values[f];
+            d.values[field] = latest.values[f];
+            d.times[field] = time;
+            d.validMask |= 1u << field;
+        }
+    });
 
-    int sendResult = sendto(sockfd, oscMessage.data(), oscMessage.size(), 0,
-                            (sockaddr*)&server_addr, sizeof(server_addr));
-    if (sendResult < 0) {
-        std::cerr << "sendto failed" << std::endl;
+    feed.pendingSend = true;
+    feed.haveDerived = false;
+    if (!history) {
+        newRows.clear();
+        return changed;
     }
 
-    close(sockfd);
+    std::unique_lock<std::mutex> lock(historyMutex);
+    for (const FeedRow& row : newRows) history->append(row.time, row.values);
+    feed.newRows += newRows.size();
+    bool derivedInput = history == &plasmaSeries || history == &magSeries;
+    feed.haveDerived = derivedInput && !newRows.empty() && updateDerived(feed.derived);
+    lock.unlock();
+    streamNewSamples(spec, newRows);
+    shareNewSamples(spec, newRows);
+
+    // Новые данные, если time_tag продвинулся
+    return !newRows.empty();
 }
 
-// Функция для безопасного парсинга с сохранением старого значения
-float parseValueSafely(const json& value, float& lastValidValue, bool& validFlag) {
-    try {
-        if (value.is_string()) {
-            std::string strVal = value.get<std::string>();
-            if (!strVal.empty() && strVal != "null" && strVal != "NULL") {
-                float newValue = std::stof(strVal);
-                lastValidValue = newValue;
-                validFlag = true;
-                return newValue;
-            }
-        } else if (value.is_number()) {
-            float newValue = value.get<float>();
-            lastValidValue = newValue;
-            validFlag = true;
-            return newValue;
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Invalid value encountered: " << e.what() << std::endl;
+// OSC после processFeed(): последние значения, новые сэмплы, производные индексы
+void sendFeed(Feed& feed) {
+    if (!feed.pendingSend) return;
+    feed.pendingSend = false;
+    const FeedSpec& spec = *feed.spec;
+    sendLatestValues(spec, feed.sent);
+    sendNewSamples(feed.rows, &sampleHeaders[spec.firstField], &fieldTable[spec.firstField], spec.fieldCount);
+    if (feed.haveDerived) sendDerivedData(feed.derived);
+}
+
+// ~/.solar-watcher/history.dat, или в текущей папке, если HOME не задан
+std::string defaultHistoryPath() {
+    const char* home = std::getenv("HOME");
+    if (!home || !*home) return "solar-history.dat";
+    std::string dir = std::string(home) + "/.solar-watcher";
+    mkdir(dir.c_str(), 0755);
+    return dir + "/history.dat";
+}
+
+// Тёплый старт: последний снимок из архива сразу публикуется и уходит по OSC
+bool restoreFromArchive(int64_t& time) {
+    uint32_t mask;
+    float values[ArchiveFieldCount];
+    int64_t times[ArchiveFieldCount];
+    if (!archive.lastRow(time, mask, values, times)) return false;
+
+    SolarData data;
+    data.validMask = mask;
+    for (size_t f = 0; f < ArchiveFieldCount; ++f) {
+        if (!data.valid(f)) continue;
+        data.values[f] = values[f];
+        // Время данных поля (time_tag), а не публикации: свежесть сразу видит их настоящий возраст
+        data.times[f] = times[f] ? times[f] : time;
     }
-    
-    // Если не удалось получить новое значение, используем последнее валидное
-    if (validFlag) {
-        return lastValidValue;
-    }
-    return 0.0f;
-}
-
-// Аналогичная функция для целых чисел
-int parseIntValueSafely(const json& value, int& lastValidValue, bool& validFlag) {
-    try {
-        if (value.is_number_integer()) {
-            int newValue = value.get<int>();
-            lastValidValue = newValue;
-            validFlag = true;
-            return newValue;
-        } else if (value.is_string()) {
-            std::string strVal = value.get<std::string>();
-            if (!strVal.empty() && strVal != "null" && strVal != "NULL") {
-                int newValue = std::stoi(strVal);
-                lastValidValue = newValue;
-                validFlag = true;
-                return newValue;
-            }
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "Invalid integer value encountered: " << e.what() << std::endl;
+    solarSnapshot.store(data);
+
+    // Локальные читатели тоже сразу получают восстановленные значения
+    if (sharedOutput.isOpen()) sharedOutput.publishSnapshot(mask, data.values, data.times);
+
+    for (const FeedSpec& spec : feedTable) sendLatestValues(spec, data);
+    return true;
+}
+
+// Общая часть экрана для живого режима и воспроизведения
+void printConsole(std::ostream& out) {
+    printSolarData(out, solarSnapshot.load());
+    {
+        std::lock_guard<std::mutex> lock(historyMutex);
+        printHistorySummary(out);
+        for (const std::unique_ptr<Feed>& feed : schemaFeeds) feed->newRows = 0;
     }
-    
-    // Если не удалось получить новое значение, используем последнее валидное
-    if (validFlag) {
-        return lastValidValue;
+    // Rows become durable once a minute
+    archive.sync();
+    printArchiveSummary(out);
+    printStreamReport(out, false);
+}
+
+// Возраст самого свежего time_tag по каждому полю (сек), NaN пока значения нет
+double fieldAge(bool valid, int64_t time) {
+    if (!valid || time == 0) return std::numeric_limits<double>::quiet_NaN();
+    return (double)(unixNow() - time);
+}
+
+// Метрики, которые живут вне планировщика: свежесть данных и отправка OSC
+void registerMetrics() {
+    for (const std::unique_ptr<Feed>& feed : schemaFeeds) {
+        feed->parseTime = &metrics.histogram("solar_parse_seconds", "Extracting the latest values and new rows",
+                                             std::string("feed=\"") + feed->spec->name + "\"");
     }
-    return 0;
+    for (size_t f = 0; f < ArchiveFieldCount; ++f) {
+        metrics.gaugeFunction("solar_staleness_seconds",
+                              "Age of the newest time_tag (fetch time for probabilities and regions)",
+                              std::string("field=\"") + fieldTable[f].name + "\"", [f]() {
+                                  SolarData d = solarSnapshot.load();
+                                  return fieldAge(d.valid(f), d.times[f]);
+                              });
+    }
+
+    metrics.histogram("solar_osc_encode_seconds", "Building an OSC bundle, up to its send", "",
+                      &oscSender.encodeTime());
+    metrics.histogram("solar_osc_send_seconds", "sendmmsg() of one packet to every destination", "",
+                      &oscSender.sendTime());
+    metrics.counterFunction("solar_osc_datagrams_total", "Datagrams handed to the kernel", "",
+                            []() { return (double)oscSender.datagramsSent(); });
+    metrics.counterFunction("solar_osc_send_failures_total", "Failed sendmmsg()/sendto() calls", "",
+                            []() { return (double)oscSender.sendFailures(); });
+    metrics.counterFunction("solar_shm_records_total", "Samples written to the shared-memory ring", "",
+                            []() { return (double)sharedOutput.recordsWritten(); });
+    metrics.histogram("solar_derived_seconds", "Recomputing the derived indices over their windows", "",
+                      &derivedTime);
+    metrics.gaugeFunction("solar_osc_destinations", "Fixed destinations plus live subscriptions", "",
+                          []() { return (double)oscSender.destinationCount(); });
+    metrics.counterFunction("solar_log_records_total", "Log records written by the log thread", "",
+                            []() { return (double)logger.written(); });
+    metrics.counterFunction("solar_log_dropped_total", "Log records dropped because the ring was full", "",
+                            []() { return (double)logger.dropped(); });
+    metrics.counterFunction("solar_log_suppressed_total", "Repeated warnings and errors folded into a count", "",
+                            []() { return (double)logger.suppressed(); });
 }
 
-void processData(const std::string& jsonData, SolarData& data) {
-    try {
-        json parsedData = json::parse(jsonData);
+// Адресат из командной строки: HOST:PORT или HOST:PORT/PATTERN
+bool parseDestination(const std::string& text, std::string& host, int& port, std::string& filter) {
+    size_t colon = text.find(':');
+    if (colon == std::string::npos || colon == 0) return false;
+    size_t slash = text.find('/', colon);
+    host = text.substr(0, colon);
+    std::string portText = text.substr(colon + 1, slash == std::string::npos ? std::string::npos : slash - colon - 1);
+    filter = slash == std::string::npos ? "" : text.substr(slash);
+    port = std::atoi(portText.c_str());
+    return port > 0 && port <= 65535 && portText.find_first_not_of("0123456789") == std::string::npos;
+}
 
-        if (parsedData.size() < 2) {
-            std::cerr << "No solar wind data available. Using last valid values." << std::endl;
-            // Используем последние валидные значения
-            data.density = lastValidData.density_valid ? lastValidData.density : 0.0f;
-            data.speed = lastValidData.speed_valid ? lastValidData.speed : 0.0f;
-            data.temperature = lastValidData.temperature_valid ? lastValidData.temperature : 0.0f;
-            return;
-        }
+void runLive(const std::vector<FeedDescriptor>& feeds) {
+    FeedFetcher fetcher;
+    FeedScheduler scheduler(fetcher, 3);
+    activeFetcher = &fetcher;
 
-        auto latestData = parsedData[parsedData.size() - 1];
+    scheduler.setMetrics(&metrics);
+    for (const FeedDescriptor& d : feeds) scheduler.addFeed(d);
+    if (recorder.isOpen()) {
+        scheduler.setObserver([](const FeedDescriptor& d, const FetchResult& result) {
+            RecordedResponse response;
+            response.feed = d.name;
+            response.timeMillis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+            if (!result.ok()) {
+                response.kind = RecordedResponse::Failed;
+                response.body = result.code != CURLE_OK ? curl_easy_strerror(result.code)
+                                                        : "HTTP " + std::to_string(result.httpStatus);
+            } else if (result.notModified) {
+                response.kind = RecordedResponse::NotModified;
+            } else {
+                response.kind = RecordedResponse::Body;
+                response.body = result.body;
+            }
+            recorder.record(response);
+        });
+    }
 
-        data.density = parseValueSafely(latestData[1], lastValidData.density, lastValidData.density_valid);
-        data.speed = parseValueSafely(latestData[2], lastValidData.speed, lastValidData.speed_valid);
-        data.temperature = parseValueSafely(latestData[3], lastValidData.temperature, lastValidData.temperature_valid);
+    // First screen as soon as the initial round is in, then once a minute
+    std::chrono::seconds refresh(5);
+    while (running) {
+        // Feeds are fetched in the background; the console is only refreshed here
+        scheduler.runUntil(std::chrono::steady_clock::now() + refresh, []() { return running != 0; });
+        if (!running) break;
+        refresh = std::chrono::seconds(60);
 
-        std::stringstream ssDensity, ssSpeed, ssTemperature;
+        // Print all data in clean format; the screen goes to the logger as one block
+        std::ostringstream out;
+        printConsole(out);
 
-        // Форматируем и отправляем только если есть валидные данные
-        if (lastValidData.density_valid) {
-            ssDensity << std::fixed << std::setprecision(3) << data.density;
-            sendOSCMessage("/dens", ssDensity.str(), "127.0.0.1", 6000);
-            sendOSCMessage("/dens", ssDensity.str(), "127.0.0.1", 6001);
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        CacheStats cache = fetcher.cacheStats();
+        out << "  HTTP cache: " << cache.hits << " hits (304), " << cache.misses << " misses\n";
+        HedgeStats hedges = fetcher.hedgeStats();
+        out << "  Hedged requests: " << hedges.sent << " sent, " << hedges.won << " won\n";
+        if (recorder.isOpen()) {
+            out << "  Recorded: " << recorder.recordCount() << " responses, "
+                << recorder.bytesWritten() / 1024 << " KiB\n";
         }
-        
-        if (lastValidData.speed_valid) {
-            ssSpeed << std::fixed << std::setprecision(2) << data.speed;
-            sendOSCMessage("/speed", ssSpeed.str(), "127.0.0.1", 6000);
-            sendOSCMessage("/speed", ssSpeed.str(), "127.0.0.1", 6001);
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
-        }
-        
-        if (lastValidData.temperature_valid) {
-            ssTemperature << std::fixed << std::setprecision(3) << data.temperature;
-            sendOSCMessage("/temp", ssTemperature.str(), "127.0.0.1", 6000);
-            sendOSCMessage("/temp", ssTemperature.str(), "127.0.0.1", 6001);
+        out << "  Polling:";
+        for (size_t i = 0; i < scheduler.feedCount(); ++i) {
+            out << (i ? ", " : " ") << scheduler.descriptor(i).name << " "
+                << scheduler.currentInterval(i).count() / 1000 << "s";
+            if (scheduler.circuitOpen(i)) out << " (circuit open)";
         }
+        out << "\n";
+        logger.report(out.str());
+    }
 
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing solar wind JSON: " << e.what() << std::endl;
-        // Используем последние валидные значения при ошибке
-        data.density = lastValidData.density_valid ? lastValidData.density : 0.0f;
-        data.speed = lastValidData.speed_valid ? lastValidData.speed : 0.0f;
-        data.temperature = lastValidData.temperature_valid ? lastValidData.temperature : 0.0f;
+    // Don't wait for slow transfers on the way out
+    activeFetcher = nullptr;
+    int aborted = fetcher.abortAll();
+    if (aborted > 0) {
+        logInfo("main") << "Aborted " << aborted << " transfer(s) in flight.";
     }
 }
 
-void processSolarProbabilities(const std::string& jsonData, SolarData& data) {
-    try {
-        json parsedData = json::parse(jsonData);
+// Прогоняет записанные ответы через те же обработчики, что и живой режим.
+// speed - во сколько раз быстрее реального времени, 0 - без пауз.
+// Всё выполняется в одном потоке, в порядке записи, поэтому прогон детерминирован.
+void runReplay(const std::string& path, double speed, const std::vector<FeedDescriptor>& feeds) {
+    RecordingReader reader;
+    if (!reader.open(path)) {
+        logError("replay") << "Replay failed: " << reader.error();
+        return;
+    }
 
-        if (parsedData.is_array() && !parsedData.empty()) {
-            auto todayData = parsedData[0];
+    typedef std::chrono::steady_clock Clock;
+    const Clock::time_point start = Clock::now();
+    Clock::time_point nextScreen = start + std::chrono::seconds(60);
+    int64_t firstMillis = 0;
+    uint64_t records = 0, skipped = 0, bytes = 0;
 
-            data.m_class = parseIntValueSafely(todayData["m_class_1_day"], lastValidData.m_class, lastValidData.m_class_valid);
-            data.x_class = parseIntValueSafely(todayData["x_class_1_day"], lastValidData.x_class, lastValidData.x_class_valid);
+    RecordedResponse response;
+    while (running && reader.next(response)) {
+        if (records == 0 && skipped == 0) firstMillis = response.timeMillis;
 
-            // Отправляем только если есть валидные данные
-            if (lastValidData.m_class_valid) {
-                sendOSCMessage("/m_xray", std::to_string(data.m_class), "127.0.0.1", 6000);
-                sendOSCMessage("/m_xray", std::to_string(data.m_class), "127.0.0.1", 6001);
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
-            }
-            
-            if (lastValidData.x_class_valid) {
-                sendOSCMessage("/x_xray", std::to_string(data.x_class), "127.0.0.1", 6000);
-                sendOSCMessage("/x_xray", std::to_string(data.m_class), "127.0.0.1", 6001);
+        if (speed > 0.0) {
+            // Absolute deadlines on the recording's own timeline, so pauses never accumulate
+            auto offset = std::chrono::duration<double, std::milli>((response.timeMillis - firstMillis) / speed);
+            Clock::time_point due = start + std::chrono::duration_cast<Clock::duration>(offset);
+            while (running && Clock::now() < due) {
+                std::this_thread::sleep_until(std::min(due, Clock::now() + std::chrono::milliseconds(100)));
             }
+            if (!running) break;
+        }
 
-        } else {
-            std::cerr << "No solar probabilities data available. Using last valid values." << std::endl;
-            data.m_class = lastValidData.m_class_valid ? lastValidData.m_class : 0;
-            data.x_class = lastValidData.x_class_valid ? lastValidData.x_class : 0;
+        const FeedDescriptor* d = nullptr;
+        for (const FeedDescriptor& candidate : feeds) {
+            if (candidate.name == response.feed) d = &candidate;
+        }
+        if (!d) {
+            ++skipped;
+            continue;
         }
 
-    } catch (const std::exception& e) {
-        std::cerr << "Error processing solar probabilities JSON: " << e.what() << std::endl;
-        data.m_class = lastValidData.m_class_valid ? lastValidData.m_class : 0;
-        data.x_class = lastValidData.x_class_valid ? lastValidData.x_class : 0;
+        replayClockMillis.store(response.timeMillis, std::memory_order_relaxed);
+        switch (response.kind) {
+            case RecordedResponse::Body:
+                if (d->process) d->process(response.body);
+                if (d->send) d->send();
+                break;
+            case RecordedResponse::NotModified:
+                if (d->reuse) d->reuse();
+                break;
+            case RecordedResponse::Failed:
+                logWarning("replay") << "Recorded failure of " << d->name << ": " << response.body;
+                if (d->fallback) d->fallback();
+                break;
+        }
+        ++records;
+        bytes += response.body.size();
+
+        if (Clock::now() >= nextScreen) {
+            std::ostringstream out;
+            printConsole(out);
+            logger.report(out.str());
+            nextScreen = Clock::now() + std::chrono::seconds(60);
+        }
+    }
+    if (!reader.error().empty()) {
+        logError("replay") << "Replay stopped: " << reader.error();
     }
+
+    double wall = std::chrono::duration<double>(Clock::now() - start).count();
+    double span = (replayClockMillis.load(std::memory_order_relaxed) - firstMillis) / 1000.0;
+    std::ostringstream out;
+    printConsole(out);
+    out << "  REPLAY: " << records << " responses (" << skipped << " unknown feeds skipped), "
+        << std::fixed << std::setprecision(1) << bytes / 1048576.0 << " MiB\n";
+    out << "    • Recorded span " << std::setprecision(0) << span << " s replayed in "
+        << std::setprecision(3) << wall << " s";
+    if (wall > 0.0) {
+        out << " (" << std::setprecision(0) << records / wall << " responses/s, "
+            << std::setprecision(1) << bytes / 1048576.0 / wall << " MiB/s)";
+    }
+    out << "\n";
+    logger.report(out.str());
+    replayClockMillis.store(0, std::memory_order_relaxed);
 }
 
-void processMagData(const std::string& jsonData, SolarData& data) {
-    try {
-        json parsedData = json::parse(jsonData);
+// Нагрузочный тест (--loadtest): локальный mock NOAA вместо services.swpc.noaa.gov
+// и OSC-приёмники внутри процесса вместо портов 6000/6001
+struct LoadTestOptions {
+    double seconds = 0.0;          // 0 - выключен
+    size_t extraFeeds = 0;         // синтетические фиды формата plasma сверх пяти настоящих
+    size_t destinations = 2;
+    double updateSeconds = 60.0;   // как часто mock публикует новую строку
+    int latencyMs = 0;
+    int jitterMs = 0;
+    double failureRate = 0.0;
+    int pollSeconds = 0;           // 0 - настоящее расписание фидов
+};
 
-        if (parsedData.size() < 2) {
-            std::cerr << "No magnetometer data available. Using last valid values." << std::endl;
-            data.lon_gsm = lastValidData.lon_gsm_valid ? lastValidData.lon_gsm : 0.0f;
-            data.bt = lastValidData.bt_valid ? lastValidData.bt : 0.0f;
-            data.bz_gsm = lastValidData.bz_gsm_valid ? lastValidData.bz_gsm : 0.0f;
-            return;
-        }
+// Синтетический фид формата plasma: своя таблица, своё поле speed с адресом
+// /load/<n>/sample и свой извлекатель
+struct LoadFeed {
+    TimeSeriesTable table{64, 1};
+    std::string address;  // с NUL-выравниванием OSC
+    FieldSpec field;
+    FeedSpec spec;
+    OSCMessageHeader sampleHeader;
+    std::unique_ptr<FeedExtractor> extractor;
+    std::vector<FeedRow> newRows;
 
-        auto latestData = parsedData[parsedData.size() - 1];
+    explicit LoadFeed(const std::string& paddedAddress)
+        : address(paddedAddress),
+          field{"speed", "speed", FieldType::Float, 1, noOscAddress,
+                OSCAddressView(address.data(), address.size()), noOscAddress},
+          spec{"load", "", FeedShape::Table, 60, 120, 0, 1, &table},
+          sampleHeader(field.sample, OSCMessageHeader::Sample, oscValueMode),
+          extractor(new FeedExtractor(spec, &field)) {}
+};
 
-        data.lon_gsm = parseValueSafely(latestData[4], lastValidData.lon_gsm, lastValidData.lon_gsm_valid);
-        data.bt = parseValueSafely(latestData[6], lastValidData.bt, lastValidData.bt_valid);
-        data.bz_gsm = parseValueSafely(latestData[3], lastValidData.bz_gsm, lastValidData.bz_gsm_valid);
+bool processLoadFeed(LoadFeed& feed, const std::string& jsonData) {
+    // Фид обрабатывается одним воркером за раз, таблица только его
+    FeedValues latest;
+    FeedExtractor::Status status =
+        feed.extractor->extract(jsonData, feed.table.watermark(), feed.table.capacity(), latest, feed.newRows);
+    if (status != FeedExtractor::Ok) {
+        logError("parse") << "Error parsing load test JSON: "
+                          << (status == FeedExtractor::NoData ? "no rows" : feed.extractor->error());
+        feed.newRows.clear();  // send() ничего не отправит
+        return false;
+    }
+    for (const FeedRow& row : feed.newRows) feed.table.append(row.time, row.values);
+    return !feed.newRows.empty();
+}
 
-        std::stringstream ssLonGsm, ssBt, ssBzGsm;
+// p50/p90/p99/max в миллисекундах
+void printLatencyLine(std::ostream& out, const char* label, std::vector<double>& millis) {
+    out << "    • " << label;
+    if (millis.empty()) {
+        out << " no samples\n";
+        return;
+    }
+    std::sort(millis.begin(), millis.end());
+    auto at = [&](double q) { return millis[std::min(millis.size() - 1, (size_t)(q * millis.size()))]; };
+    out << std::fixed << std::setprecision(1) << " p50 " << std::setw(8) << at(0.50) << "  p90 "
+        << std::setw(8) << at(0.90) << "  p99 " << std::setw(8) << at(0.99) << "  max " << std::setw(8)
+        << millis.back() << " ms\n";
+}
 
-        // Отправляем только если есть валидные данные
-        if (lastValidData.lon_gsm_valid) {
-            ssLonGsm << std::fixed << std::setprecision(3) << data.lon_gsm;
-            sendOSCMessage("/phiGSM", ssLonGsm.str(), "127.0.0.1", 6000);
-            sendOSCMessage("/phiGSM", ssLonGsm.str(), "127.0.0.1", 6001);
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+// Гоняет настоящие фиды (и синтетические) через mock NOAA и считает задержку
+// от публикации строки до прихода её сэмпла на каждый OSC-приёмник:
+//   poll wait     - публикация -> запрос, который её забрал (расписание)
+//   fetch + parse - запрос -> OSC-бандл собран (mock, curl, очередь, разбор)
+//   send          - бандл собран -> датаграмма принята ядром приёмника
+void runLoadTest(const std::vector<FeedDescriptor>& feeds, const LoadTestOptions& options, OSCSink& sink) {
+    struct MockedFeed {
+        const char* name;
+        MockProduct product;
+        const char* path;
+    };
+    const MockedFeed mocked[] = {
+        {"solar wind", MockProduct::Plasma, "/products/solar-wind/plasma-5-minute.json"},
+        {"magnetometer", MockProduct::Mag, "/products/solar-wind/mag-5-minute.json"},
+        {"Kp-index", MockProduct::Kp, "/products/noaa-planetary-k-index.json"},
+        {"solar probabilities", MockProduct::Probabilities, "/json/solar_probabilities.json"},
+        {"solar regions", MockProduct::Regions, "/json/solar_regions.json"},
+    };
+
+    MockNoaaServer mock;
+    MockFeedConfig config;
+    config.update = std::chrono::milliseconds((long long)(options.updateSeconds * 1000));
+    config.latency = std::chrono::milliseconds(options.latencyMs);
+    config.jitter = std::chrono::milliseconds(options.jitterMs);
+    config.failureRate = options.failureRate;
+
+    std::vector<FeedDescriptor> loadFeeds;
+    std::vector<size_t> mockIndex;
+    std::map<std::string, size_t> sampleFeeds;  // OSC-адрес -> фид mock
+    for (const FeedDescriptor& d : feeds) {
+        for (const MockedFeed& m : mocked) {
+            if (d.name != m.name) continue;
+            config.product = m.product;
+            config.path = m.path;
+            mockIndex.push_back(mock.addFeed(config));
+            loadFeeds.push_back(d);
+            // Адреса сэмплов фида - из схемы (сравниваются без NUL-выравнивания)
+            for (const FeedSpec& spec : feedTable) {
+                if (d.name != spec.name) continue;
+                for (size_t f = spec.firstField; f < spec.firstField + spec.fieldCount; ++f) {
+                    if (fieldTable[f].sample.size) sampleFeeds[fieldTable[f].sample.bytes] = mockIndex.back();
+                }
+            }
         }
-        
-        if (lastValidData.bt_valid) {
-            ssBt << std::fixed << std::setprecision(2) << data.bt;
-            sendOSCMessage("/bt", ssBt.str(), "127.0.0.1", 6000);
-            sendOSCMessage("/bt", ssBt.str(), "127.0.0.1", 6001);
-            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+
+    std::vector<std::unique_ptr<LoadFeed>> synthetic;
+    for (size_t n = 0; n < options.extraFeeds; ++n) {
+        config.product = MockProduct::Plasma;
+        config.path = "/load/" + std::to_string(n) + ".json";
+        mockIndex.push_back(mock.addFeed(config));
+
+        std::string address = "/load/" + std::to_string(n) + "/sample";
+        sampleFeeds[address] = mockIndex.back();
+        address.resize((address.size() + 4) & ~size_t(3), '\0');
+        synthetic.push_back(std::unique_ptr<LoadFeed>(new LoadFeed(address)));
+        LoadFeed* loadFeed = synthetic.back().get();
+
+        FeedDescriptor d;
+        d.name = "load " + std::to_string(n);
+        d.interval = std::chrono::seconds(60);
+        d.maxInterval = std::chrono::seconds(120);
+        d.process = [loadFeed](const std::string& body) { return processLoadFeed(*loadFeed, body); };
+        d.send = [loadFeed]() { sendNewSamples(loadFeed->newRows, &loadFeed->sampleHeader, &loadFeed->field, 1); };
+        loadFeeds.push_back(d);
+    }
+
+    if (!mock.start()) {
+        logError("loadtest") << "Load test: mock NOAA server failed: " << mock.error();
+        return;
+    }
+    for (size_t i = 0; i < loadFeeds.size(); ++i) {
+        loadFeeds[i].url = mock.url(mockIndex[i]);
+        if (options.pollSeconds > 0) {
+            loadFeeds[i].interval = std::chrono::seconds(options.pollSeconds);
+            loadFeeds[i].maxInterval = std::chrono::seconds(2 * options.pollSeconds);
         }
-        
-        if (lastValidData.bz_gsm_valid) {
-            ssBzGsm << std::fixed << std::setprecision(3) << data.bz_gsm;
-            sendOSCMessage("/bzGSM", ssBzGsm.str(), "127.0.0.1", 6000);
-            sendOSCMessage("/bzGSM", ssBzGsm.str(), "127.0.0.1", 6001);
+    }
+
+    // Первый сэмпл каждой строки на каждом приёмнике; пишет только поток приёмника
+    struct Delivery {
+        size_t feed;
+        uint64_t version;
+        int64_t encodedMicros;
+        int64_t receivedMicros;
+    };
+    std::vector<Delivery> deliveries;
+    std::set<std::tuple<size_t, uint64_t, size_t>> seen;
+    sink.start([&](const OSCSinkSample& sample) {
+        auto it = sampleFeeds.find(sample.address);
+        if (it == sampleFeeds.end()) return;
+        uint64_t version;
+        int64_t rowTime = oscTimetagToMicros(sample.sampleTimetag) / 1000000;
+        if (!mock.versionOf(it->second, rowTime, version)) return;
+        if (!seen.insert(std::make_tuple(it->second, version, sample.destination)).second) return;
+        Delivery delivery;
+        delivery.feed = it->second;
+        delivery.version = version;
+        delivery.encodedMicros = sample.bundleTimetag ? oscTimetagToMicros(sample.bundleTimetag) : 0;
+        delivery.receivedMicros = sample.receivedMicros;
+        deliveries.push_back(delivery);
+    });
 
+    FeedFetcher fetcher;
+    int64_t endMicros;
+    std::vector<uint64_t> lastVersion(mock.feedCount());
+    {
+        FeedScheduler scheduler(fetcher, 3);
+        activeFetcher = &fetcher;
+        scheduler.setMetrics(&metrics);
+        for (const FeedDescriptor& d : loadFeeds) scheduler.addFeed(d);
+
+        auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(options.seconds));
+        scheduler.runUntil(deadline, []() { return running != 0; });
+
+        endMicros = wallClockMicros();
+        for (size_t f = 0; f < mock.feedCount(); ++f) lastVersion[f] = mock.currentVersion(f);
+        activeFetcher = nullptr;
+        fetcher.abortAll();
+        // Воркеры доделывают начатое при разрушении планировщика
+    }
+    // Датаграммы в пути
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    sink.stop();
+    mock.stop();
+
+    // Строки, забранные до последней секунды, должны были дойти до каждого приёмника
+    const int64_t settledMicros = endMicros - 1000000;
+    uint64_t published = 0, requested = 0, expected = 0, pending = 0;
+    std::set<std::pair<size_t, uint64_t>> expectedRows;
+    for (size_t f = 0; f < mock.feedCount(); ++f) {
+        if (!mock.hasRows(f)) continue;
+        for (uint64_t v = 1; v <= lastVersion[f]; ++v) {
+            ++published;
+            int64_t at = mock.requestedMicros(f, v);
+            if (at == 0) {
+                ++pending;
+                continue;
+            }
+            ++requested;
+            if (at < settledMicros) {
+                expected += options.destinations;
+                expectedRows.insert(std::make_pair(f, v));
+            }
         }
+    }
 
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing magnetometer JSON: " << e.what() << std::endl;
-        data.lon_gsm = lastValidData.lon_gsm_valid ? lastValidData.lon_gsm : 0.0f;
-        data.bt = lastValidData.bt_valid ? lastValidData.bt : 0.0f;
-        data.bz_gsm = lastValidData.bz_gsm_valid ? lastValidData.bz_gsm : 0.0f;
+    std::vector<double> total, pollWait, fetchParse, send;
+    std::map<size_t, std::vector<double>> totalByFeed;
+    uint64_t delivered = 0;
+    for (const Delivery& d : deliveries) {
+        if (expectedRows.count(std::make_pair(d.feed, d.version))) ++delivered;
+        int64_t publishedAt = mock.publishedMicros(d.feed, d.version);
+        int64_t requestedAt = mock.requestedMicros(d.feed, d.version);
+        double totalMs = (d.receivedMicros - publishedAt) / 1000.0;
+        total.push_back(totalMs);
+        totalByFeed[d.feed].push_back(totalMs);
+        if (requestedAt) pollWait.push_back((requestedAt - publishedAt) / 1000.0);
+        if (requestedAt && d.encodedMicros) fetchParse.push_back((d.encodedMicros - requestedAt) / 1000.0);
+        if (d.encodedMicros) send.push_back((d.receivedMicros - d.encodedMicros) / 1000.0);
     }
-}
 
-void processKpIndexData(const std::string& jsonData, SolarData& data) {
-    try {
-        json parsedData = json::parse(jsonData);
+    MockServerStats served = mock.stats();
+    CacheStats cache = fetcher.cacheStats();
+    uint64_t sent = oscSender.datagramsSent();
+    uint64_t received = sink.datagrams();
 
-        if (parsedData.size() < 2) {
-            std::cerr << "No Kp-index data available. Using last valid values." << std::endl;
-            data.kp = lastValidData.kp_valid ? lastValidData.kp : 0.0f;
-            return;
-        }
+    std::ostringstream out;
+    out << "\n  LOAD TEST: " << std::fixed << std::setprecision(0) << options.seconds << " s, "
+        << loadFeeds.size() << " feeds, " << options.destinations << " OSC destinations, new row every "
+        << std::setprecision(1) << options.updateSeconds << " s, latency " << options.latencyMs << "±"
+        << options.jitterMs << " ms, " << std::setprecision(0) << options.failureRate * 100
+        << "% failures\n";
+    out << "    • Mock NOAA:  " << served.requests << " requests, " << served.bodies << " bodies, "
+        << served.notModified << " not modified, " << served.failed << " failed; HTTP cache "
+        << cache.hits << " hits / " << cache.misses << " misses\n";
+    out << "    • Rows:       " << published << " published, " << requested << " fetched, " << pending
+        << " not fetched yet\n";
+    out << "    • Deliveries: " << delivered << " of " << expected << " (" << expected - std::min(expected, delivered)
+        << " lost)\n";
+    // Потери считаются, только если кроме приёмников теста адресатов нет (--dest, подписчики)
+    out << "    • Datagrams:  " << sent << " sent, " << received << " received (" << std::setprecision(2);
+    if (oscSender.destinationCount() == sink.ports().size()) {
+        out << (sent ? 100.0 * (sent - std::min(sent, received)) / sent : 0.0) << "% lost), ";
+    } else {
+        out << "also sent elsewhere), ";
+    }
+    out << sink.malformed() << " malformed\n";
+    printLatencyLine(out, "Publish -> delivery:", total);
+    printLatencyLine(out, "  poll wait:        ", pollWait);
+    printLatencyLine(out, "  fetch + parse:    ", fetchParse);
+    printLatencyLine(out, "  send:             ", send);
 
-        auto latestData = parsedData[parsedData.size() - 1];
-        data.kp = parseValueSafely(latestData[1], lastValidData.kp, lastValidData.kp_valid);
+    // Самые медленные фиды по p99
+    std::vector<std::pair<double, size_t>> slowest;
+    for (auto& entry : totalByFeed) {
+        std::vector<double>& millis = entry.second;
+        std::sort(millis.begin(), millis.end());
+        slowest.push_back(std::make_pair(millis[std::min(millis.size() - 1, (size_t)(0.99 * millis.size()))],
+                                         entry.first));
+    }
+    std::sort(slowest.rbegin(), slowest.rend());
+    for (size_t i = 0; i < slowest.size() && i < 5; ++i) {
+        out << "    • " << (i == 0 ? "Slowest feeds: " : "               ") << std::left << std::setw(16)
+            << loadFeeds[slowest[i].second].name << std::right << " p99 " << std::setprecision(1)
+            << std::setw(8) << slowest[i].first << " ms\n";
+    }
+    logger.report(out.str());
+}
+
+int main(int argc, char* argv[]) {
+    double streamHz = 0.0;
+    Smoothing smoothing = Smoothing::Cubic;
+    std::string historyPath = defaultHistoryPath();
+    bool historyGiven = false;
+    std::string recordPath;
+    std::string replayPath;
+    double replaySpeed = 1.0;
+    LoadTestOptions loadTest;
+    LoggerOptions logOptions;
+    int metricsPort = 0;
+    double metricsOscSeconds = 0.0;
+    std::vector<std::string> destinations;
+    int controlPort = 0;
+    std::string controlBind;
+    std::vector<std::string> controlAllowed;
+    int leaseSeconds = 60;
+    int multicastTtl = 0;
+    std::string shmName;
+    size_t shmRing = 65536;
+    bool shmReplace = false;
+    std::vector<int> derivedWindows = {10, 60};
 
-        if (lastValidData.kp_valid) {
-            std::stringstream ssKp;
-            ssKp << std::fixed << std::setprecision(2) << data.kp;
-            sendOSCMessage("/kp", ssKp.str(), "127.0.0.1", 6000);
-            sendOSCMessage("/kp", ssKp.str(), "127.0.0.1", 6001);
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--osc-strings") {
+            oscValueMode = OSCValueMode::String;
+        } else if (arg == "--stream-hz" && i + 1 < argc) {
+            streamHz = std::atof(argv[++i]);
+        } else if (arg == "--smoothing" && i + 1 < argc) {
+            if (!parseSmoothing(argv[++i], smoothing)) {
+                std::cerr << "Unknown smoothing: " << argv[i] << " (linear, cubic, exp)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--history" && i + 1 < argc) {
+            historyPath = argv[++i];
+            historyGiven = true;
+        } else if (arg == "--no-history") {
+            historyPath.clear();
+            historyGiven = true;
+        } else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (arg == "--speed" && i + 1 < argc) {
+            std::string value = argv[++i];
+            replaySpeed = value == "max" ? 0.0 : std::atof(value.c_str());
+            if (replaySpeed < 0.0 || (replaySpeed == 0.0 && value != "max")) {
+                std::cerr << "Invalid --speed: " << value << " (a factor like 60, or max)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--dest" && i + 1 < argc) {
+            destinations.push_back(argv[++i]);
+        } else if (arg == "--control-port" && i + 1 < argc) {
+            controlPort = std::atoi(argv[++i]);
+        } else if (arg == "--control-bind" && i + 1 < argc) {
+            controlBind = argv[++i];
+        } else if (arg == "--control-allow" && i + 1 < argc) {
+            std::stringstream list(argv[++i]);
+            std::string host;
+            while (std::getline(list, host, ',')) {
+                if (!host.empty()) controlAllowed.push_back(host);
+            }
+        } else if (arg == "--lease" && i + 1 < argc) {
+            leaseSeconds = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--multicast-ttl" && i + 1 < argc) {
+            multicastTtl = std::atoi(argv[++i]);
+        } else if (arg == "--shm" && i + 1 < argc) {
+            shmName = argv[++i];
+        } else if (arg == "--shm-ring" && i + 1 < argc) {
+            shmRing = (size_t)std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--shm-replace") {
+            shmReplace = true;
+        } else if (arg == "--derived-windows" && i + 1 < argc) {
+            if (!parseWindows(argv[++i], derivedWindows)) {
+                std::cerr << "Invalid --derived-windows: " << argv[i] << " (minutes, e.g. 10,60)" << std::endl;
+                return 1;
+            }
+        } else if (arg == "--no-derived") {
+            derivedWindows.clear();
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            metricsPort = std::atoi(argv[++i]);
+        } else if (arg == "--metrics-osc" && i + 1 < argc) {
+            metricsOscSeconds = std::atof(argv[++i]);
+        } else if (arg == "--loadtest" && i + 1 < argc) {
+            loadTest.seconds = std::atof(argv[++i]);
+        } else if (arg == "--loadtest-feeds" && i + 1 < argc) {
+            loadTest.extraFeeds = (size_t)std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--loadtest-destinations" && i + 1 < argc) {
+            loadTest.destinations = (size_t)std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--loadtest-poll" && i + 1 < argc) {
+            loadTest.pollSeconds = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--mock-update" && i + 1 < argc) {
+            loadTest.updateSeconds = std::max(0.001, std::atof(argv[++i]));
+        } else if (arg == "--mock-latency" && i + 1 < argc) {
+            loadTest.latencyMs = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--mock-jitter" && i + 1 < argc) {
+            loadTest.jitterMs = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--mock-failures" && i + 1 < argc) {
+            loadTest.failureRate = std::min(1.0, std::max(0.0, std::atof(argv[++i])));
+        } else if (arg == "--log-file" && i + 1 < argc) {
+            logOptions.filePath = argv[++i];
+        } else if (arg == "--log-max-mb" && i + 1 < argc) {
+            logOptions.maxFileBytes = (size_t)std::max(1, std::atoi(argv[++i])) << 20;
+        } else if (arg == "--log-keep" && i + 1 < argc) {
+            logOptions.keepFiles = std::max(0, std::atoi(argv[++i]));
+        } else if (arg == "--log-json") {
+            logOptions.format = LogFormat::Json;
+        } else if (arg == "--quiet") {
+            logOptions.quiet = true;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            std::cerr << "Usage: solar-watcher [--osc-strings] [--stream-hz N] [--smoothing linear|cubic|exp]"
+                      << " [--history FILE | --no-history] [--record FILE | --replay FILE [--speed N|max]]"
+                      << " [--dest HOST:PORT[/PATTERN]]..."
+                      << " [--control-port PORT [--control-bind HOST] [--control-allow HOST,...] [--lease SECONDS]]"
+                      << " [--multicast-ttl N] [--shm NAME [--shm-ring N] [--shm-replace]]"
+                      << " [--derived-windows MINUTES,... | --no-derived]"
+                      << " [--metrics-port PORT] [--metrics-osc SECONDS]"
+                      << " [--loadtest SECONDS [--loadtest-feeds N] [--loadtest-destinations N]"
+                      << " [--loadtest-poll S] [--mock-update S] [--mock-latency MS] [--mock-jitter MS]"
+                      << " [--mock-failures RATE]]"
+                      << " [--log-file FILE [--log-max-mb N] [--log-keep N]] [--log-json] [--quiet]" << std::endl;
+            return 1;
         }
+    }
 
-    } catch (const std::exception& e) {
-        std::cerr << "Error parsing Kp-index JSON: " << e.what() << std::endl;
-        data.kp = lastValidData.kp_valid ? lastValidData.kp : 0.0f;
+    // Ошибки разбора аргументов выше идут прямо в stderr, дальше всё через журнал
+    if (!logger.start(logOptions)) {
+        std::cerr << "Cannot open log: " << logger.error() << std::endl;
+        return 1;
     }
-}
 
-int main() {
+    // A replay or a load test must not mix its data into the live archive unless asked to
+    if ((!replayPath.empty() || loadTest.seconds > 0.0) && !historyGiven) historyPath.clear();
+
     signal(SIGINT, signalHandler);
     signal(SIGTERM, signalHandler);
     
     running = 1;
 
-    std::cout << "\n";
-    std::cout << "─────────────────────────────────────────\n";
-    std::cout << "  SolarDataCatcher v2.0\n";
-    std::cout << "  Developed by Elizaveta Fomina\n";
-    std::cout << "  KVEF art & science research group\n";
-
-    std::cout << "─────────────────────────────────────────\n";
-    std::cout << "✓ Sending data to: 127.0.0.1:6000 & 127.0.0.1:6001\n";
-    std::cout << "✓ Update interval: every 60 seconds\n";
-    std::cout << "✓ Using last valid values when API unavailable\n";
-    std::cout << "✓ Press Ctrl+C to stop\n";
-    std::cout << "─────────────────────────────────────────\n";
-    std::cout << "Starting data collection...\n";
-    
-    const std::string apiUrl = "https://services.swpc.noaa.gov/products/solar-wind/plasma-5-minute.json";
-    const std::string solarRegionsUrl = "https://services.swpc.noaa.gov/json/solar_regions.json";
-    const std::string magApiUrl = "https://services.swpc.noaa.gov/products/solar-wind/mag-5-minute.json";
-    const std::string kpIndexUrl = "https://services.swpc.noaa.gov/products/noaa-planetary-k-index.json";
-    const std::string solarProbabilitiesUrl = "https://services.swpc.noaa.gov/json/solar_probabilities.json";
+    logger.report("\n"
+                  "─────────────────────────────────────────\n"
+                  "  SolarDataCatcher v2.0\n"
+                  "  Developed by Elizaveta Fomina\n"
+                  "  KVEF art & science research group\n"
+                  "─────────────────────────────────────────\n");
+    // Без --dest - прежние адресаты 127.0.0.1:6000 и 6001 (в нагрузочном тесте их заменяют приёмники)
+    if (destinations.empty() && loadTest.seconds <= 0.0) {
+        destinations.push_back("127.0.0.1:6000");
+        destinations.push_back("127.0.0.1:6001");
+    }
+    if (loadTest.seconds > 0.0) {
+        logInfo("main") << "✓ Load test: " << loadTest.seconds << " s against a local mock NOAA, "
+                        << loadTest.destinations << " in-process OSC receivers";
+    }
+    if (!destinations.empty()) {
+        std::string list;
+        for (size_t i = 0; i < destinations.size(); ++i) list += (i ? ", " : " ") + destinations[i];
+        logInfo("main") << "✓ Sending data to:" << list;
+    }
+    if (controlPort > 0) {
+        logInfo("main") << "✓ Subscriptions: /subscribe [host] port [pattern] to UDP port "
+                        << (controlBind.empty() ? "" : controlBind + ":") << controlPort << ", lease "
+                        << leaseSeconds << " s, other hosts: "
+                        << (controlAllowed.empty() ? "none" : std::to_string(controlAllowed.size()) + " allowed");
+    }
+    logInfo("main") << "✓ OSC values: " << (oscValueMode == OSCValueMode::Typed ? "typed (f/i)" : "strings");
+    if (!replayPath.empty() && replaySpeed > 0.0) {
+        logInfo("main") << "✓ Replaying " << replayPath << " at " << replaySpeed << "x";
+    } else if (!replayPath.empty()) {
+        logInfo("main") << "✓ Replaying " << replayPath << " as fast as possible";
+    } else if (loadTest.pollSeconds > 0) {
+        logInfo("main") << "✓ Polling: every feed every " << loadTest.pollSeconds << " s";
+    } else {
+        logInfo("main") << "✓ Polling: plasma/mag every minute, Kp, flares and regions adaptively";
+    }
+    if (streamHz > 0.0) {
+        logInfo("main") << "✓ Smooth stream: " << streamHz << " Hz, " << smoothingName(smoothing) << " (/<field>/smooth)";
+    }
+    if (!derivedWindows.empty()) {
+        derivedIndices.reset(new DerivedIndices(derivedWindows));
+        buildDerivedAddresses(derivedWindows);
+        std::string list;
+        for (size_t i = 0; i < derivedWindows.size(); ++i) {
+            list += (i ? ", " : " ") + std::to_string(derivedWindows[i]);
+        }
+        logInfo("main") << "✓ Derived indices: pdyn, newell, epsilon, bz_south_minutes; windows" << list
+                        << " min (/derived/...)";
+    }
+    logInfo("main") << "✓ Using last valid values when API unavailable";
 
-    while (running) {
-        SolarData currentData;
-        
-        // Получаем временную метку
-        std::string timestamp = getCurrentTimestamp();
-        
-        // Fetch and process solar wind data
-        std::string jsonData = fetchData(apiUrl);
-        if (!jsonData.empty()) {
-            processData(jsonData, currentData);
-        } else {
-            std::cerr << "Failed to fetch solar wind data. Using last valid values." << std::endl;
-            currentData.density = lastValidData.density_valid ? lastValidData.density : 0.0f;
-            currentData.speed = lastValidData.speed_valid ? lastValidData.speed : 0.0f;
-            currentData.temperature = lastValidData.temperature_valid ? lastValidData.temperature : 0.0f;
+    OSCSink loadSink;
+    if (loadTest.seconds > 0.0) {
+        if (!loadSink.open(loadTest.destinations)) {
+            logError("main") << "Load test: cannot open OSC receivers: " << loadSink.error();
+            return 1;
         }
+        for (int port : loadSink.ports()) oscSender.addDestination("127.0.0.1", port);
+    }
+    for (const std::string& text : destinations) {
+        std::string host, filter;
+        int port;
+        if (!parseDestination(text, host, port, filter)) {
+            logError("main") << "Invalid --dest: " << text << " (HOST:PORT or HOST:PORT/PATTERN)";
+            return 1;
+        }
+        if (!oscSender.addDestination(host, port, filter)) return 1;
+    }
+    if (multicastTtl > 0) oscSender.setMulticastTtl(multicastTtl);
 
-        // Fetch and process solar probabilities data
-        std::string solarProbabilitiesData = fetchData(solarProbabilitiesUrl);
-        if (!solarProbabilitiesData.empty()) {
-            processSolarProbabilities(solarProbabilitiesData, currentData);
+    OSCControlServer controlServer(oscSender, std::chrono::seconds(leaseSeconds));
+    for (const std::string& host : controlAllowed) {
+        if (!controlServer.allowHost(host)) {
+            logError("main") << "Invalid --control-allow host: " << host << " (IPv4 address expected)";
+        }
+    }
+    if (controlPort > 0) {
+        if (controlServer.open(controlPort, controlBind)) {
+            controlServer.start();
         } else {
-            std::cerr << "Failed to fetch solar probabilities data. Using last valid values." << std::endl;
-            currentData.m_class = lastValidData.m_class_valid ? lastValidData.m_class : 0;
-            currentData.x_class = lastValidData.x_class_valid ? lastValidData.x_class : 0;
+            logError("main") << "Subscriptions disabled: " << controlServer.error();
         }
+    }
+
+    compileSchema();
 
-        // Fetch and process magnetometer data
-        std::string magData = fetchData(magApiUrl);
-        if (!magData.empty()) {
-            processMagData(magData, currentData);
+    if (!shmName.empty()) {
+        if (shmName[0] != '/') shmName = "/" + shmName;
+        const char* fieldNames[ArchiveFieldCount];
+        for (size_t f = 0; f < ArchiveFieldCount; ++f) fieldNames[f] = fieldTable[f].name;
+        if (sharedOutput.open(shmName, shmRing, fieldNames, ArchiveFieldCount, shmReplace)) {
+            logInfo("main") << "✓ Shared memory: " << shmName << " (latest values + last "
+                            << sharedOutput.ringCapacity() << " samples, see solar_shm.h)";
         } else {
-            std::cerr << "Failed to fetch magnetometer data. Using last valid values." << std::endl;
-            currentData.lon_gsm = lastValidData.lon_gsm_valid ? lastValidData.lon_gsm : 0.0f;
-            currentData.bt = lastValidData.bt_valid ? lastValidData.bt : 0.0f;
-            currentData.bz_gsm = lastValidData.bz_gsm_valid ? lastValidData.bz_gsm : 0.0f;
+            logError("main") << "Shared memory disabled: " << sharedOutput.error();
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
 
-        // Fetch and process Kp-index data
-        std::string kpData = fetchData(kpIndexUrl);
-        if (!kpData.empty()) {
-            processKpIndexData(kpData, currentData);
+    // The restored snapshot goes out right away
+    if (!historyPath.empty()) {
+        int64_t restoredTime;
+        if (!archive.open(historyPath, ArchiveFieldCount)) {
+            logError("main") << "History disabled: " << archive.error();
+        } else if (restoreFromArchive(restoredTime)) {
+            logInfo("main") << "✓ Restored values from " << formatLocalTime(restoredTime, "%Y-%m-%d %H:%M") << " ("
+                            << historyPath << ")";
         } else {
-            std::cerr << "Failed to fetch Kp-index data. Using last valid values." << std::endl;
-            currentData.kp = lastValidData.kp_valid ? lastValidData.kp : 0.0f;
+            logInfo("main") << "✓ History: " << historyPath;
         }
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
-
-        // Print all data in clean format
-        printSolarData(currentData);
-        
-        // Wait for next update
-        for (int i = 0; i < 60 && running; ++i) {
-            std::this_thread::sleep_for(std::chrono::seconds(1));
+    }
+    if (!recordPath.empty()) {
+        if (recorder.open(recordPath)) {
+            logInfo("main") << "✓ Recording responses to: " << recordPath;
+        } else {
+            logError("main") << "Cannot record to " << recordPath << ": " << strerror(errno);
+        }
+    }
+    registerMetrics();
+    MetricsExporter metricsExporter(metrics);
+    if (metricsPort > 0) {
+        if (metricsExporter.serveHttp(metricsPort)) {
+            logInfo("main") << "✓ Metrics: http://127.0.0.1:" << metricsPort << "/metrics";
+        } else {
+            logError("main") << "Metrics endpoint disabled: " << metricsExporter.error();
         }
     }
+    if (metricsOscSeconds > 0.0) {
+        metricsExporter.streamOsc(oscSender, oscValueMode,
+                                  std::chrono::milliseconds((long long)(metricsOscSeconds * 1000)));
+        logInfo("main") << "✓ Metrics over OSC: /metrics/* every " << metricsOscSeconds << " s";
+    }
+    logInfo("main") << "✓ Press Ctrl+C to stop";
+    logger.report("─────────────────────────────────────────\n"
+                  "Starting data collection...\n");
     
-    std::cout << "The program terminated correctly." << std::endl;
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    if (streamHz > 0.0) {
+        smoothStream.reset(new InterpolatedStream(oscSender, streamHz, smoothing, oscValueMode));
+        // Канал на поле с адресом /smooth, в порядке fieldTable
+        static std::vector<size_t> channelFields;
+        for (size_t f = 0; f < ArchiveFieldCount; ++f) {
+            if (!fieldTable[f].smooth.size) continue;
+            fieldStreamChannels[f] = smoothStream->addChannel(fieldTable[f].smooth, fieldTable[f].precision);
+            channelFields.push_back(f);
+        }
+        if (sharedOutput.isOpen()) {
+            smoothStream->setFrameObserver([](size_t channel, int64_t unixMicros, float value) {
+                sharedOutput.push((uint32_t)channelFields[channel], SOLAR_SHM_SMOOTH, unixMicros, value);
+            });
+        }
+        smoothStream->start();
+    }
+
+    // Each feed runs on its own schedule: minute products are polled every
+    // minute, slower products back off while they do not change. On 304 Not
+    // Modified the cached values are re-sent without parsing.
+    std::vector<FeedDescriptor> feeds;
+    for (const std::unique_ptr<Feed>& schemaFeed : schemaFeeds) {
+        Feed* feed = schemaFeed.get();
+        const FeedSpec& spec = *feed->spec;
+        FeedDescriptor d;
+        d.name = spec.name;
+        d.url = spec.url;
+        d.interval = std::chrono::seconds(spec.intervalSeconds);
+        d.maxInterval = std::chrono::seconds(spec.maxIntervalSeconds);
+        // On failure nothing needs doing: the published snapshot keeps the last valid values
+        d.process = [feed](const std::string& body) { return processFeed(*feed, body); };
+        d.send = [feed]() { sendFeed(*feed); };
+        d.reuse = [feed]() {
+            SolarData data = solarSnapshot.load();
+            sendLatestValues(*feed->spec, data);
+            uint32_t fieldMask = ((1u << feed->spec->fieldCount) - 1) << feed->spec->firstField;
+            return (data.validMask & fieldMask) != 0;
+        };
+        feeds.push_back(d);
+    }
+
+    if (!replayPath.empty()) {
+        runReplay(replayPath, replaySpeed, feeds);
+    } else if (loadTest.seconds > 0.0) {
+        runLoadTest(feeds, loadTest, loadSink);
+    } else {
+        runLive(feeds);
+    }
+
+    if (smoothStream) {
+        smoothStream->stop();
+        std::ostringstream out;
+        printStreamReport(out, true);
+        logger.report(out.str());
+    }
+    metricsExporter.stop();
+    controlServer.stop();
+    sharedOutput.close();
+    archive.close();
+    recorder.close();
+    logInfo("main") << "The program terminated correctly.";
+    logger.stop();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include "metrics.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "osc.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+LatencyHistogram::LatencyHistogram() {
+    for (auto& b : buckets_) b.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::record(std::chrono::microseconds duration) {
+    recordMicros(duration.count());
+}
+
+void LatencyHistogram::recordMicros(int64_t micros) {
+    if (micros < 0) micros = 0;
+    int bucket = micros == 0 ? 0 : 64 - __builtin_clzll((uint64_t)micros);
+    if (bucket >= bucketCount) bucket = bucketCount - 1;
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+    sumMicros_.fetch_add((uint64_t)micros, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    uint64_t total = 0;
+    for (const auto& b : buckets_) total += b.load(std::memory_order_relaxed);
+    return total;
+}
+
+double LatencyHistogram::quantileSeconds(double q) const {
+    uint64_t total = count();
+    if (total == 0) return 0.0;
+    uint64_t target = (uint64_t)(q * (double)total);
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; ++i) {
+        seen += bucket(i);
+        if (seen > target) return bucketBoundSeconds(i);
+    }
+    return bucketBoundSeconds(bucketCount - 1);
+}
+
+MetricsRegistry::MetricsRegistry() {}
+
+MetricsRegistry::~MetricsRegistry() {}
+
+MetricsRegistry::Entry& MetricsRegistry::add(Kind kind, const std::string& name, const std::string& help,
+                                              const std::string& labels) {
+    std::unique_ptr<Entry> entry(new Entry);
+    entry->kind = kind;
+    entry->name = name;
+    entry->help = help;
+    entry->labels = labels;
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.push_back(std::move(entry));
+    return *entries_.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels) {
+    Entry& entry = add(CounterKind, name, help, labels);
+    entry.ownedCounter.reset(new Counter);
+    return *entry.ownedCounter;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                             const std::string& labels) {
+    Entry& entry = add(HistogramKind, name, help, labels);
+    entry.ownedHistogram.reset(new LatencyHistogram);
+    entry.histogram = entry.ownedHistogram.get();
+    return *entry.ownedHistogram;
+}
+
+void MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels,
+                                const LatencyHistogram* external) {
+    add(HistogramKind, name, help, labels).histogram = external;
+}
+
+void MetricsRegistry::counterFunction(const std::string& name, const std::string& help,
+                                      const std::string& labels, std::function<double()> value) {
+    add(CounterKind, name, help, labels).value = value;
+}
+
+void MetricsRegistry::gaugeFunction(const std::string& name, const std::string& help, const std::string& labels,
+                                    std::function<double()> value) {
+    add(GaugeKind, name, help, labels).value = value;
+}
+
+double MetricsRegistry::Entry::current() const {
+    if (ownedCounter) return (double)ownedCounter->value();
+    return value ? value() : 0.0;
+}
+
+static std::string formatNumber(double value) {
+    char text[32];
+    snprintf(text, sizeof(text), "%.9g", value);
+    return text;
+}
+
+static std::string withLabels(const std::string& name, const std::string& labels, const std::string& extra = "") {
+    if (labels.empty() && extra.empty()) return name;
+    return name + "{" + labels + (labels.empty() || extra.empty() ? "" : ",") + extra + "}";
+}
+
+std::string MetricsRegistry::prometheusText() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string out;
+    std::vector<bool> written(entries_.size(), false);
+
+    // Series of one name are grouped under a single HELP/TYPE header
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (written[i]) continue;
+        const Entry& first = *entries_[i];
+        static const char* types[] = {"counter", "gauge", "histogram"};
+        out += "# HELP " + first.name + " " + first.help + "\n";
+        out += "# TYPE " + first.name + " " + types[first.kind] + "\n";
+
+        for (size_t j = i; j < entries_.size(); ++j) {
+            const Entry& e = *entries_[j];
+            if (written[j] || e.name != first.name) continue;
+            written[j] = true;
+
+            if (e.kind != HistogramKind) {
+                out += withLabels(e.name, e.labels) + " " + formatNumber(e.current()) + "\n";
+                continue;
+            }
+            uint64_t cumulative = 0;
+            for (int b = 0; b < LatencyHistogram::bucketCount; ++b) {
+                cumulative += e.histogram->bucket(b);
+                std::string le = "le=\"" + formatNumber(LatencyHistogram::bucketBoundSeconds(b)) + "\"";
+                out += withLabels(e.name + "_bucket", e.labels, le) + " " + std::to_string(cumulative) + "\n";
+            }
+            uint64_t count = e.histogram->count();
+            out += withLabels(e.name + "_bucket", e.labels, "le=\"+Inf\"") + " " + std::to_string(count) + "\n";
+            out += withLabels(e.name + "_sum", e.labels) + " " + formatNumber(e.histogram->sumSeconds()) + "\n";
+            out += withLabels(e.name + "_count", e.labels) + " " + std::to_string(count) + "\n";
+        }
+    }
+    return out;
+}
+
+// solar_fetch_seconds + feed="solar wind",stage="dns" -> /metrics/fetch_seconds/solar_wind/dns
+static std::string oscPath(const std::string& name, const std::string& labels) {
+    std::string path = "/metrics/" + (name.compare(0, 6, "solar_") == 0 ? name.substr(6) : name);
+    bool inValue = false;
+    for (char c : labels) {
+        if (c == '"') {
+            inValue = !inValue;
+            if (inValue) path += '/';
+        } else if (inValue) {
+            // Characters with a meaning in OSC address patterns
+            path += (c == ' ' || strchr("#*,/?[]{}", c)) ? '_' : c;
+        }
+    }
+    return path;
+}
+
+// Address with its NUL padding, as OSCAddressView expects
+static std::string padded(std::string address) {
+    address.resize((address.size() + 4) & ~size_t(3), '\0');
+    return address;
+}
+
+int MetricsRegistry::sendOsc(OSCSender& sender, OSCValueMode mode) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    OSCBundle bundle(mode);
+    int datagrams = 0;
+    auto add = [&](const std::string& path, float value) {
+        std::string address = padded(path);
+        OSCAddressView view(address.data(), address.size());
+        if (!bundle.addFloat(view, value, 6)) {
+            datagrams += sender.send(bundle) > 0 ? 1 : 0;
+            bundle.clear();
+            bundle.addFloat(view, value, 6);
+        }
+    };
+
+    for (const auto& entry : entries_) {
+        std::string path = oscPath(entry->name, entry->labels);
+        if (entry->kind != HistogramKind) {
+            add(path, (float)entry->current());
+        } else {
+            add(path + "/p50", (float)entry->histogram->quantileSeconds(0.50));
+            add(path + "/p99", (float)entry->histogram->quantileSeconds(0.99));
+            add(path + "/count", (float)entry->histogram->count());
+        }
+    }
+    if (!bundle.empty()) datagrams += sender.send(bundle) > 0 ? 1 : 0;
+    return datagrams;
+}
+
+MetricsExporter::MetricsExporter(const MetricsRegistry& registry) : registry_(registry) {}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::serveHttp(int port) {
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0) {
+        error_ = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+    int yes = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    // Local only: the numbers are for a scraper on the same machine
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    if (bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 16) != 0) {
+        error_ = "port " + std::to_string(port) + ": " + strerror(errno);
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    httpThread_ = std::thread(&MetricsExporter::httpLoop, this);
+    return true;
+}
+
+void MetricsExporter::streamOsc(OSCSender& sender, OSCValueMode mode, std::chrono::milliseconds interval) {
+    oscThread_ = std::thread(&MetricsExporter::oscLoop, this, &sender, mode, interval);
+}
+
+void MetricsExporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    stopped_.notify_all();
+    if (oscThread_.joinable()) oscThread_.join();
+    if (httpThread_.joinable()) httpThread_.join();
+    if (listenFd_ >= 0) close(listenFd_);
+    listenFd_ = -1;
+}
+
+// One request per connection; scrapes are rare and small
+void MetricsExporter::httpLoop() {
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(stopMutex_);
+            if (stopping_) return;
+        }
+        pollfd p = {listenFd_, POLLIN, 0};
+        if (poll(&p, 1, 200) <= 0) continue;
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) continue;
+
+        timeval timeout = {2, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::string request;
+        char chunk[1024];
+        while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0) break;
+            request.append(chunk, (size_t)n);
+        }
+
+        std::string response;
+        if (request.compare(0, 13, "GET /metrics ") == 0 || request.compare(0, 6, "GET / ") == 0) {
+            std::string body = registry_.prometheusText();
+            response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                       std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        } else {
+            response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        }
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            sent += (size_t)n;
+        }
+        close(fd);
+    }
+}
+
+void MetricsExporter::oscLoop(OSCSender* sender, OSCValueMode mode, std::chrono::milliseconds interval) {
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    while (!stopped_.wait_for(lock, interval, [this]() { return stopping_; })) {
+        lock.unlock();
+        registry_.sendOsc(*sender, mode);
+        lock.lock();
+    }
+}
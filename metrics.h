@@ -0,0 +1,145 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Monotonic count; one relaxed atomic add on the hot path
+class Counter {
+public:
+    void add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const { return value_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value_{0};
+};
+
+// Durations in log2 microsecond buckets: [0,1us), [1,2us), [2,4us) ...
+// Recording is two relaxed atomic adds and a bit scan.
+class LatencyHistogram {
+public:
+    static const int bucketCount = 32;  // last bucket: >= 18 minutes
+
+    LatencyHistogram();
+
+    void record(std::chrono::microseconds duration);
+    void recordMicros(int64_t micros);
+
+    uint64_t count() const;
+    double sumSeconds() const { return sumMicros_.load(std::memory_order_relaxed) / 1e6; }
+    uint64_t bucket(int i) const { return buckets_[i].load(std::memory_order_relaxed); }
+    // Upper bound of bucket i in seconds
+    static double bucketBoundSeconds(int i) { return (double)(1ULL << i) / 1e6; }
+    // Upper bound of the bucket that holds the quantile, in seconds; 0 if empty
+    double quantileSeconds(double q) const;
+
+private:
+    std::atomic<uint64_t> buckets_[bucketCount];
+    std::atomic<uint64_t> sumMicros_{0};
+};
+
+// Times a scope into a histogram
+class StageTimer {
+public:
+    explicit StageTimer(LatencyHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~StageTimer() {
+        histogram_.record(std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_));
+    }
+
+private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+class OSCSender;
+enum class OSCValueMode;
+
+// Named metrics with Prometheus-style labels. Metrics are created once at
+// startup (under a lock) and then updated through the returned references,
+// which stay valid for the registry's lifetime. Values that already live
+// elsewhere (a snapshot, a sender's counters) are exported through
+// callbacks evaluated at export time.
+class MetricsRegistry {
+public:
+    MetricsRegistry();
+    ~MetricsRegistry();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    // labels: "" or Prometheus syntax without braces, e.g. feed="kp",stage="dns"
+    Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+    LatencyHistogram& histogram(const std::string& name, const std::string& help, const std::string& labels = "");
+    void histogram(const std::string& name, const std::string& help, const std::string& labels,
+                   const LatencyHistogram* external);
+    void counterFunction(const std::string& name, const std::string& help, const std::string& labels,
+                         std::function<double()> value);
+    void gaugeFunction(const std::string& name, const std::string& help, const std::string& labels,
+                       std::function<double()> value);
+
+    // Prometheus text exposition format 0.0.4
+    std::string prometheusText() const;
+
+    // /metrics/<name>/<label values...>, histograms as .../p50, .../p99 and
+    // .../count, packed into MTU-sized bundles. Returns datagrams sent.
+    int sendOsc(OSCSender& sender, OSCValueMode mode) const;
+
+private:
+    enum Kind { CounterKind, GaugeKind, HistogramKind };
+    struct Entry {
+        Kind kind;
+        std::string name;
+        std::string help;
+        std::string labels;
+        std::unique_ptr<Counter> ownedCounter;
+        std::unique_ptr<LatencyHistogram> ownedHistogram;
+        const LatencyHistogram* histogram = nullptr;
+        std::function<double()> value;
+
+        double current() const;
+    };
+
+    Entry& add(Kind kind, const std::string& name, const std::string& help, const std::string& labels);
+
+    mutable std::mutex mutex_;
+    std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+// Serves the registry as Prometheus text on 127.0.0.1:<port>/metrics and
+// sends it over OSC every interval, each on its own thread
+class MetricsExporter {
+public:
+    explicit MetricsExporter(const MetricsRegistry& registry);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    bool serveHttp(int port);
+    void streamOsc(OSCSender& sender, OSCValueMode mode, std::chrono::milliseconds interval);
+    void stop();
+
+    const std::string& error() const { return error_; }
+
+private:
+    void httpLoop();
+    void oscLoop(OSCSender* sender, OSCValueMode mode, std::chrono::milliseconds interval);
+
+    const MetricsRegistry& registry_;
+    std::string error_;
+    int listenFd_ = -1;
+    std::thread httpThread_;
+    std::thread oscThread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopped_;
+    bool stopping_ = false;
+};
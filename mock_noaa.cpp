@@ -0,0 +1,370 @@
+#include "mock_noaa.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <netinet/in.h>
+#include <strings.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const size_t maxRequestBytes = 16 * 1024;
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0  // macOS: SO_NOSIGPIPE is set on the socket instead
+#endif
+
+int64_t wallClockMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// "2024-05-10 12:34:00.000", as NOAA writes time_tag
+static std::string formatTimeTag(int64_t unixSeconds) {
+    time_t t = (time_t)unixSeconds;
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    char out[32];
+    strftime(out, sizeof(out), "%Y-%m-%d %H:%M:%S.000", &utc);
+    return out;
+}
+
+static std::string formatDate(int64_t unixSeconds) {
+    time_t t = (time_t)unixSeconds;
+    struct tm utc;
+    gmtime_r(&t, &utc);
+    char out[16];
+    strftime(out, sizeof(out), "%Y-%m-%d", &utc);
+    return out;
+}
+
+// Rows kept in a response, like the 5-minute and 7-day NOAA files
+static size_t rowWindow(MockProduct product) {
+    return product == MockProduct::Kp ? 56 : 6;
+}
+
+MockNoaaServer::MockNoaaServer() : random_(std::random_device()()) {}
+
+MockNoaaServer::~MockNoaaServer() {
+    stop();
+}
+
+size_t MockNoaaServer::addFeed(const MockFeedConfig& config) {
+    std::unique_ptr<Feed> feed(new Feed);
+    feed->config = config;
+    if (feed->config.update.count() <= 0) feed->config.update = std::chrono::milliseconds(1);
+    feed->rowStep = config.product == MockProduct::Kp ? 3 * 3600 : 60;
+    feeds_.push_back(std::move(feed));
+    return feeds_.size() - 1;
+}
+
+bool MockNoaaServer::start() {
+    listenFd_ = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenFd_ < 0) {
+        error_ = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+    int yes = 1;
+    setsockopt(listenFd_, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(listenFd_, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd_, 512) != 0 ||
+        getsockname(listenFd_, (sockaddr*)&addr, &len) != 0) {
+        error_ = std::string("bind: ") + strerror(errno);
+        close(listenFd_);
+        listenFd_ = -1;
+        return false;
+    }
+    port_ = ntohs(addr.sin_port);
+
+    startMicros_ = wallClockMicros();
+    int64_t startSeconds = startMicros_ / 1000000;
+    for (auto& feed : feeds_) {
+        feed->firstRowTime = startSeconds / feed->rowStep * feed->rowStep;
+    }
+
+    acceptThread_ = std::thread(&MockNoaaServer::acceptLoop, this);
+    return true;
+}
+
+void MockNoaaServer::stop() {
+    if (listenFd_ < 0) return;
+    stopping_ = true;
+
+    // Wakes accept() and every recv() blocked on a connection
+    shutdown(listenFd_, SHUT_RDWR);
+    acceptThread_.join();
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        for (int fd : connectionFds_) shutdown(fd, SHUT_RDWR);
+    }
+    for (std::thread& t : connectionThreads_) t.join();
+    connectionThreads_.clear();
+    for (int fd : connectionFds_) close(fd);
+    connectionFds_.clear();
+
+    close(listenFd_);
+    listenFd_ = -1;
+}
+
+std::string MockNoaaServer::url(size_t feed) const {
+    return "http://127.0.0.1:" + std::to_string(port_) + feeds_[feed]->config.path;
+}
+
+bool MockNoaaServer::hasRows(size_t feed) const {
+    MockProduct product = feeds_[feed]->config.product;
+    return product == MockProduct::Plasma || product == MockProduct::Mag || product == MockProduct::Kp;
+}
+
+int64_t MockNoaaServer::rowTime(size_t feed, uint64_t version) const {
+    return feeds_[feed]->firstRowTime + (int64_t)version * feeds_[feed]->rowStep;
+}
+
+bool MockNoaaServer::versionOf(size_t feed, int64_t time, uint64_t& version) const {
+    const Feed& f = *feeds_[feed];
+    int64_t offset = time - f.firstRowTime;
+    if (offset <= 0 || offset % f.rowStep != 0) return false;
+    version = (uint64_t)(offset / f.rowStep);
+    return true;
+}
+
+int64_t MockNoaaServer::publishedMicros(size_t feed, uint64_t version) const {
+    return startMicros_ + (int64_t)version * feeds_[feed]->config.update.count() * 1000;
+}
+
+int64_t MockNoaaServer::requestedMicros(size_t feed, uint64_t version) const {
+    const Feed& f = *feeds_[feed];
+    std::lock_guard<std::mutex> lock(f.mutex);
+    return version < f.requested.size() ? f.requested[version] : 0;
+}
+
+uint64_t MockNoaaServer::currentVersion(size_t feed) const {
+    int64_t elapsed = wallClockMicros() - startMicros_;
+    return elapsed <= 0 ? 0 : (uint64_t)(elapsed / (feeds_[feed]->config.update.count() * 1000));
+}
+
+MockServerStats MockNoaaServer::stats() const {
+    MockServerStats s;
+    s.requests = requests_;
+    s.bodies = bodies_;
+    s.notModified = notModified_;
+    s.failed = failed_;
+    s.bytes = bytes_;
+    return s;
+}
+
+void MockNoaaServer::acceptLoop() {
+    while (!stopping_) {
+        int fd = accept(listenFd_, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        if (stopping_) {
+            close(fd);
+            break;
+        }
+#ifdef SO_NOSIGPIPE
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+#endif
+        connectionFds_.push_back(fd);
+        connectionThreads_.push_back(std::thread(&MockNoaaServer::serve, this, fd));
+    }
+}
+
+// One connection: requests are answered in order until the client closes it
+void MockNoaaServer::serve(int fd) {
+    std::string buffer;
+    char chunk[4096];
+    bool keepAlive = true;
+    while (keepAlive && !stopping_) {
+        size_t end;
+        while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n <= 0 || buffer.size() > maxRequestBytes) return;
+            buffer.append(chunk, (size_t)n);
+        }
+        int64_t arrived = wallClockMicros();
+        std::string request = buffer.substr(0, end + 4);
+        buffer.erase(0, end + 4);
+
+        std::string response = respond(request, arrived, keepAlive);
+        size_t sent = 0;
+        while (sent < response.size()) {
+            ssize_t n = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return;
+            sent += (size_t)n;
+        }
+    }
+}
+
+static std::string headerValue(const std::string& request, const char* name) {
+    size_t nameLength = strlen(name);
+    size_t pos = 0;
+    while ((pos = request.find("\r\n", pos)) != std::string::npos) {
+        pos += 2;
+        if (request.size() - pos > nameLength && strncasecmp(request.c_str() + pos, name, nameLength) == 0 &&
+            request[pos + nameLength] == ':') {
+            size_t begin = request.find_first_not_of(' ', pos + nameLength + 1);
+            size_t end = request.find("\r\n", pos);
+            return begin < end ? request.substr(begin, end - begin) : std::string();
+        }
+    }
+    return std::string();
+}
+
+static std::string statusResponse(int status, const char* reason, bool keepAlive) {
+    return "HTTP/1.1 " + std::to_string(status) + " " + reason + "\r\nContent-Length: 0\r\n" +
+           (keepAlive ? "" : "Connection: close\r\n") + "\r\n";
+}
+
+std::string MockNoaaServer::respond(const std::string& request, int64_t arrivedMicros, bool& keepAlive) {
+    ++requests_;
+    keepAlive = strcasecmp(headerValue(request, "Connection").c_str(), "close") != 0;
+
+    size_t pathBegin = request.find(' ');
+    size_t pathEnd = pathBegin == std::string::npos ? pathBegin : request.find(' ', pathBegin + 1);
+    if (request.compare(0, 4, "GET ") != 0 || pathEnd == std::string::npos) {
+        ++failed_;
+        keepAlive = false;
+        return statusResponse(400, "Bad Request", false);
+    }
+    std::string path = request.substr(pathBegin + 1, pathEnd - pathBegin - 1);
+
+    Feed* feed = nullptr;
+    size_t index = 0;
+    for (; index < feeds_.size(); ++index) {
+        if (feeds_[index]->config.path == path) {
+            feed = feeds_[index].get();
+            break;
+        }
+    }
+    if (!feed) {
+        ++failed_;
+        return statusResponse(404, "Not Found", keepAlive);
+    }
+
+    std::this_thread::sleep_for(responseDelay(*feed));
+    if (injectFailure(*feed)) {
+        ++failed_;
+        return statusResponse(500, "Internal Server Error", keepAlive);
+    }
+
+    uint64_t version = currentVersion(index);
+    std::string etag = "\"" + std::to_string(index) + "-" + std::to_string(version) + "\"";
+    std::lock_guard<std::mutex> lock(feed->mutex);
+    if (feed->requested.size() <= version) feed->requested.resize(version + 1, 0);
+    // Every version up to this one is now out: the body carries the rows
+    // that were skipped since the last poll too
+    for (uint64_t v = version + 1; v-- > 0 && feed->requested[v] == 0;) {
+        feed->requested[v] = arrivedMicros;
+    }
+
+    if (headerValue(request, "If-None-Match") == etag) {
+        ++notModified_;
+        return "HTTP/1.1 304 Not Modified\r\nETag: " + etag + "\r\n" + (keepAlive ? "" : "Connection: close\r\n") +
+               "\r\n";
+    }
+
+    const std::string& body = bodyFor(*feed, version);
+    ++bodies_;
+    bytes_ += body.size();
+    return "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nETag: " + etag +
+           "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n" +
+           (keepAlive ? "" : "Connection: close\r\n") + "\r\n" + body;
+}
+
+std::chrono::milliseconds MockNoaaServer::responseDelay(const Feed& feed) {
+    long long delay = feed.config.latency.count();
+    if (feed.config.jitter.count() > 0) {
+        std::lock_guard<std::mutex> lock(randomMutex_);
+        std::uniform_int_distribution<long long> jitter(-feed.config.jitter.count(), feed.config.jitter.count());
+        delay += jitter(random_);
+    }
+    return std::chrono::milliseconds(std::max(0LL, delay));
+}
+
+bool MockNoaaServer::injectFailure(const Feed& feed) {
+    if (feed.config.failureRate <= 0.0) return false;
+    std::lock_guard<std::mutex> lock(randomMutex_);
+    return std::uniform_real_distribution<double>(0.0, 1.0)(random_) < feed.config.failureRate;
+}
+
+// Body of a version, in the product's NOAA schema; rebuilt once per version.
+// Called with the feed's mutex held.
+const std::string& MockNoaaServer::bodyFor(Feed& feed, uint64_t version) {
+    if (feed.bodyVersion == version) return feed.body;
+    feed.bodyVersion = version;
+
+    std::string& out = feed.body;
+    char row[256];
+    int64_t newest = feed.firstRowTime + (int64_t)version * feed.rowStep;
+    size_t rows = rowWindow(feed.config.product);
+
+    switch (feed.config.product) {
+        case MockProduct::Plasma:
+            out = "[[\"time_tag\",\"density\",\"speed\",\"temperature\"]";
+            for (size_t i = rows; i-- > 0;) {
+                int64_t t = newest - (int64_t)i * feed.rowStep;
+                snprintf(row, sizeof(row), ",[\"%s\",\"%.2f\",\"%.1f\",\"%d\"]", formatTimeTag(t).c_str(),
+                         3.0 + (t / 60 % 40) * 0.1, 400.0 + (double)(t / 60 % 200), 60000 + (int)(t / 60 % 5000));
+                out += row;
+            }
+            out += "]";
+            break;
+        case MockProduct::Mag:
+            out = "[[\"time_tag\",\"bx_gsm\",\"by_gsm\",\"bz_gsm\",\"lon_gsm\",\"lat_gsm\",\"bt\"]";
+            for (size_t i = rows; i-- > 0;) {
+                int64_t t = newest - (int64_t)i * feed.rowStep;
+                snprintf(row, sizeof(row), ",[\"%s\",\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\",\"%.2f\"]",
+                         formatTimeTag(t).c_str(), -2.0 + (double)(t / 60 % 7), 1.5, -5.0 + (double)(t / 60 % 10),
+                         (double)(t / 60 % 360), 10.0, 6.5);
+                out += row;
+            }
+            out += "]";
+            break;
+        case MockProduct::Kp:
+            out = "[[\"time_tag\",\"Kp\",\"a_running\",\"station_count\"]";
+            for (size_t i = rows; i-- > 0;) {
+                int64_t t = newest - (int64_t)i * feed.rowStep;
+                snprintf(row, sizeof(row), ",[\"%s\",\"%.2f\",\"%d\",\"8\"]", formatTimeTag(t).c_str(),
+                         (double)(t / feed.rowStep % 27) / 3.0, (int)(t / feed.rowStep % 80));
+                out += row;
+            }
+            out += "]";
+            break;
+        case MockProduct::Probabilities:
+            out = "[";
+            for (int day = 0; day < 3; ++day) {
+                snprintf(row, sizeof(row),
+                         "%s{\"date\":\"%s\",\"c_class_1_day\":99,\"m_class_1_day\":%d,\"x_class_1_day\":%d,"
+                         "\"10mev_protons_1_day\":5,\"polar_cap_absorption\":\"green\"}",
+                         day ? "," : "", formatDate(newest + day * 86400).c_str(), (int)(version % 90),
+                         (int)(version % 30));
+                out += row;
+            }
+            out += "]";
+            break;
+        case MockProduct::Regions:
+            out = "[";
+            for (int region = 0; region < 8 + (int)(version % 5); ++region) {
+                snprintf(row, sizeof(row),
+                         "%s{\"observed_date\":\"%s\",\"region\":%d,\"latitude\":%d,\"longitude\":%d,"
+                         "\"area\":%d,\"spot_class\":\"Dai\",\"mag_class\":\"BG\"}",
+                         region ? "," : "", formatDate(newest).c_str(), 13650 + region, region * 3 - 12,
+                         region * 9 - 40, 100 + region * 20);
+                out += row;
+            }
+            out += "]";
+            break;
+    }
+    return out;
+}
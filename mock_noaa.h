@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Response schemas the mock can serve, as NOAA lays them out
+enum class MockProduct {
+    Plasma,         // [["time_tag","density","speed","temperature"], ...], a row per minute
+    Mag,            // [["time_tag","bx_gsm",...,"bt"], ...], a row per minute
+    Kp,             // [["time_tag","Kp","a_running","station_count"], ...], a row per 3 hours
+    Probabilities,  // [{"date":...,"m_class_1_day":...}, ...]
+    Regions,        // [{"observed_date":...,"region":...}, ...]
+};
+
+struct MockFeedConfig {
+    MockProduct product = MockProduct::Plasma;
+    std::string path;                            // e.g. /products/solar-wind/plasma-5-minute.json
+    std::chrono::milliseconds update{60000};     // a new version this often
+    std::chrono::milliseconds latency{0};        // before every response
+    std::chrono::milliseconds jitter{0};         // +/- on top of the latency
+    double failureRate = 0.0;                    // share of requests answered with 500
+};
+
+struct MockServerStats {
+    uint64_t requests = 0;
+    uint64_t bodies = 0;        // 200
+    uint64_t notModified = 0;   // 304
+    uint64_t failed = 0;        // 500 (injected) and 404
+    uint64_t bytes = 0;         // response bodies
+};
+
+// Local stand-in for services.swpc.noaa.gov, for load tests.
+// Every feed publishes version 1, 2, ... every `update` from start(); each
+// version adds one row (time series products) or changes the values. It
+// speaks plain HTTP/1.1 with keep-alive and ETag revalidation, one thread
+// per connection, on an ephemeral port of 127.0.0.1.
+//
+// For time series products version v is the row whose time_tag is
+// rowTime(feed, v), so a sample that comes out the other end can be traced
+// back to the moment it was published and the request that picked it up.
+// Times are Unix microseconds of the system clock, like OSC timetags.
+class MockNoaaServer {
+public:
+    MockNoaaServer();
+    ~MockNoaaServer();
+
+    MockNoaaServer(const MockNoaaServer&) = delete;
+    MockNoaaServer& operator=(const MockNoaaServer&) = delete;
+
+    // Feeds are added before start(); returns the feed index
+    size_t addFeed(const MockFeedConfig& config);
+
+    bool start();
+    void stop();
+    const std::string& error() const { return error_; }
+
+    std::string url(size_t feed) const;
+    size_t feedCount() const { return feeds_.size(); }
+    const MockFeedConfig& config(size_t feed) const { return feeds_[feed]->config; }
+
+    // Time series products only: data time of a version's row, and back.
+    // versionOf() fails for rows that were already there at start.
+    bool hasRows(size_t feed) const;
+    int64_t rowTime(size_t feed, uint64_t version) const;
+    bool versionOf(size_t feed, int64_t rowTime, uint64_t& version) const;
+
+    int64_t publishedMicros(size_t feed, uint64_t version) const;
+    // Arrival of the first request answered with this version or a later
+    // one; 0 if none was
+    int64_t requestedMicros(size_t feed, uint64_t version) const;
+    // Versions published so far
+    uint64_t currentVersion(size_t feed) const;
+
+    MockServerStats stats() const;
+
+private:
+    struct Feed {
+        MockFeedConfig config;
+        int64_t rowStep = 60;       // seconds between rows
+        int64_t firstRowTime = 0;   // time_tag of version 0
+
+        mutable std::mutex mutex;
+        uint64_t bodyVersion = UINT64_MAX;
+        std::string body;
+        std::vector<int64_t> requested;  // by version, 0 = not yet
+    };
+
+    void acceptLoop();
+    void serve(int fd);
+    std::string respond(const std::string& request, int64_t arrivedMicros, bool& keepAlive);
+    const std::string& bodyFor(Feed& feed, uint64_t version);
+    std::chrono::milliseconds responseDelay(const Feed& feed);
+    bool injectFailure(const Feed& feed);
+
+    std::vector<std::unique_ptr<Feed>> feeds_;
+    std::string error_;
+    int listenFd_ = -1;
+    int port_ = 0;
+    int64_t startMicros_ = 0;
+
+    std::thread acceptThread_;
+    std::mutex connectionsMutex_;
+    std::vector<int> connectionFds_;
+    std::vector<std::thread> connectionThreads_;
+    std::atomic<bool> stopping_{false};
+
+    std::mutex randomMutex_;
+    std::mt19937 random_;
+
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> bodies_{0};
+    std::atomic<uint64_t> notModified_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> bytes_{0};
+};
+
+// Unix time in microseconds
+int64_t wallClockMicros();
@@ -0,0 +1,684 @@
+#include "osc.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "logger.h"
+
+uint64_t oscTimetagNow() {
+    // NTP epoch is 1900-01-01, Unix epoch is 1970-01-01
+    const uint64_t ntpUnixOffset = 2208988800ULL;
+    auto sinceEpoch = std::chrono::system_clock::now().time_since_epoch();
+    auto micros = std::chrono::duration_cast<std::chrono::microseconds>(sinceEpoch).count();
+    uint64_t seconds = (uint64_t)(micros / 1000000) + ntpUnixOffset;
+    uint64_t fraction = ((uint64_t)(micros % 1000000) << 32) / 1000000;
+    return (seconds << 32) | fraction;
+}
+
+uint64_t oscTimetagFromUnix(int64_t seconds) {
+    return (uint64_t)(seconds + 2208988800LL) << 32;
+}
+
+static void writeBigEndian32(char* out, uint32_t value) {
+    out[0] = (char)(value >> 24);
+    out[1] = (char)(value >> 16);
+    out[2] = (char)(value >> 8);
+    out[3] = (char)value;
+}
+
+static void writeBigEndian64(char* out, uint64_t value) {
+    writeBigEndian32(out, (uint32_t)(value >> 32));
+    writeBigEndian32(out + 4, (uint32_t)value);
+}
+
+OSCMessageHeader::OSCMessageHeader(const OSCAddressView& address, Argument argument, OSCValueMode mode)
+    : argument_(argument), mode_(mode) {
+    static const char* const typed[] = {"f", "i", "tf"};
+    static const char* const text[] = {"s", "s", "ts"};
+    const char* types = mode == OSCValueMode::Typed ? typed[argument] : text[argument];
+    size_t typeCount = strlen(types);
+    bytes_.assign(address.bytes, address.size);
+    bytes_ += ',';
+    bytes_ += types;
+    // ",<types>" plus at least one NUL, padded to four bytes
+    bytes_.resize(address.size + ((typeCount + 1 + 4) & ~size_t(3)), '\0');
+}
+
+bool OSCWriter::reserve(size_t bytes) {
+    if (overflow_ || size_ + bytes > capacity_) {
+        overflow_ = true;
+        return false;
+    }
+    return true;
+}
+
+bool OSCWriter::beginBundle(uint64_t timetag) {
+    if (!reserve(16)) return false;
+    memcpy(buffer_ + size_, "#bundle", 8);
+    writeBigEndian64(buffer_ + size_ + 8, timetag);
+    size_ += 16;
+    inBundle_ = true;
+    return true;
+}
+
+bool OSCWriter::beginMessage(const OSCAddressView& address, const char* types, size_t& sizeOffset) {
+    size_t typeCount = strlen(types);
+    // ",<types>" plus at least one NUL, padded to four bytes
+    size_t tagSize = (typeCount + 1 + 4) & ~size_t(3);
+    size_t header = (inBundle_ ? 4 : 0) + address.size + tagSize;
+    if (!reserve(header)) return false;
+
+    sizeOffset = size_;
+    if (inBundle_) size_ += 4;
+
+    memcpy(buffer_ + size_, address.bytes, address.size);
+    size_ += address.size;
+
+    char* tag = buffer_ + size_;
+    tag[0] = ',';
+    memcpy(tag + 1, types, typeCount);
+    memset(tag + 1 + typeCount, 0, tagSize - 1 - typeCount);
+    size_ += tagSize;
+    return true;
+}
+
+void OSCWriter::endMessage(size_t sizeOffset) {
+    if (inBundle_) {
+        writeBigEndian32(buffer_ + sizeOffset, (uint32_t)(size_ - sizeOffset - 4));
+    }
+}
+
+bool OSCWriter::addFloat(const OSCAddressView& address, float value) {
+    size_t start = size_;
+    size_t sizeOffset = 0;
+    if (!beginMessage(address, "f", sizeOffset) || !reserve(4)) {
+        size_ = start;
+        return false;
+    }
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeBigEndian32(buffer_ + size_, bits);
+    size_ += 4;
+    endMessage(sizeOffset);
+    return true;
+}
+
+bool OSCWriter::addInt(const OSCAddressView& address, int32_t value) {
+    size_t start = size_;
+    size_t sizeOffset = 0;
+    if (!beginMessage(address, "i", sizeOffset) || !reserve(4)) {
+        size_ = start;
+        return false;
+    }
+    writeBigEndian32(buffer_ + size_, (uint32_t)value);
+    size_ += 4;
+    endMessage(sizeOffset);
+    return true;
+}
+
+bool OSCWriter::addDouble(const OSCAddressView& address, double value) {
+    size_t start = size_;
+    size_t sizeOffset = 0;
+    if (!beginMessage(address, "d", sizeOffset) || !reserve(8)) {
+        size_ = start;
+        return false;
+    }
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeBigEndian64(buffer_ + size_, bits);
+    size_ += 8;
+    endMessage(sizeOffset);
+    return true;
+}
+
+bool OSCWriter::addTimetag(const OSCAddressView& address, uint64_t timetag) {
+    size_t start = size_;
+    size_t sizeOffset = 0;
+    if (!beginMessage(address, "t", sizeOffset) || !reserve(8)) {
+        size_ = start;
+        return false;
+    }
+    writeBigEndian64(buffer_ + size_, timetag);
+    size_ += 8;
+    endMessage(sizeOffset);
+    return true;
+}
+
+bool OSCWriter::addString(const OSCAddressView& address, const char* value) {
+    size_t start = size_;
+    size_t sizeOffset = 0;
+    size_t length = strlen(value);
+    // At least one NUL, then pad to four bytes
+    size_t padded = (length + 4) & ~size_t(3);
+    if (!beginMessage(address, "s", sizeOffset) || !reserve(padded)) {
+        size_ = start;
+        return false;
+    }
+    memcpy(buffer_ + size_, value, length);
+    memset(buffer_ + size_ + length, 0, padded - length);
+    size_ += padded;
+    endMessage(sizeOffset);
+    return true;
+}
+
+bool OSCWriter::addTimedFloat(const OSCAddressView& address, uint64_t timetag, float value) {
+    size_t start = size_;
+    size_t sizeOffset = 0;
+    if (!beginMessage(address, "tf", sizeOffset) || !reserve(12)) {
+        size_ = start;
+        return false;
+    }
+    writeBigEndian64(buffer_ + size_, timetag);
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    writeBigEndian32(buffer_ + size_ + 8, bits);
+    size_ += 12;
+    endMessage(sizeOffset);
+    return true;
+}
+
+bool OSCWriter::addTimedString(const OSCAddressView& address, uint64_t timetag, const char* value) {
+    size_t start = size_;
+    size_t sizeOffset = 0;
+    size_t length = strlen(value);
+    size_t padded = (length + 4) & ~size_t(3);
+    if (!beginMessage(address, "ts", sizeOffset) || !reserve(8 + padded)) {
+        size_ = start;
+        return false;
+    }
+    writeBigEndian64(buffer_ + size_, timetag);
+    size_ += 8;
+    memcpy(buffer_ + size_, value, length);
+    memset(buffer_ + size_ + length, 0, padded - length);
+    size_ += padded;
+    endMessage(sizeOffset);
+    return true;
+}
+
+bool OSCWriter::addMessage(const OSCMessageHeader& header, const char* arguments, size_t size) {
+    if (!reserve((inBundle_ ? 4 : 0) + header.size() + size)) return false;
+    if (inBundle_) {
+        writeBigEndian32(buffer_ + size_, (uint32_t)(header.size() + size));
+        size_ += 4;
+    }
+    memcpy(buffer_ + size_, header.data(), header.size());
+    memcpy(buffer_ + size_ + header.size(), arguments, size);
+    size_ += header.size() + size;
+    return true;
+}
+
+OSCBundle::OSCBundle(OSCValueMode mode, uint64_t timetag)
+    : writer_(buffer_, capacity), mode_(mode), timetag_(timetag), started_(std::chrono::steady_clock::now()) {
+    writer_.beginBundle(timetag);
+}
+
+void OSCBundle::clear() {
+    writer_.reset();
+    writer_.beginBundle(timetag_);
+    count_ = 0;
+    started_ = std::chrono::steady_clock::now();
+}
+
+bool OSCBundle::addFloat(const OSCAddressView& address, float value, int precision) {
+    bool added;
+    if (mode_ == OSCValueMode::String) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f", precision, value);
+        added = writer_.addString(address, text);
+    } else {
+        added = writer_.addFloat(address, value);
+    }
+    if (added) ++count_;
+    return added;
+}
+
+bool OSCBundle::addInt(const OSCAddressView& address, int32_t value) {
+    bool added;
+    if (mode_ == OSCValueMode::String) {
+        char text[16];
+        snprintf(text, sizeof(text), "%d", (int)value);
+        added = writer_.addString(address, text);
+    } else {
+        added = writer_.addInt(address, value);
+    }
+    if (added) ++count_;
+    return added;
+}
+
+bool OSCBundle::addSample(const OSCAddressView& address, uint64_t timetag, float value, int precision) {
+    bool added;
+    if (mode_ == OSCValueMode::String) {
+        char text[32];
+        snprintf(text, sizeof(text), "%.*f", precision, value);
+        added = writer_.addTimedString(address, timetag, text);
+    } else {
+        added = writer_.addTimedFloat(address, timetag, value);
+    }
+    if (added) ++count_;
+    return added;
+}
+
+// The value as an OSC string argument, NUL-padded; returns its size
+static size_t writeTextArgument(char* out, const OSCMessageHeader& header, float value, int precision) {
+    const size_t maxLength = 47;
+    int length = header.argument() == OSCMessageHeader::Int ? snprintf(out, maxLength + 1, "%d", (int)value)
+                                                           : snprintf(out, maxLength + 1, "%.*f", precision, value);
+    size_t used = std::min((size_t)std::max(length, 0), maxLength);
+    size_t padded = (used + 4) & ~size_t(3);
+    memset(out + used, 0, padded - used);
+    return padded;
+}
+
+bool OSCBundle::add(const OSCMessageHeader& header, float value, int precision) {
+    char arguments[48];
+    size_t size = 4;
+    if (header.mode() == OSCValueMode::String) {
+        size = writeTextArgument(arguments, header, value, precision);
+    } else if (header.argument() == OSCMessageHeader::Int) {
+        writeBigEndian32(arguments, (uint32_t)(int32_t)value);
+    } else {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        writeBigEndian32(arguments, bits);
+    }
+    bool added = writer_.addMessage(header, arguments, size);
+    if (added) ++count_;
+    return added;
+}
+
+bool OSCBundle::addSample(const OSCMessageHeader& header, uint64_t timetag, float value, int precision) {
+    char arguments[8 + 48];
+    writeBigEndian64(arguments, timetag);
+    size_t size = 8 + 4;
+    if (header.mode() == OSCValueMode::String) {
+        size = 8 + writeTextArgument(arguments + 8, header, value, precision);
+    } else {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        writeBigEndian32(arguments + 8, bits);
+    }
+    bool added = writer_.addMessage(header, arguments, size);
+    if (added) ++count_;
+    return added;
+}
+
+bool OSCPattern::compile(const std::string& pattern) {
+    text_ = pattern;
+    tokens_.clear();
+    valid_ = false;
+
+    for (size_t i = 0; i < pattern.size();) {
+        char c = pattern[i];
+        Token token;
+        if (c == '?') {
+            token.kind = AnyChar;
+            ++i;
+        } else if (c == '/' && i + 1 < pattern.size() && pattern[i + 1] == '/') {
+            token.kind = AnyParts;
+            i += 2;
+        } else if (c == '*') {
+            token.kind = AnyRun;
+            while (i < pattern.size() && pattern[i] == '*') ++i;
+        } else if (c == '[') {
+            size_t close = pattern.find(']', i + 1);
+            if (close == std::string::npos) return false;
+            token.kind = CharSet;
+            size_t j = i + 1;
+            bool negate = j < close && pattern[j] == '!';
+            if (negate) ++j;
+            for (; j < close; ++j) {
+                // '-' between two characters is a range, elsewhere itself
+                if (j + 2 < close && pattern[j + 1] == '-') {
+                    for (int k = (unsigned char)pattern[j]; k <= (unsigned char)pattern[j + 2]; ++k) token.set.set(k);
+                    j += 2;
+                } else {
+                    token.set.set((unsigned char)pattern[j]);
+                }
+            }
+            if (negate) token.set.flip();
+            token.set.reset('/');
+            i = close + 1;
+        } else if (c == '{') {
+            size_t close = pattern.find('}', i + 1);
+            if (close == std::string::npos) return false;
+            token.kind = Choice;
+            size_t start = i + 1;
+            while (true) {
+                size_t comma = pattern.find(',', start);
+                if (comma == std::string::npos || comma > close) comma = close;
+                token.choices.push_back(pattern.substr(start, comma - start));
+                if (comma == close) break;
+                start = comma + 1;
+            }
+            i = close + 1;
+        } else if (c == ']' || c == '}') {
+            return false;
+        } else {
+            // Runs of plain characters become one literal
+            if (!tokens_.empty() && tokens_.back().kind == Literal) {
+                tokens_.back().literal += c;
+                ++i;
+                continue;
+            }
+            token.kind = Literal;
+            token.literal = c;
+            ++i;
+        }
+        tokens_.push_back(token);
+    }
+    valid_ = true;
+    return true;
+}
+
+bool OSCPattern::matches(const char* address, size_t length) const {
+    return valid_ && matchFrom(0, address, address + length);
+}
+
+bool OSCPattern::matchFrom(size_t t, const char* p, const char* end) const {
+    for (; t < tokens_.size(); ++t) {
+        const Token& token = tokens_[t];
+        switch (token.kind) {
+        case Literal:
+            if ((size_t)(end - p) < token.literal.size() ||
+                memcmp(p, token.literal.data(), token.literal.size()) != 0) {
+                return false;
+            }
+            p += token.literal.size();
+            break;
+        case AnyChar:
+            if (p == end || *p == '/') return false;
+            ++p;
+            break;
+        case CharSet:
+            if (p == end || !token.set[(unsigned char)*p]) return false;
+            ++p;
+            break;
+        case AnyRun:
+            // Up to the end of the current part at most
+            if (t + 1 == tokens_.size()) return memchr(p, '/', end - p) == nullptr;
+            for (const char* q = p;; ++q) {
+                if (matchFrom(t + 1, q, end)) return true;
+                if (q == end || *q == '/') return false;
+            }
+        case AnyParts:
+            // The '/' it stands for, then resume after any later '/' of the address
+            if (p == end || *p != '/') return false;
+            for (const char* q = p; q < end; ++q) {
+                if (*q == '/' && matchFrom(t + 1, q + 1, end)) return true;
+            }
+            return false;
+        case Choice:
+            for (const std::string& choice : token.choices) {
+                if ((size_t)(end - p) >= choice.size() && memcmp(p, choice.data(), choice.size()) == 0 &&
+                    matchFrom(t + 1, p + choice.size(), end)) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+    return p == end;
+}
+
+static uint32_t readBigEndian32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return ((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) | ((uint32_t)u[2] << 8) | u[3];
+}
+
+// Copies the bundle elements whose address matches into out (at least size
+// bytes). A lone message is copied whole or not at all. Returns the size
+// of the copy, 0 if nothing matched.
+static size_t filterDatagram(const char* data, size_t size, const OSCPattern& pattern, char* out) {
+    if (size < 16 || memcmp(data, "#bundle", 8) != 0) {
+        if (!pattern.matches(data, strnlen(data, size))) return 0;
+        memcpy(out, data, size);
+        return size;
+    }
+
+    memcpy(out, data, 16);
+    size_t copied = 16;
+    const char* element = data + 16;
+    const char* end = data + size;
+    while (end - element >= 4) {
+        size_t elementSize = readBigEndian32(element);
+        if (elementSize > (size_t)(end - element - 4)) break;
+        const char* address = element + 4;
+        if (pattern.matches(address, strnlen(address, elementSize))) {
+            memcpy(out + copied, element, 4 + elementSize);
+            copied += 4 + elementSize;
+        }
+        element += 4 + elementSize;
+    }
+    return copied > 16 ? copied : 0;
+}
+
+OSCSender::OSCSender() : table_(std::make_shared<Table>()) {
+    sockfd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd_ < 0) {
+        logError("osc") << "Socket creation failed: " << strerror(errno);
+    }
+}
+
+OSCSender::~OSCSender() {
+    if (sockfd_ >= 0) {
+        close(sockfd_);
+    }
+}
+
+bool OSCSender::addDestination(const std::string& ip, int port, const std::string& filter) {
+    Subscription subscription = {};
+    subscription.address.sin_family = AF_INET;
+    subscription.address.sin_port = htons(port);
+    if (inet_pton(AF_INET, ip.c_str(), &subscription.address.sin_addr) <= 0) {
+        logError("osc") << "Invalid address: " << ip;
+        return false;
+    }
+    OSCPattern pattern;
+    if (!filter.empty() && !pattern.compile(filter)) {
+        logError("osc") << "Invalid address pattern: " << filter;
+        return false;
+    }
+    subscription.filter = filter;
+    subscription.fixed = true;
+
+    std::lock_guard<std::mutex> lock(updateMutex_);
+    subscriptions_.push_back(subscription);
+    publish();
+    return true;
+}
+
+static bool sameEndpoint(const sockaddr_in& a, const sockaddr_in& b) {
+    return a.sin_addr.s_addr == b.sin_addr.s_addr && a.sin_port == b.sin_port;
+}
+
+bool OSCSender::subscribe(const sockaddr_in& address, const std::string& filter, std::chrono::seconds lease,
+                          std::string& error) {
+    OSCPattern pattern;
+    if (!filter.empty() && !pattern.compile(filter)) {
+        error = "invalid address pattern " + filter;
+        return false;
+    }
+    auto expires = std::chrono::steady_clock::now() + lease;
+
+    std::lock_guard<std::mutex> lock(updateMutex_);
+    size_t leased = 0;
+    for (Subscription& s : subscriptions_) {
+        if (s.fixed) continue;
+        if (sameEndpoint(s.address, address)) {
+            bool changed = s.filter != filter;
+            s.filter = filter;
+            s.expires = expires;
+            if (changed) publish();
+            return true;
+        }
+        ++leased;
+    }
+    if (leased >= maxSubscriptions) {
+        error = "too many subscribers";
+        return false;
+    }
+
+    Subscription subscription = {};
+    subscription.address = address;
+    subscription.filter = filter;
+    subscription.fixed = false;
+    subscription.expires = expires;
+    subscriptions_.push_back(subscription);
+    publish();
+    return true;
+}
+
+bool OSCSender::unsubscribe(const sockaddr_in& address) {
+    std::lock_guard<std::mutex> lock(updateMutex_);
+    for (size_t i = 0; i < subscriptions_.size(); ++i) {
+        if (!subscriptions_[i].fixed && sameEndpoint(subscriptions_[i].address, address)) {
+            subscriptions_.erase(subscriptions_.begin() + i);
+            publish();
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t OSCSender::expireSubscriptions() {
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(updateMutex_);
+    size_t before = subscriptions_.size();
+    subscriptions_.erase(std::remove_if(subscriptions_.begin(), subscriptions_.end(),
+                                        [now](const Subscription& s) { return !s.fixed && s.expires <= now; }),
+                         subscriptions_.end());
+    size_t expired = before - subscriptions_.size();
+    if (expired) publish();
+    return expired;
+}
+
+void OSCSender::publish() {
+    std::shared_ptr<Table> table = std::make_shared<Table>();
+    for (const Subscription& s : subscriptions_) {
+        Destination destination;
+        destination.address = s.address;
+        destination.filter = -1;
+        if (!s.filter.empty()) {
+            size_t f = 0;
+            while (f < table->filters.size() && table->filters[f].text() != s.filter) ++f;
+            if (f == table->filters.size()) {
+                table->filters.push_back(OSCPattern());
+                table->filters.back().compile(s.filter);
+            }
+            destination.filter = (int)f;
+        }
+        table->destinations.push_back(destination);
+    }
+    std::atomic_store(&table_, std::shared_ptr<const Table>(table));
+}
+
+size_t OSCSender::destinationCount() const {
+    return std::atomic_load(&table_)->destinations.size();
+}
+
+bool OSCSender::setMulticastTtl(int ttl) {
+    unsigned char value = (unsigned char)std::min(255, std::max(1, ttl));
+    if (setsockopt(sockfd_, IPPROTO_IP, IP_MULTICAST_TTL, &value, sizeof(value)) != 0) {
+        logError("osc") << "Cannot set multicast TTL: " << strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+int OSCSender::send(const OSCBundle& bundle) {
+    if (bundle.empty()) return 0;
+    auto now = std::chrono::steady_clock::now();
+    encodeTime_.record(std::chrono::duration_cast<std::chrono::microseconds>(now - bundle.started()));
+    return send(bundle.data(), bundle.size());
+}
+
+int OSCSender::send(const char* data, size_t size) {
+    if (sockfd_ < 0 || size == 0) {
+        return 0;
+    }
+    std::shared_ptr<const Table> table = std::atomic_load(&table_);
+    if (table->destinations.empty()) {
+        return 0;
+    }
+    StageTimer timer(sendTime_);
+
+    // One filtered copy per distinct filter, not per destination. Sends
+    // come from several threads, so the scratch space is per thread.
+    static thread_local std::vector<std::vector<char>> filtered;
+    static thread_local std::vector<size_t> filteredSize;
+    if (filtered.size() < table->filters.size()) filtered.resize(table->filters.size());
+    filteredSize.assign(table->filters.size(), 0);
+    for (size_t f = 0; f < table->filters.size(); ++f) {
+        if (filtered[f].size() < size) filtered[f].resize(size);
+        filteredSize[f] = filterDatagram(data, size, table->filters[f], filtered[f].data());
+    }
+
+    // What each destination gets; empty means its filter matched nothing
+    static thread_local std::vector<iovec> payloads;
+    static thread_local std::vector<const sockaddr_in*> addresses;
+    payloads.clear();
+    addresses.clear();
+    for (const Destination& d : table->destinations) {
+        iovec iov;
+        iov.iov_base = const_cast<char*>(d.filter < 0 ? data : filtered[d.filter].data());
+        iov.iov_len = d.filter < 0 ? size : filteredSize[d.filter];
+        if (iov.iov_len == 0) continue;
+        payloads.push_back(iov);
+        addresses.push_back(&d.address);
+    }
+
+#ifdef __linux__
+    static thread_local std::vector<mmsghdr> messages;
+    messages.assign(payloads.size(), mmsghdr());
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        msghdr& hdr = messages[i].msg_hdr;
+        hdr.msg_name = const_cast<sockaddr_in*>(addresses[i]);
+        hdr.msg_namelen = sizeof(sockaddr_in);
+        hdr.msg_iov = &payloads[i];
+        hdr.msg_iovlen = 1;
+    }
+
+    // The kernel takes at most UIO_MAXIOV messages per call; the loop
+    // picks up where a short call stopped
+    int sent = 0;
+    while (sent < (int)messages.size()) {
+        int n = sendmmsg(sockfd_, messages.data() + sent, messages.size() - sent, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            logError("osc") << "sendmmsg failed: " << strerror(errno);
+            failures_.fetch_add(1, std::memory_order_relaxed);
+            // Skip the destination that failed and carry on with the rest
+            ++sent;
+            continue;
+        }
+        sent += n;
+    }
+    int delivered = 0;
+    for (size_t i = 0; i < messages.size(); ++i) {
+        if (messages[i].msg_len == payloads[i].iov_len) ++delivered;
+    }
+    datagrams_.fetch_add(delivered, std::memory_order_relaxed);
+    return delivered;
+#else
+    // No sendmmsg() on macOS: one sendto() per destination
+    int delivered = 0;
+    for (size_t i = 0; i < payloads.size(); ++i) {
+        ssize_t n = sendto(sockfd_, payloads[i].iov_base, payloads[i].iov_len, 0,
+                           (const sockaddr*)addresses[i], sizeof(sockaddr_in));
+        if (n < 0) {
+            logError("osc") << "sendto failed: " << strerror(errno);
+            failures_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            ++delivered;
+        }
+    }
+    datagrams_.fetch_add(delivered, std::memory_order_relaxed);
+    return delivered;
+#endif
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <string>
+#include <vector>
+
+#include "metrics.h"
+
+// OSC/NTP timetag for the current wall-clock time
+uint64_t oscTimetagNow();
+uint64_t oscTimetagFromUnix(int64_t seconds);
+
+// How numeric values go on the wire: native OSC arguments (f/i/d/t),
+// or text with a ",s" tag for receivers that still parse strings
+enum class OSCValueMode { Typed, String };
+
+// Address pattern with its NUL padding already laid out, so sending
+// only copies bytes. Build with oscAddress("/dens") in a constexpr.
+template <size_t N>
+struct OSCAddress {
+    // N counts the terminating NUL of the literal
+    static constexpr size_t paddedSize = (N + 3) & ~size_t(3);
+    char bytes[paddedSize];
+
+    constexpr OSCAddress(const char (&path)[N]) : bytes() {
+        for (size_t i = 0; i + 1 < N; ++i) {
+            bytes[i] = path[i];
+        }
+    }
+};
+
+template <size_t N>
+constexpr OSCAddress<N> oscAddress(const char (&path)[N]) {
+    return OSCAddress<N>(path);
+}
+
+// Type-erased view of a padded address
+struct OSCAddressView {
+    const char* bytes;
+    size_t size;
+
+    template <size_t N>
+    constexpr OSCAddressView(const OSCAddress<N>& address)
+        : bytes(address.bytes), size(OSCAddress<N>::paddedSize) {}
+    constexpr OSCAddressView(const char* paddedBytes, size_t paddedSize)
+        : bytes(paddedBytes), size(paddedSize) {}
+};
+
+// Address and type tag of one kind of message, laid out once (at startup,
+// e.g. per schema field) for one value mode, so adding the message later
+// only copies these bytes and the encoded argument
+class OSCMessageHeader {
+public:
+    enum Argument { Float, Int, Sample };
+
+    OSCMessageHeader() = default;
+    OSCMessageHeader(const OSCAddressView& address, Argument argument, OSCValueMode mode);
+
+    Argument argument() const { return argument_; }
+    OSCValueMode mode() const { return mode_; }
+    const char* data() const { return bytes_.data(); }
+    size_t size() const { return bytes_.size(); }
+    bool empty() const { return bytes_.empty(); }
+
+private:
+    std::string bytes_;
+    Argument argument_ = Float;
+    OSCValueMode mode_ = OSCValueMode::Typed;
+};
+
+// Encodes OSC messages and bundles straight into a caller-provided buffer.
+// Never allocates; if the buffer runs out the writer stops and reports overflow.
+class OSCWriter {
+public:
+    OSCWriter(char* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity) {}
+
+    // Starts a #bundle; every message added afterwards becomes a bundle element
+    bool beginBundle(uint64_t timetag);
+
+    bool addFloat(const OSCAddressView& address, float value);
+    bool addInt(const OSCAddressView& address, int32_t value);
+    bool addDouble(const OSCAddressView& address, double value);
+    bool addTimetag(const OSCAddressView& address, uint64_t timetag);
+    bool addString(const OSCAddressView& address, const char* value);
+
+    // Sample with its own time: ",tf" / ",ts"
+    bool addTimedFloat(const OSCAddressView& address, uint64_t timetag, float value);
+    bool addTimedString(const OSCAddressView& address, uint64_t timetag, const char* value);
+
+    // Pre-encoded header followed by its already encoded, padded arguments
+    bool addMessage(const OSCMessageHeader& header, const char* arguments, size_t size);
+
+    void reset() { size_ = 0; inBundle_ = false; overflow_ = false; }
+
+    const char* data() const { return buffer_; }
+    size_t size() const { return size_; }
+    bool overflowed() const { return overflow_; }
+
+private:
+    // Writes address + type tag and returns the offset of the element size
+    // field (bundle mode) so it can be patched once the argument is in
+    bool beginMessage(const OSCAddressView& address, const char* types, size_t& sizeOffset);
+    void endMessage(size_t sizeOffset);
+    bool reserve(size_t bytes);
+
+    char* buffer_;
+    size_t capacity_;
+    size_t size_ = 0;
+    bool inBundle_ = false;
+    bool overflow_ = false;
+};
+
+// All values of one update packed into a single OSC #bundle,
+// so receivers see them together as one consistent snapshot
+class OSCBundle {
+public:
+    // One Ethernet MTU worth of UDP payload
+    static const size_t capacity = 1472;
+
+    explicit OSCBundle(OSCValueMode mode = OSCValueMode::Typed, uint64_t timetag = oscTimetagNow());
+
+    OSCBundle(const OSCBundle&) = delete;
+    OSCBundle& operator=(const OSCBundle&) = delete;
+
+    // precision is only used in string mode.
+    // Return false once the bundle is full; send it and clear() to go on.
+    bool addFloat(const OSCAddressView& address, float value, int precision);
+    bool addInt(const OSCAddressView& address, int32_t value);
+    bool addSample(const OSCAddressView& address, uint64_t timetag, float value, int precision);
+
+    // The same through a pre-encoded header built for this bundle's mode:
+    // a Float or Int header takes add(), a Sample header addSample()
+    bool add(const OSCMessageHeader& header, float value, int precision);
+    bool addSample(const OSCMessageHeader& header, uint64_t timetag, float value, int precision);
+
+    // Empties the bundle, keeping its mode and timetag
+    void clear();
+
+    bool empty() const { return count_ == 0; }
+    size_t count() const { return count_; }
+    const char* data() const { return writer_.data(); }
+    size_t size() const { return writer_.size(); }
+    // When encoding began (construction or the last clear())
+    std::chrono::steady_clock::time_point started() const { return started_; }
+
+private:
+    char buffer_[capacity];
+    OSCWriter writer_;
+    OSCValueMode mode_;
+    uint64_t timetag_;
+    size_t count_ = 0;
+    std::chrono::steady_clock::time_point started_;
+};
+
+// OSC 1.0 address pattern, compiled once and matched without allocating.
+// Matching is per address part, so no wildcard crosses a '/': ? any
+// character, * any run of characters, [a-z] and [!a-z] character sets,
+// {dens,speed} alternatives. // (from OSC 1.1) stands for any number of
+// whole parts: /derived//mean matches /derived/pdyn/60m/mean.
+class OSCPattern {
+public:
+    // Returns false for a malformed pattern, which then matches nothing
+    bool compile(const std::string& pattern);
+    bool matches(const char* address, size_t length) const;
+
+    const std::string& text() const { return text_; }
+
+private:
+    enum Kind { Literal, AnyChar, AnyRun, AnyParts, CharSet, Choice };
+    struct Token {
+        Kind kind;
+        std::string literal;
+        std::bitset<256> set;
+        std::vector<std::string> choices;
+    };
+
+    bool matchFrom(size_t token, const char* p, const char* end) const;
+
+    std::string text_;
+    std::vector<Token> tokens_;
+    bool valid_ = false;
+};
+
+// UDP transport that keeps one socket open and resolves destinations once.
+// A bundle is encoded once and goes out to every destination in a single
+// sendmmsg() call. Destinations with an address filter get a copy holding
+// only the matching bundle elements, made once per distinct filter.
+//
+// Destinations are either fixed (added at startup) or leased subscriptions
+// that expire unless renewed. The table is copied on change and swapped in
+// atomically, so sends never wait for a subscription being added.
+class OSCSender {
+public:
+    // Leased subscriptions at most; fixed destinations are not counted
+    static const size_t maxSubscriptions = 1024;
+
+    OSCSender();
+    ~OSCSender();
+
+    OSCSender(const OSCSender&) = delete;
+    OSCSender& operator=(const OSCSender&) = delete;
+
+    // Fixed destination; a multicast group works like any other address.
+    // An empty filter passes everything.
+    bool addDestination(const std::string& ip, int port, const std::string& filter = "");
+
+    // Adds or renews a subscription, replacing its filter. Returns false
+    // with a reason if the filter is malformed or the table is full.
+    bool subscribe(const sockaddr_in& address, const std::string& filter, std::chrono::seconds lease,
+                   std::string& error);
+    // Returns false if there was no such subscription
+    bool unsubscribe(const sockaddr_in& address);
+    // Drops lapsed subscriptions; returns how many
+    size_t expireSubscriptions();
+
+    // Hops for multicast datagrams (kernel default 1: local network only)
+    bool setMulticastTtl(int ttl);
+
+    // Returns the number of destinations the packet reached
+    int send(const char* data, size_t size);
+    // Also records how long the bundle took to build
+    int send(const OSCBundle& bundle);
+
+    size_t destinationCount() const;
+    // Datagrams handed to the kernel so far, over all destinations
+    uint64_t datagramsSent() const { return datagrams_.load(std::memory_order_relaxed); }
+    uint64_t sendFailures() const { return failures_.load(std::memory_order_relaxed); }
+    const LatencyHistogram& encodeTime() const { return encodeTime_; }
+    const LatencyHistogram& sendTime() const { return sendTime_; }
+
+private:
+    struct Subscription {
+        sockaddr_in address;
+        std::string filter;
+        bool fixed;
+        std::chrono::steady_clock::time_point expires;
+    };
+    struct Destination {
+        sockaddr_in address;
+        int filter;  // index into filters, -1 for everything
+    };
+    struct Table {
+        std::vector<Destination> destinations;
+        std::vector<OSCPattern> filters;  // one per distinct pattern
+    };
+
+    // Rebuilds the table from subscriptions_; call with updateMutex_ held
+    void publish();
+
+    int sockfd_;
+    std::mutex updateMutex_;
+    std::vector<Subscription> subscriptions_;
+    std::shared_ptr<const Table> table_;  // std::atomic_load/atomic_store only
+    std::atomic<uint64_t> datagrams_{0};
+    std::atomic<uint64_t> failures_{0};
+    LatencyHistogram encodeTime_;
+    LatencyHistogram sendTime_;
+};
@@ -0,0 +1,234 @@
+#include "osc_control.h"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <vector>
+
+#include "logger.h"
+
+constexpr auto subscribedAddress = oscAddress("/subscribed");
+constexpr auto unsubscribedAddress = oscAddress("/unsubscribed");
+constexpr auto errorAddress = oscAddress("/error");
+
+static uint32_t readBigEndian32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return ((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) | ((uint32_t)u[2] << 8) | u[3];
+}
+
+// Length of a padded OSC string starting at p, 0 if it runs past end
+static size_t paddedLength(const char* p, const char* end) {
+    const void* nul = memchr(p, '\0', end - p);
+    if (!nul) return 0;
+    size_t length = (const char*)nul - p + 1;
+    length = (length + 3) & ~size_t(3);
+    return p + length <= end ? length : 0;
+}
+
+// One request argument. Numbers may come as i, f or s: string-only clients
+// send "6000".
+struct ControlArgument {
+    bool isString;
+    std::string text;
+    int32_t number;
+};
+
+static bool readArguments(const char* tags, const char* args, const char* end, std::vector<ControlArgument>& out) {
+    for (const char* t = tags + 1; *t; ++t) {
+        ControlArgument argument = {};
+        if (*t == 's') {
+            size_t length = paddedLength(args, end);
+            if (!length) return false;
+            argument.isString = true;
+            argument.text = args;
+            argument.number = std::atoi(args);
+            args += length;
+        } else if (*t == 'i' || *t == 'f') {
+            if (end - args < 4) return false;
+            uint32_t bits = readBigEndian32(args);
+            if (*t == 'i') {
+                argument.number = (int32_t)bits;
+            } else {
+                float value;
+                memcpy(&value, &bits, sizeof(value));
+                // Converting NaN or an out-of-range float is undefined
+                if (!(value > -2147483648.0f && value < 2147483648.0f)) return false;
+                argument.number = (int32_t)value;
+            }
+            args += 4;
+        } else {
+            return false;
+        }
+        out.push_back(argument);
+    }
+    return true;
+}
+
+OSCControlServer::OSCControlServer(OSCSender& sender, std::chrono::seconds lease)
+    : sender_(sender), lease_(lease) {}
+
+OSCControlServer::~OSCControlServer() {
+    stop();
+    if (fd_ >= 0) close(fd_);
+}
+
+bool OSCControlServer::open(int port, const std::string& bindHost) {
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons((uint16_t)port);
+    if (!bindHost.empty() && inet_pton(AF_INET, bindHost.c_str(), &addr.sin_addr) != 1) {
+        error_ = "invalid bind address " + bindHost + " (IPv4 address expected)";
+        return false;
+    }
+    fd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd_ < 0) {
+        error_ = std::string("socket: ") + strerror(errno);
+        return false;
+    }
+    if (bind(fd_, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        error_ = (bindHost.empty() ? "port " : bindHost + ":") + std::to_string(port) + ": " + strerror(errno);
+        close(fd_);
+        fd_ = -1;
+        return false;
+    }
+    return true;
+}
+
+bool OSCControlServer::allowHost(const std::string& host) {
+    in_addr address;
+    if (inet_pton(AF_INET, host.c_str(), &address) != 1) return false;
+    allowedHosts_.push_back(address.s_addr);
+    return true;
+}
+
+void OSCControlServer::start() {
+    stopping_ = false;
+    thread_ = std::thread(&OSCControlServer::run, this);
+}
+
+void OSCControlServer::stop() {
+    if (!thread_.joinable()) return;
+    stopping_ = true;
+    thread_.join();
+}
+
+void OSCControlServer::run() {
+    char buffer[2048];
+    auto nextExpiry = std::chrono::steady_clock::now();
+    while (!stopping_) {
+        // Short timeout so stop() and lapsed leases are noticed
+        pollfd p = {fd_, POLLIN, 0};
+        if (poll(&p, 1, 200) > 0) {
+            sockaddr_in from = {};
+            socklen_t fromLength = sizeof(from);
+            ssize_t n = recvfrom(fd_, buffer, sizeof(buffer), 0, (sockaddr*)&from, &fromLength);
+            if (n > 0) handle(buffer, (size_t)n, from);
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextExpiry) {
+            size_t expired = sender_.expireSubscriptions();
+            if (expired) logInfo("osc") << "OSC: " << expired << " subscription(s) expired";
+            nextExpiry = now + std::chrono::seconds(1);
+        }
+    }
+}
+
+void OSCControlServer::handle(const char* data, size_t size, const sockaddr_in& from) {
+    if (size < 16 || memcmp(data, "#bundle", 8) != 0) {
+        handleMessage(data, size, from);
+        return;
+    }
+    const char* element = data + 16;
+    const char* end = data + size;
+    while (end - element >= 4) {
+        size_t elementSize = readBigEndian32(element);
+        if (elementSize > (size_t)(end - element - 4)) break;
+        handleMessage(element + 4, elementSize, from);
+        element += 4 + elementSize;
+    }
+}
+
+void OSCControlServer::handleMessage(const char* message, size_t size, const sockaddr_in& from) {
+    const char* end = message + size;
+    size_t addressLength = paddedLength(message, end);
+    const char* tags = message + addressLength;
+    size_t tagsLength = addressLength ? paddedLength(tags, end) : 0;
+    std::vector<ControlArgument> args;
+    if (!tagsLength || tags[0] != ',' || !readArguments(tags, tags + tagsLength, end, args)) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    std::string path = message;
+    bool subscribing = path == "/subscribe";
+    if (!subscribing && path != "/unsubscribe") {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        replyError(from, "unknown request " + path);
+        return;
+    }
+    requests_.fetch_add(1, std::memory_order_relaxed);
+
+    // [host] port [pattern]
+    sockaddr_in target = {};
+    target.sin_family = AF_INET;
+    target.sin_addr = from.sin_addr;
+    size_t next = 0;
+    if (!args.empty() && args[0].isString && args[0].text.find_first_not_of("0123456789") != std::string::npos) {
+        if (inet_pton(AF_INET, args[0].text.c_str(), &target.sin_addr) != 1) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            replyError(from, "invalid host " + args[0].text + " (IPv4 address expected)");
+            return;
+        }
+        next = 1;
+    } else if (!args.empty() && args[0].isString && args[0].text.empty()) {
+        next = 1;
+    }
+    if (target.sin_addr.s_addr != from.sin_addr.s_addr &&
+        std::find(allowedHosts_.begin(), allowedHosts_.end(), target.sin_addr.s_addr) == allowedHosts_.end()) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        replyError(from, "host " + args[0].text + " not allowed: only the sender's own address");
+        return;
+    }
+    if (next >= args.size() || args[next].number <= 0 || args[next].number > 65535) {
+        rejected_.fetch_add(1, std::memory_order_relaxed);
+        replyError(from, path + ": expected [host] port" + (subscribing ? " [pattern]" : ""));
+        return;
+    }
+    int port = args[next].number;
+    target.sin_port = htons((uint16_t)port);
+    std::string filter = subscribing && next + 1 < args.size() ? args[next + 1].text : "";
+
+    if (subscribing) {
+        std::string reason;
+        if (!sender_.subscribe(target, filter, lease_, reason)) {
+            rejected_.fetch_add(1, std::memory_order_relaxed);
+            replyError(from, reason);
+            return;
+        }
+        reply(from, subscribedAddress, (int32_t)lease_.count());
+    } else {
+        sender_.unsubscribe(target);
+        reply(from, unsubscribedAddress, port);
+    }
+}
+
+void OSCControlServer::reply(const sockaddr_in& to, const OSCAddressView& address, int32_t value) {
+    char buffer[64];
+    OSCWriter writer(buffer, sizeof(buffer));
+    writer.addInt(address, value);
+    sendto(fd_, writer.data(), writer.size(), 0, (const sockaddr*)&to, sizeof(to));
+}
+
+void OSCControlServer::replyError(const sockaddr_in& to, const std::string& reason) {
+    char buffer[512];
+    OSCWriter writer(buffer, sizeof(buffer));
+    if (writer.addString(errorAddress, reason.substr(0, 256).c_str())) {
+        sendto(fd_, writer.data(), writer.size(), 0, (const sockaddr*)&to, sizeof(to));
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <netinet/in.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "osc.h"
+
+// Lets receivers subscribe themselves over OSC instead of being compiled in.
+// Requests arrive on a UDP port:
+//
+//   /subscribe [host] port [pattern]   renew within the lease or it lapses
+//   /unsubscribe [host] port
+//
+// host defaults to the address the request came from; pattern is an OSC
+// address pattern such as /{dens,speed,temp} or /metrics/*, and only the
+// matching values are sent. Each request is answered to its sender with
+// /subscribed <lease seconds>, /unsubscribed <port> or /error <reason>.
+//
+// Requests are not authenticated, so by default a sender can only subscribe
+// itself: any other host must be on the allow-list, or anyone could point
+// the whole stream at a third party.
+class OSCControlServer {
+public:
+    OSCControlServer(OSCSender& sender, std::chrono::seconds lease);
+    ~OSCControlServer();
+
+    OSCControlServer(const OSCControlServer&) = delete;
+    OSCControlServer& operator=(const OSCControlServer&) = delete;
+
+    // Binds all interfaces unless bindHost (an IPv4 address) says otherwise:
+    // the receivers are usually other machines
+    bool open(int port, const std::string& bindHost = "");
+    // Lets requests subscribe this IPv4 address on behalf of another sender;
+    // false if host is not an address. Call before start().
+    bool allowHost(const std::string& host);
+    void start();
+    void stop();
+
+    const std::string& error() const { return error_; }
+    uint64_t requests() const { return requests_.load(std::memory_order_relaxed); }
+    uint64_t rejected() const { return rejected_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void handle(const char* data, size_t size, const sockaddr_in& from);
+    void handleMessage(const char* message, size_t size, const sockaddr_in& from);
+    void reply(const sockaddr_in& to, const OSCAddressView& address, int32_t value);
+    void replyError(const sockaddr_in& to, const std::string& reason);
+
+    OSCSender& sender_;
+    std::chrono::seconds lease_;
+    std::vector<in_addr_t> allowedHosts_;
+    int fd_ = -1;
+    std::string error_;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+    std::atomic<uint64_t> requests_{0};
+    std::atomic<uint64_t> rejected_{0};
+};
@@ -0,0 +1,189 @@
+#include "osc_sink.h"
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+static const size_t datagramCapacity = 2048;  // bundles are one MTU at most
+
+int64_t oscTimetagToMicros(uint64_t timetag) {
+    const int64_t ntpUnixOffset = 2208988800LL;
+    int64_t seconds = (int64_t)(timetag >> 32) - ntpUnixOffset;
+    int64_t micros = (int64_t)(((timetag & 0xffffffffULL) * 1000000) >> 32);
+    return seconds * 1000000 + micros;
+}
+
+static uint32_t readBigEndian32(const char* p) {
+    const unsigned char* u = reinterpret_cast<const unsigned char*>(p);
+    return ((uint32_t)u[0] << 24) | ((uint32_t)u[1] << 16) | ((uint32_t)u[2] << 8) | u[3];
+}
+
+static uint64_t readBigEndian64(const char* p) {
+    return ((uint64_t)readBigEndian32(p) << 32) | readBigEndian32(p + 4);
+}
+
+// Length of a padded OSC string starting at p, 0 if it runs past end
+static size_t paddedLength(const char* p, const char* end) {
+    const void* nul = memchr(p, '\0', end - p);
+    if (!nul) return 0;
+    size_t length = (const char*)nul - p + 1;
+    length = (length + 3) & ~size_t(3);
+    return p + length <= end ? length : 0;
+}
+
+static int64_t clockMicros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+OSCSink::OSCSink() {}
+
+OSCSink::~OSCSink() {
+    stop();
+    for (int fd : fds_) close(fd);
+}
+
+bool OSCSink::open(size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (fd < 0) {
+            error_ = std::string("socket: ") + strerror(errno);
+            return false;
+        }
+        fds_.push_back(fd);
+
+        // Room for bursts while the sink thread is busy
+        int buffer = 4 * 1024 * 1024;
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buffer, sizeof(buffer));
+        int yes = 1;
+        setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &yes, sizeof(yes));
+
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || getsockname(fd, (sockaddr*)&addr, &len) != 0) {
+            error_ = std::string("bind: ") + strerror(errno);
+            return false;
+        }
+        ports_.push_back(ntohs(addr.sin_port));
+    }
+    return true;
+}
+
+void OSCSink::start(SampleHandler handler) {
+    handler_ = handler;
+    stopping_ = false;
+    thread_ = std::thread(&OSCSink::run, this);
+}
+
+void OSCSink::stop() {
+    if (!thread_.joinable()) return;
+    stopping_ = true;
+    thread_.join();
+}
+
+void OSCSink::run() {
+    std::vector<pollfd> fds(fds_.size());
+    for (size_t i = 0; i < fds_.size(); ++i) {
+        fds[i].fd = fds_[i];
+        fds[i].events = POLLIN;
+    }
+    while (!stopping_) {
+        // Short timeout so stop() is noticed
+        int ready = poll(fds.data(), fds.size(), 50);
+        if (ready <= 0) continue;
+        for (size_t i = 0; i < fds.size(); ++i) {
+            if (fds[i].revents & POLLIN) drain(i);
+        }
+    }
+    // Whatever is still queued counts as delivered
+    for (size_t i = 0; i < fds_.size(); ++i) drain(i);
+}
+
+// Reads everything queued on one port. recvmsg() rather than recvmmsg()
+// so the receive timestamp also works on macOS.
+void OSCSink::drain(size_t destination) {
+    char buffer[datagramCapacity];
+    char control[CMSG_SPACE(sizeof(timeval))];
+
+    while (true) {
+        iovec iov;
+        iov.iov_base = buffer;
+        iov.iov_len = sizeof(buffer);
+        msghdr hdr;
+        memset(&hdr, 0, sizeof(hdr));
+        hdr.msg_iov = &iov;
+        hdr.msg_iovlen = 1;
+        hdr.msg_control = control;
+        hdr.msg_controllen = sizeof(control);
+
+        ssize_t n = recvmsg(fds_[destination], &hdr, MSG_DONTWAIT);
+        if (n < 0) return;
+
+        int64_t received = 0;
+        for (cmsghdr* c = CMSG_FIRSTHDR(&hdr); c; c = CMSG_NXTHDR(&hdr, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMP) {
+                timeval tv;
+                memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+                received = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+            }
+        }
+        if (received == 0) received = clockMicros();
+
+        datagrams_.fetch_add(1, std::memory_order_relaxed);
+        bytes_.fetch_add((uint64_t)n, std::memory_order_relaxed);
+        parse(destination, buffer, (size_t)n, received);
+    }
+}
+
+void OSCSink::parse(size_t destination, const char* data, size_t size, int64_t receivedMicros) {
+    const char* end = data + size;
+    uint64_t bundleTimetag = 0;
+
+    // A lone message is treated as a bundle of one
+    const char* element = data;
+    const char* elementEnd = end;
+    bool bundle = size >= 16 && memcmp(data, "#bundle", 8) == 0;
+    if (bundle) {
+        bundleTimetag = readBigEndian64(data + 8);
+        element = data + 16;
+    }
+
+    while (element < end) {
+        if (bundle) {
+            if (end - element < 4) break;
+            uint32_t elementSize = readBigEndian32(element);
+            element += 4;
+            if (elementSize > (size_t)(end - element)) break;
+            elementEnd = element + elementSize;
+        }
+
+        size_t addressLength = paddedLength(element, elementEnd);
+        const char* tags = element + addressLength;
+        size_t tagsLength = addressLength ? paddedLength(tags, elementEnd) : 0;
+        if (!tagsLength || tags[0] != ',') {
+            malformed_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        const char* args = tags + tagsLength;
+        if (tags[1] == 't' && args + 8 <= elementEnd && handler_) {
+            OSCSinkSample sample;
+            sample.destination = destination;
+            sample.address = element;
+            sample.sampleTimetag = readBigEndian64(args);
+            sample.bundleTimetag = bundleTimetag;
+            sample.receivedMicros = receivedMicros;
+            handler_(sample);
+        }
+
+        if (!bundle) break;
+        element = elementEnd;
+    }
+}
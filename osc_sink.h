@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// One timed sample (",tf" / ",ts" message) as it arrived at the sink
+struct OSCSinkSample {
+    size_t destination;        // index of the port it arrived on
+    const char* address;       // NUL-terminated, valid during the callback only
+    uint64_t sampleTimetag;    // the message's own time (NOAA time_tag)
+    uint64_t bundleTimetag;    // when the sender built the bundle, 0 outside a bundle
+    int64_t receivedMicros;    // kernel receive timestamp, Unix microseconds
+};
+
+// In-process OSC receiver for load tests: listens on several UDP ports of
+// 127.0.0.1 (one per simulated destination) on a single thread, timestamps
+// every datagram as the kernel received it and hands the timed samples of
+// each bundle to a callback.
+class OSCSink {
+public:
+    typedef std::function<void(const OSCSinkSample& sample)> SampleHandler;
+
+    OSCSink();
+    ~OSCSink();
+
+    OSCSink(const OSCSink&) = delete;
+    OSCSink& operator=(const OSCSink&) = delete;
+
+    // Binds `count` ephemeral ports; false (with error() set) on failure
+    bool open(size_t count);
+    const std::vector<int>& ports() const { return ports_; }
+    const std::string& error() const { return error_; }
+
+    // The handler runs on the sink thread
+    void start(SampleHandler handler);
+    void stop();
+
+    uint64_t datagrams() const { return datagrams_.load(std::memory_order_relaxed); }
+    uint64_t bytes() const { return bytes_.load(std::memory_order_relaxed); }
+    uint64_t malformed() const { return malformed_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    void drain(size_t destination);
+    void parse(size_t destination, const char* data, size_t size, int64_t receivedMicros);
+
+    std::vector<int> fds_;
+    std::vector<int> ports_;
+    std::string error_;
+    SampleHandler handler_;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+
+    std::atomic<uint64_t> datagrams_{0};
+    std::atomic<uint64_t> bytes_{0};
+    std::atomic<uint64_t> malformed_{0};
+};
+
+// OSC/NTP timetag -> Unix microseconds
+int64_t oscTimetagToMicros(uint64_t timetag);
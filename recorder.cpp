@@ -0,0 +1,160 @@
+#include "recorder.h"
+
+#include <cerrno>
+#include <cstring>
+
+static const char recordingMagic[8] = {'S', 'D', 'C', 'R', 'E', 'C', '0', '1'};
+static const uint8_t feedNameKind = 'F';
+static const uint32_t maxPayload = 64 * 1024 * 1024;  // sanity bound when reading
+
+#pragma pack(push, 1)
+struct RecordHeader {
+    uint8_t kind;
+    uint8_t feedId;
+    uint32_t size;
+    int64_t timeMillis;
+};
+#pragma pack(pop)
+
+FeedRecorder::FeedRecorder() {}
+
+FeedRecorder::~FeedRecorder() {
+    close();
+}
+
+bool FeedRecorder::open(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) return false;
+
+    file_ = fopen(path.c_str(), "ab");
+    if (!file_) return false;
+
+    // Feed ids are per file section: a reopened file starts a new section,
+    // announced by its own magic, and names its feeds again
+    if (fwrite(recordingMagic, sizeof(recordingMagic), 1, file_) != 1) {
+        fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    feedIds_.clear();
+    fflush(file_);
+    return true;
+}
+
+void FeedRecorder::close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) fclose(file_);
+    file_ = nullptr;
+}
+
+bool FeedRecorder::writeRecord(uint8_t kind, uint8_t feedId, int64_t timeMillis, const std::string& payload) {
+    RecordHeader header;
+    header.kind = kind;
+    header.feedId = feedId;
+    header.size = (uint32_t)payload.size();
+    header.timeMillis = timeMillis;
+    if (fwrite(&header, sizeof(header), 1, file_) != 1) return false;
+    if (!payload.empty() && fwrite(payload.data(), payload.size(), 1, file_) != 1) return false;
+    bytes_ += sizeof(header) + payload.size();
+    return true;
+}
+
+void FeedRecorder::record(const RecordedResponse& response) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) return;
+
+    auto it = feedIds_.find(response.feed);
+    if (it == feedIds_.end()) {
+        if (feedIds_.size() >= 255) return;
+        uint8_t id = (uint8_t)feedIds_.size();
+        it = feedIds_.emplace(response.feed, id).first;
+        writeRecord(feedNameKind, id, response.timeMillis, response.feed);
+    }
+    if (writeRecord(response.kind, it->second, response.timeMillis, response.body)) {
+        ++records_;
+    }
+    // A crash loses at most the record being written
+    fflush(file_);
+}
+
+uint64_t FeedRecorder::recordCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return records_;
+}
+
+uint64_t FeedRecorder::bytesWritten() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return bytes_;
+}
+
+RecordingReader::RecordingReader() {}
+
+RecordingReader::~RecordingReader() {
+    if (file_) fclose(file_);
+}
+
+bool RecordingReader::open(const std::string& path) {
+    file_ = fopen(path.c_str(), "rb");
+    if (!file_) {
+        error_ = "cannot open " + path + ": " + strerror(errno);
+        return false;
+    }
+    char magic[sizeof(recordingMagic)];
+    if (fread(magic, sizeof(magic), 1, file_) != 1 || memcmp(magic, recordingMagic, sizeof(magic)) != 0) {
+        error_ = path + " is not a solar-watcher recording";
+        return false;
+    }
+    return true;
+}
+
+bool RecordingReader::next(RecordedResponse& response) {
+    if (!file_) return false;
+
+    while (true) {
+        RecordHeader header;
+        size_t got = fread(&header, 1, sizeof(header), file_);
+        if (got == 0) return false;
+
+        // Start of a section appended by a later run
+        if (got >= sizeof(recordingMagic) && memcmp(&header, recordingMagic, sizeof(recordingMagic)) == 0) {
+            feedNames_.clear();
+            fseek(file_, (long)sizeof(recordingMagic) - (long)got, SEEK_CUR);
+            continue;
+        }
+        if (got < sizeof(header)) {
+            error_ = "truncated record at the end of the recording";
+            return false;
+        }
+
+        if (header.size > maxPayload) {
+            error_ = "corrupt record size";
+            return false;
+        }
+        std::string payload(header.size, '\0');
+        if (header.size > 0 && fread(&payload[0], header.size, 1, file_) != 1) {
+            error_ = "truncated record at the end of the recording";
+            return false;
+        }
+
+        if (header.kind == feedNameKind) {
+            if (feedNames_.size() <= header.feedId) feedNames_.resize(header.feedId + 1);
+            feedNames_[header.feedId] = payload;
+            continue;
+        }
+        if (header.kind != RecordedResponse::Body && header.kind != RecordedResponse::NotModified &&
+            header.kind != RecordedResponse::Failed) {
+            error_ = "unknown record kind";
+            return false;
+        }
+        if (header.feedId >= feedNames_.size()) {
+            error_ = "record for an unnamed feed";
+            return false;
+        }
+
+        response.kind = (RecordedResponse::Kind)header.kind;
+        response.feed = feedNames_[header.feedId];
+        response.timeMillis = header.timeMillis;
+        response.body.swap(payload);
+        return true;
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One raw feed response as it came off the wire
+struct RecordedResponse {
+    enum Kind : uint8_t {
+        Body = 'B',         // full response, body holds the JSON
+        NotModified = 'N',  // 304
+        Failed = 'E',       // transfer or HTTP error, body holds the reason
+    };
+
+    Kind kind = Body;
+    std::string feed;       // FeedDescriptor::name
+    int64_t timeMillis = 0; // Unix time the response arrived
+    std::string body;
+};
+
+// Appends raw responses to a compact binary file:
+//   "SDCREC01", then records of
+//   [kind u8][feed id u8][payload size u32][time ms i64][payload]
+// A record of kind 'F' names a feed id the first time it is used.
+// Integers are in host byte order. Safe to call from several threads.
+class FeedRecorder {
+public:
+    FeedRecorder();
+    ~FeedRecorder();
+
+    FeedRecorder(const FeedRecorder&) = delete;
+    FeedRecorder& operator=(const FeedRecorder&) = delete;
+
+    // Appends to an existing recording or starts a new one
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+
+    void record(const RecordedResponse& response);
+
+    uint64_t recordCount() const;
+    uint64_t bytesWritten() const;
+
+private:
+    bool writeRecord(uint8_t kind, uint8_t feedId, int64_t timeMillis, const std::string& payload);
+
+    mutable std::mutex mutex_;
+    FILE* file_ = nullptr;
+    std::map<std::string, uint8_t> feedIds_;
+    uint64_t records_ = 0;
+    uint64_t bytes_ = 0;
+};
+
+// Reads a recording back in file order
+class RecordingReader {
+public:
+    RecordingReader();
+    ~RecordingReader();
+
+    RecordingReader(const RecordingReader&) = delete;
+    RecordingReader& operator=(const RecordingReader&) = delete;
+
+    bool open(const std::string& path);
+    const std::string& error() const { return error_; }
+
+    // False at the end of the file; a truncated last record also ends it,
+    // with error() set
+    bool next(RecordedResponse& response);
+
+private:
+    FILE* file_ = nullptr;
+    std::string error_;
+    std::vector<std::string> feedNames_;
+};
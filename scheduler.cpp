@@ -0,0 +1,228 @@
+#include "scheduler.h"
+
+#include <algorithm>
+
+#include "logger.h"
+
+using Clock = std::chrono::steady_clock;
+
+// Consecutive failures before a feed's circuit opens
+static const unsigned breakerThreshold = 3;
+
+WorkerPool::WorkerPool(size_t threads) {
+    if (threads == 0) threads = 1;
+    for (size_t i = 0; i < threads; ++i) {
+        threads_.emplace_back(&WorkerPool::run, this);
+    }
+}
+
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    ready_.notify_all();
+    for (std::thread& t : threads_) t.join();
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(std::move(job));
+    }
+    ready_.notify_one();
+}
+
+void WorkerPool::run() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ready_.wait(lock, [this]() { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return;  // stopping and drained
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+        }
+        job();
+    }
+}
+
+FeedScheduler::FeedScheduler(FeedFetcher& fetcher, size_t workers)
+    : fetcher_(fetcher), random_(std::random_device()()), pool_(workers) {}
+
+FeedScheduler::~FeedScheduler() {}
+
+void FeedScheduler::addFeed(const FeedDescriptor& descriptor) {
+    Feed feed;
+    feed.descriptor = descriptor;
+    feed.delay = descriptor.interval;
+    // Everything is fetched once right at startup
+    feed.nextDue = Clock::now();
+    if (metrics_) {
+        FeedMetrics& m = feed.metrics;
+        std::string labels = "feed=\"" + descriptor.name + "\"";
+        const std::string requests = "solar_fetch_requests_total";
+        const std::string requestsHelp = "Responses by outcome";
+        m.ok = &metrics_->counter(requests, requestsHelp, labels + ",result=\"ok\"");
+        m.notModified = &metrics_->counter(requests, requestsHelp, labels + ",result=\"not_modified\"");
+        m.failed = &metrics_->counter(requests, requestsHelp, labels + ",result=\"error\"");
+        m.bytes = &metrics_->counter("solar_fetch_bytes_total", "Bytes downloaded, before decompression", labels);
+
+        const std::string fetch = "solar_fetch_seconds";
+        const std::string fetchHelp = "Request phases from curl: dns, connect, tls, wait (first byte), transfer, total";
+        m.dns = &metrics_->histogram(fetch, fetchHelp, labels + ",stage=\"dns\"");
+        m.connect = &metrics_->histogram(fetch, fetchHelp, labels + ",stage=\"connect\"");
+        m.tls = &metrics_->histogram(fetch, fetchHelp, labels + ",stage=\"tls\"");
+        m.wait = &metrics_->histogram(fetch, fetchHelp, labels + ",stage=\"wait\"");
+        m.transfer = &metrics_->histogram(fetch, fetchHelp, labels + ",stage=\"transfer\"");
+        m.total = &metrics_->histogram(fetch, fetchHelp, labels + ",stage=\"total\"");
+        m.process = &metrics_->histogram("solar_process_seconds",
+                                         "Parsing and publishing a full response (snapshot, history, derived "
+                                         "indices, shared memory), OSC sends excluded",
+                                         labels);
+    }
+    feeds_.push_back(feed);
+
+    fetcher_.addFeed(descriptor.url, [this](size_t index, FetchResult&& result) {
+        onFetched(index, std::move(result));
+    }, descriptor.timeout);
+}
+
+std::chrono::milliseconds FeedScheduler::currentInterval(size_t index) const {
+    return feeds_[index].delay;
+}
+
+std::chrono::milliseconds FeedScheduler::jittered(std::chrono::milliseconds delay, double jitter) {
+    if (jitter <= 0.0) return delay;
+    std::uniform_real_distribution<double> spread(-jitter, jitter);
+    return std::chrono::milliseconds((int64_t)(delay.count() * (1.0 + spread(random_))));
+}
+
+void FeedScheduler::onFetched(size_t index, FetchResult&& result) {
+    // Parsing and publishing happen off the fetch thread
+    pool_.submit([this, index, r = std::move(result)]() { handle(index, r); });
+}
+
+void FeedScheduler::handle(size_t index, const FetchResult& result) {
+    const FeedDescriptor& d = feeds_[index].descriptor;
+
+    Completion c;
+    c.index = index;
+    c.ok = result.ok();
+    c.advanced = false;
+    c.dropValidators = false;
+    c.maxAgeSeconds = result.maxAgeSeconds;
+
+    if (observer_) observer_(d, result);
+    const FeedMetrics& metrics = feeds_[index].metrics;
+    if (metrics.ok) recordFetch(metrics, result);
+
+    if (result.ok() && result.notModified) {
+        if (d.reuse && !d.reuse()) c.dropValidators = true;
+    } else if (result.ok()) {
+        auto start = Clock::now();
+        c.advanced = d.process ? d.process(result.body) : true;
+        if (metrics.process) {
+            metrics.process->record(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start));
+        }
+        if (d.send) d.send();
+    } else {
+        logWarning("scheduler") << "Failed to fetch " << d.name << " data. Using last valid values.";
+        if (d.fallback) d.fallback();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(completionsMutex_);
+        completions_.push_back(c);
+    }
+    fetcher_.wakeup();
+}
+
+void FeedScheduler::recordFetch(const FeedMetrics& metrics, const FetchResult& result) {
+    if (!result.ok()) {
+        metrics.failed->add();
+        return;
+    }
+    (result.notModified ? metrics.notModified : metrics.ok)->add();
+    const FetchTimings& t = result.timings;
+    metrics.bytes->add((uint64_t)t.bytes);
+    metrics.dns->recordMicros(t.dns);
+    metrics.connect->recordMicros(t.connect);
+    metrics.tls->recordMicros(t.tls);
+    metrics.wait->recordMicros(t.wait);
+    metrics.transfer->recordMicros(t.transfer);
+    metrics.total->recordMicros(t.total);
+}
+
+void FeedScheduler::reschedule(const Completion& c) {
+    Feed& feed = feeds_[c.index];
+    const FeedDescriptor& d = feed.descriptor;
+    auto interval = std::chrono::duration_cast<std::chrono::milliseconds>(d.interval);
+    auto maxInterval = std::chrono::duration_cast<std::chrono::milliseconds>(d.maxInterval);
+
+    if (c.dropValidators) fetcher_.invalidate(c.index);
+
+    if (!c.ok) {
+        // Failing endpoint: interval, 2x, 4x ... up to the back-off ceiling
+        ++feed.failures;
+        auto ceiling = std::chrono::duration_cast<std::chrono::milliseconds>(d.maxBackoff);
+        unsigned shift = std::min(feed.failures - 1, 16u);
+        feed.delay = std::min(ceiling, interval * (int64_t)(1u << shift));
+        if (feed.failures >= breakerThreshold && !feed.circuitOpen) {
+            feed.circuitOpen = true;
+            logError("scheduler") << "Circuit open for " << d.name << " after " << feed.failures
+                                  << " failures; backing off up to " << (long long)d.maxBackoff.count() << "s";
+        }
+    } else {
+        if (feed.circuitOpen) {
+            logInfo("scheduler") << "Circuit closed for " << d.name << ": endpoint is back";
+        }
+        feed.failures = 0;
+        feed.circuitOpen = false;
+
+        if (c.advanced) {
+            // New data: come back at the product's own cadence
+            feed.delay = interval;
+        } else {
+            // Nothing new: back off gradually up to the ceiling
+            feed.delay = std::min(maxInterval, std::chrono::milliseconds(feed.delay.count() * 3 / 2));
+        }
+        if (c.maxAgeSeconds > 0) {
+            // No point asking again before the server's cache expires
+            feed.delay = std::max(feed.delay, std::min(maxInterval, std::chrono::milliseconds(c.maxAgeSeconds * 1000)));
+        }
+    }
+
+    feed.nextDue = Clock::now() + jittered(feed.delay, d.jitter);
+    feed.busy = false;
+}
+
+void FeedScheduler::runUntil(Clock::time_point deadline, const std::function<bool()>& keepRunning) {
+    std::vector<Completion> done;
+    while (keepRunning()) {
+        {
+            std::lock_guard<std::mutex> lock(completionsMutex_);
+            done.swap(completions_);
+        }
+        for (const Completion& c : done) reschedule(c);
+        done.clear();
+
+        Clock::time_point now = Clock::now();
+        if (now >= deadline) break;
+
+        Clock::time_point wakeAt = std::min(deadline, now + std::chrono::seconds(1));
+        for (size_t i = 0; i < feeds_.size(); ++i) {
+            Feed& feed = feeds_[i];
+            if (feed.busy) continue;
+            if (feed.nextDue <= now) {
+                feed.busy = true;
+                fetcher_.start(i);
+            } else {
+                wakeAt = std::min(wakeAt, feed.nextDue);
+            }
+        }
+
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(wakeAt - Clock::now());
+        fetcher_.poll((int)std::max<int64_t>(0, wait.count()));
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "fetcher.h"
+#include "metrics.h"
+
+// Small fixed pool of threads running jobs in submission order
+class WorkerPool {
+public:
+    explicit WorkerPool(size_t threads);
+    ~WorkerPool();
+
+    void submit(std::function<void()> job);
+
+private:
+    void run();
+
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<std::function<void()>> jobs_;
+    std::vector<std::thread> threads_;
+    bool stopping_ = false;
+};
+
+// One NOAA product: where it lives, how often to look at it and what to do
+// with the response. Adding a feed means adding one of these.
+struct FeedDescriptor {
+    std::string name;
+    std::string url;
+    std::chrono::seconds interval{60};      // poll period while the product keeps changing
+    std::chrono::seconds maxInterval{300};  // back-off ceiling while it does not
+    double jitter = 0.1;                    // +/- fraction applied to every delay
+    std::chrono::seconds timeout{10};       // whole request, hedge included
+    std::chrono::seconds maxBackoff{1800};  // retry ceiling while the endpoint keeps failing
+
+    // Full response: parse and publish. Returns true if it carried new data
+    // (time_tag advanced, or the values changed).
+    std::function<bool(const std::string& body)> process;
+    // After process(): send what it produced over OSC. Runs outside the
+    // process timing, which the OSC encode/send histograms already cover.
+    std::function<void()> send;
+    // 304 Not Modified: re-publish cached values. Returns false if there is
+    // nothing cached, so the next request goes out unconditionally.
+    std::function<bool()> reuse;
+    // Fetch failed: keep serving the last valid values
+    std::function<void()> fallback;
+};
+
+// Polls every feed on its own adaptive schedule. Transfers run concurrently
+// on the fetcher; responses are handled on a worker pool, so a slow feed
+// never holds up another. Failures back off exponentially, and after a few
+// in a row the feed's circuit opens: it is only probed at the back-off
+// interval and keeps serving its last valid values until a probe succeeds.
+class FeedScheduler {
+public:
+    FeedScheduler(FeedFetcher& fetcher, size_t workers);
+    ~FeedScheduler();
+
+    void addFeed(const FeedDescriptor& descriptor);
+
+    // Sees every response before it is handled (e.g. to record it); runs on
+    // the worker threads
+    typedef std::function<void(const FeedDescriptor& descriptor, const FetchResult& result)> Observer;
+    void setObserver(Observer observer) { observer_ = observer; }
+
+    // Registers per-feed fetch and processing metrics; call before addFeed()
+    void setMetrics(MetricsRegistry* metrics) { metrics_ = metrics; }
+
+    // Runs the schedule on the calling thread until the deadline passes or
+    // keepRunning() turns false
+    void runUntil(std::chrono::steady_clock::time_point deadline, const std::function<bool()>& keepRunning);
+
+    // Current delay between polls of a feed (for the console)
+    std::chrono::milliseconds currentInterval(size_t index) const;
+    bool circuitOpen(size_t index) const { return feeds_[index].circuitOpen; }
+    size_t feedCount() const { return feeds_.size(); }
+    const FeedDescriptor& descriptor(size_t index) const { return feeds_[index].descriptor; }
+
+private:
+    struct Completion {
+        size_t index;
+        bool ok;
+        bool advanced;
+        bool dropValidators;
+        long maxAgeSeconds;
+    };
+
+    // Per-feed series in the registry, null without one
+    struct FeedMetrics {
+        Counter* ok = nullptr;
+        Counter* notModified = nullptr;
+        Counter* failed = nullptr;
+        Counter* bytes = nullptr;
+        LatencyHistogram* dns = nullptr;
+        LatencyHistogram* connect = nullptr;
+        LatencyHistogram* tls = nullptr;
+        LatencyHistogram* wait = nullptr;
+        LatencyHistogram* transfer = nullptr;
+        LatencyHistogram* total = nullptr;
+        LatencyHistogram* process = nullptr;
+    };
+
+    struct Feed {
+        FeedDescriptor descriptor;
+        FeedMetrics metrics;
+        std::chrono::steady_clock::time_point nextDue;
+        std::chrono::milliseconds delay;
+        bool busy = false;  // in flight or being processed
+        unsigned failures = 0;  // consecutive
+        bool circuitOpen = false;
+    };
+
+    void onFetched(size_t index, FetchResult&& result);
+    void handle(size_t index, const FetchResult& result);
+    void recordFetch(const FeedMetrics& metrics, const FetchResult& result);
+    void reschedule(const Completion& completion);
+    std::chrono::milliseconds jittered(std::chrono::milliseconds delay, double jitter);
+
+    FeedFetcher& fetcher_;
+    std::vector<Feed> feeds_;
+    Observer observer_;
+    MetricsRegistry* metrics_ = nullptr;
+    std::mt19937 random_;
+
+    std::mutex completionsMutex_;
+    std::vector<Completion> completions_;
+
+    // Declared last so its threads stop before the rest is torn down
+    WorkerPool pool_;
+};
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <type_traits>
+
+// Latest-value publication for small trivially copyable structs.
+// Readers never block and never see a torn value: they copy the words and
+// retry if a write overlapped, which with writes minutes apart practically
+// never happens. Writers are serialised by a mutex readers never touch.
+// The payload is kept in relaxed atomics, so concurrent reads are not a
+// data race in the C++ memory model.
+template <typename T>
+class Seqlock {
+    static_assert(std::is_trivially_copyable<T>::value, "Seqlock payload must be trivially copyable");
+
+public:
+    Seqlock() { write(T()); }
+    explicit Seqlock(const T& value) { write(value); }
+
+    Seqlock(const Seqlock&) = delete;
+    Seqlock& operator=(const Seqlock&) = delete;
+
+    T load() const {
+        uint64_t words[wordCount];
+        while (true) {
+            uint64_t before = seq_.load(std::memory_order_acquire);
+            if (before & 1) continue;  // write in progress
+            for (size_t i = 0; i < wordCount; ++i) {
+                words[i] = words_[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (seq_.load(std::memory_order_relaxed) == before) break;
+        }
+        T value;
+        memcpy(&value, words, sizeof(T));
+        return value;
+    }
+
+    void store(const T& value) {
+        std::lock_guard<std::mutex> lock(writer_);
+        write(value);
+    }
+
+    // Read-modify-write of the latest value; returns what was published
+    template <typename F>
+    T update(F mutate) {
+        std::lock_guard<std::mutex> lock(writer_);
+        T value = load();
+        mutate(value);
+        write(value);
+        return value;
+    }
+
+    // Number of values published so far (starts at 1 for the initial one)
+    uint64_t version() const { return seq_.load(std::memory_order_acquire) / 2; }
+
+private:
+    static const size_t wordCount = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    void write(const T& value) {
+        uint64_t words[wordCount] = {};
+        memcpy(words, &value, sizeof(T));
+
+        uint64_t seq = seq_.load(std::memory_order_relaxed);
+        seq_.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < wordCount; ++i) {
+            words_[i].store(words[i], std::memory_order_relaxed);
+        }
+        seq_.store(seq + 2, std::memory_order_release);
+    }
+
+    std::atomic<uint64_t> seq_{0};
+    std::atomic<uint64_t> words_[wordCount];
+    std::mutex writer_;
+};
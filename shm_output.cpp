@@ -0,0 +1,163 @@
+#include "shm_output.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// The C reader relies on these offsets
+static_assert(offsetof(solar_shm_header, snapshot_seq) == 384, "snapshot seqlock moved");
+static_assert(offsetof(solar_shm_header, snapshot) == 392, "snapshot moved");
+static_assert(offsetof(solar_shm_header, ring_head) == 640, "ring head moved");
+static_assert(sizeof(solar_shm_header) == SOLAR_SHM_RING_OFFSET, "header is one page");
+static_assert(sizeof(solar_shm_snapshot) % 8 == 0 && sizeof(solar_shm_record) == 32, "records are whole words");
+
+static std::string systemError(const std::string& what) {
+    return what + ": " + strerror(errno);
+}
+
+// Relaxed word stores, mirroring the reader's relaxed loads
+static void storeWords(void* out, const void* in, size_t size) {
+    uint64_t* dst = static_cast<uint64_t*>(out);
+    const uint64_t* src = static_cast<const uint64_t*>(in);
+    for (size_t i = 0; i < size / 8; ++i) __atomic_store_n(&dst[i], src[i], __ATOMIC_RELAXED);
+}
+
+static const size_t minRingCapacity = 64;
+
+SharedMemoryOutput::SharedMemoryOutput() {}
+
+SharedMemoryOutput::~SharedMemoryOutput() {
+    close();
+}
+
+bool SharedMemoryOutput::open(const std::string& name, size_t ringCapacity, const char* const* fieldNames,
+                              size_t fieldCount, bool replace) {
+    if (fieldCount > SOLAR_SHM_MAX_FIELDS) {
+        error_ = "too many fields";
+        return false;
+    }
+    // A slot is only rewritten a whole ring later, never by two pushes at once
+    size_t capacity = minRingCapacity;
+    while (capacity < ringCapacity) capacity <<= 1;
+    size_t size = SOLAR_SHM_RING_OFFSET + capacity * sizeof(solar_shm_record);
+
+    // A fresh object each run: readers of a previous one are not confused by
+    // the ring starting over
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        solar_shm_reader previous;
+        bool abandoned = false;
+        if (solar_shm_open(&previous, name.c_str()) == 0) {
+            abandoned = !solar_shm_producer_alive(&previous);
+            solar_shm_close(&previous);
+        }
+        if (!abandoned && !replace) {
+            error_ = name + " is in use by another producer, or is not a solar-watcher object (--shm-replace "
+                            "takes it over)";
+            return false;
+        }
+        shm_unlink(name.c_str());
+        fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    }
+    if (fd < 0) {
+        error_ = systemError("shm_open " + name);
+        return false;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        error_ = systemError("ftruncate");
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return false;
+    }
+    void* base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED) {
+        error_ = systemError("mmap");
+        shm_unlink(name.c_str());
+        return false;
+    }
+
+    // New pages are zero; only the description needs filling in
+    header_ = static_cast<solar_shm_header*>(base);
+    header_->version = SOLAR_SHM_VERSION;
+    header_->field_count = (uint32_t)fieldCount;
+    header_->ring_capacity = capacity;
+    header_->ring_offset = SOLAR_SHM_RING_OFFSET;
+    header_->total_size = size;
+    header_->producer_pid = (int64_t)getpid();
+    for (size_t f = 0; f < fieldCount; ++f) {
+        strncpy(header_->field_names[f], fieldNames[f], SOLAR_SHM_NAME_SIZE - 1);
+    }
+    // Magic last: a reader that sees it sees the rest
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header_->magic, SOLAR_SHM_MAGIC, 8);
+
+    ring_ = reinterpret_cast<solar_shm_record*>(static_cast<char*>(base) + SOLAR_SHM_RING_OFFSET);
+    name_ = name;
+    size_ = size;
+    ringCapacity_ = capacity;
+    head_.store(0, std::memory_order_relaxed);
+    return true;
+}
+
+void SharedMemoryOutput::close() {
+    std::lock_guard<std::mutex> lock(writer_);
+    if (!header_) return;
+    __atomic_store_n(&header_->closed, 1u, __ATOMIC_RELEASE);
+    munmap(header_, size_);
+    shm_unlink(name_.c_str());
+    header_ = nullptr;
+    ring_ = nullptr;
+}
+
+void SharedMemoryOutput::publishSnapshot(uint32_t validMask, const float* values, const int64_t* times) {
+    std::lock_guard<std::mutex> lock(writer_);
+    if (!header_) return;
+
+    solar_shm_snapshot snapshot = {};
+    snapshot.published_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    snapshot.valid_mask = validMask;
+    for (uint32_t f = 0; f < header_->field_count; ++f) {
+        snapshot.values[f] = values[f];
+        snapshot.times[f] = times[f];
+    }
+
+    uint64_t seq = header_->snapshot_seq;
+    snapshot.version = seq / 2 + 1;
+    __atomic_store_n(&header_->snapshot_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    storeWords(&header_->snapshot, &snapshot, sizeof(snapshot));
+    __atomic_store_n(&header_->snapshot_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void SharedMemoryOutput::push(uint32_t field, uint32_t kind, int64_t timeMicros, float value) {
+    if (!header_) return;
+
+    uint64_t index = head_.fetch_add(1, std::memory_order_relaxed);
+    solar_shm_record record = {};
+    record.seq = index + 1;
+    record.time_us = timeMicros;
+    record.field = field;
+    record.kind = kind;
+    record.value = value;
+
+    // Per-slot seqlock: 0 while the slot is rewritten, then its index + 1
+    solar_shm_record* slot = &ring_[index & (ringCapacity_ - 1)];
+    __atomic_store_n(&slot->seq, (uint64_t)0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    storeWords(reinterpret_cast<char*>(slot) + 8, reinterpret_cast<const char*>(&record) + 8, sizeof(record) - 8);
+    __atomic_store_n(&slot->seq, record.seq, __ATOMIC_RELEASE);
+
+    // Pushes finish out of order: ring_head only ever moves forward, and a
+    // reader waits on a slot below it that is still being written
+    uint64_t published = __atomic_load_n(&header_->ring_head, __ATOMIC_RELAXED);
+    while (published < record.seq &&
+           !__atomic_compare_exchange_n(&header_->ring_head, &published, record.seq, true, __ATOMIC_RELEASE,
+                                        __ATOMIC_RELAXED)) {
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "solar_shm.h"
+
+// Producer side of the shared-memory output (layout and reader API in
+// solar_shm.h): the latest snapshot behind a seqlock and a ring of recent
+// samples in a POSIX shared-memory object, for consumers on the same host
+// that want the data without sockets, copies or parsing.
+//
+// Snapshot writers are serialised by a mutex readers never touch. Ring
+// records take no lock: each claims its slot from an atomic counter and
+// guards it with the slot's sequence number, so the stream thread's frames
+// never wait for a fetch worker pushing NOAA rows.
+class SharedMemoryOutput {
+public:
+    SharedMemoryOutput();
+    ~SharedMemoryOutput();
+
+    SharedMemoryOutput(const SharedMemoryOutput&) = delete;
+    SharedMemoryOutput& operator=(const SharedMemoryOutput&) = delete;
+
+    // Creates the object. One left under the same name by a producer that is
+    // gone (e.g. after a crash) is replaced; one whose producer is running, or
+    // that is not ours, is only replaced with replace set, and readers still
+    // mapping it stop seeing updates. ringCapacity is rounded up to a power
+    // of two.
+    bool open(const std::string& name, size_t ringCapacity, const char* const* fieldNames, size_t fieldCount,
+              bool replace = false);
+    // Marks the object closed and removes its name; call once nothing
+    // pushes any more
+    void close();
+    bool isOpen() const { return header_ != nullptr; }
+    const std::string& error() const { return error_; }
+
+    // values[f] counts only if bit f of validMask is set; times are per-field
+    // data times in Unix seconds
+    void publishSnapshot(uint32_t validMask, const float* values, const int64_t* times);
+
+    // One ring record (kind: SOLAR_SHM_SAMPLE or SOLAR_SHM_SMOOTH); safe from
+    // any number of threads
+    void push(uint32_t field, uint32_t kind, int64_t timeMicros, float value);
+
+    uint64_t recordsWritten() const { return head_.load(std::memory_order_relaxed); }
+    size_t ringCapacity() const { return ringCapacity_; }
+
+private:
+    std::mutex writer_;
+    std::string name_;
+    std::string error_;
+    solar_shm_header* header_ = nullptr;
+    solar_shm_record* ring_ = nullptr;
+    size_t size_ = 0;
+    size_t ringCapacity_ = 0;
+    std::atomic<uint64_t> head_{0};  // ring indices claimed so far
+};
@@ -0,0 +1,255 @@
+/*
+ * Reader API for the shared-memory output of solar-watcher (--shm NAME).
+ * Header-only C (also usable from C++), GCC/Clang atomic builtins, POSIX.
+ *
+ * The object holds two things:
+ *   - the latest snapshot of every field, behind a seqlock;
+ *   - a ring of the most recent samples (NOAA rows, and interpolated
+ *     frames when --stream-hz is on), written by one producer and read by
+ *     any number of consumers, each at its own pace.
+ * Reading takes no syscalls and no locks: a reader copies the data and
+ * retries if the producer overlapped. A reader that falls more than a ring
+ * behind skips ahead and counts what it missed.
+ *
+ *     solar_shm_reader r;
+ *     if (solar_shm_open(&r, "/solar-watcher") != 0) { perror("shm"); return 1; }
+ *     solar_shm_snapshot s;
+ *     if (solar_shm_latest(&r, &s) == 0 && (s.valid_mask >> SOLAR_SHM_BZ_GSM & 1))
+ *         printf("Bz %.2f nT\n", s.values[SOLAR_SHM_BZ_GSM]);
+ *     solar_shm_record batch[256];
+ *     size_t n = solar_shm_poll(&r, batch, 256);   // new samples since last poll
+ *     solar_shm_close(&r);
+ */
+#ifndef SOLAR_SHM_H
+#define SOLAR_SHM_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SOLAR_SHM_MAGIC "SOLSHM1"
+/* 2: by_gsm added after bz_gsm, kp and regions moved up one */
+#define SOLAR_SHM_VERSION 2
+#define SOLAR_SHM_MAX_FIELDS 16
+#define SOLAR_SHM_NAME_SIZE 16
+#define SOLAR_SHM_RING_OFFSET 4096
+
+/* Field indices: snapshot slots and solar_shm_record.field */
+enum {
+    SOLAR_SHM_DENSITY = 0,
+    SOLAR_SHM_SPEED = 1,
+    SOLAR_SHM_TEMPERATURE = 2,
+    SOLAR_SHM_M_CLASS = 3,
+    SOLAR_SHM_X_CLASS = 4,
+    SOLAR_SHM_LON_GSM = 5,
+    SOLAR_SHM_BT = 6,
+    SOLAR_SHM_BZ_GSM = 7,
+    SOLAR_SHM_BY_GSM = 8,
+    SOLAR_SHM_KP = 9,
+    SOLAR_SHM_REGIONS = 10
+};
+
+/* solar_shm_record.kind */
+enum {
+    SOLAR_SHM_SAMPLE = 0, /* a NOAA row, time is its time_tag */
+    SOLAR_SHM_SMOOTH = 1  /* an interpolated frame, time is when it was computed */
+};
+
+typedef struct solar_shm_snapshot {
+    int64_t published_us;                  /* wall clock of the publication, Unix us */
+    uint64_t version;                      /* publications so far */
+    uint32_t valid_mask;                   /* bit f set: values[f] is valid */
+    uint32_t reserved;
+    float values[SOLAR_SHM_MAX_FIELDS];
+    int64_t times[SOLAR_SHM_MAX_FIELDS];   /* data time per field, Unix s, 0 if none */
+} solar_shm_snapshot;
+
+typedef struct solar_shm_record {
+    uint64_t seq;      /* ring index + 1 once written, 0 while being written */
+    int64_t time_us;   /* Unix microseconds */
+    uint32_t field;    /* SOLAR_SHM_DENSITY ... */
+    uint32_t kind;     /* SOLAR_SHM_SAMPLE or SOLAR_SHM_SMOOTH */
+    float value;
+    uint32_t reserved;
+} solar_shm_record;
+
+/* First page of the object; the ring follows at ring_offset. Producer and
+   consumers each get their own cache lines. */
+typedef struct solar_shm_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t field_count;
+    uint64_t ring_capacity;    /* records, a power of two */
+    uint64_t ring_offset;
+    uint64_t total_size;
+    int64_t producer_pid;
+    uint32_t closed;           /* set when the producer exits cleanly */
+    uint32_t reserved0;
+    char field_names[SOLAR_SHM_MAX_FIELDS][SOLAR_SHM_NAME_SIZE];
+    unsigned char pad0[384 - 312];
+
+    uint64_t snapshot_seq;     /* odd while the snapshot is being written */
+    solar_shm_snapshot snapshot;
+    unsigned char pad1[640 - 608];
+
+    uint64_t ring_head;        /* records published so far; the newest few may
+                                  still be in progress (seq not yet index + 1) */
+    unsigned char pad2[SOLAR_SHM_RING_OFFSET - 648];
+} solar_shm_header;
+
+typedef struct solar_shm_reader {
+    const solar_shm_header* header;
+    const solar_shm_record* ring;
+    size_t size;
+    uint64_t cursor;   /* next ring index solar_shm_poll() returns */
+    uint64_t lost;     /* records overwritten before they were polled */
+} solar_shm_reader;
+
+/* Maps the object read-only; polling starts at the newest record.
+   Returns 0, or -1 with errno set (EPROTO: not a compatible object). */
+static inline int solar_shm_open(solar_shm_reader* r, const char* name) {
+    struct stat st;
+    void* base;
+    const solar_shm_header* h;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) return -1;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    if ((size_t)st.st_size < sizeof(solar_shm_header)) {
+        close(fd);
+        errno = EPROTO;
+        return -1;
+    }
+    base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    /* The ring must lie inside the mapping, after the header, whatever the
+       object claims: a foreign or corrupt one must not send readers past it */
+    h = (const solar_shm_header*)base;
+    if (memcmp(h->magic, SOLAR_SHM_MAGIC, 8) != 0 || h->version != SOLAR_SHM_VERSION ||
+        h->total_size > (uint64_t)st.st_size || h->field_count > SOLAR_SHM_MAX_FIELDS ||
+        h->ring_capacity == 0 || (h->ring_capacity & (h->ring_capacity - 1)) != 0 ||
+        h->ring_offset < sizeof(solar_shm_header) || h->ring_offset % 8 != 0 ||
+        h->ring_offset > (uint64_t)st.st_size ||
+        h->ring_capacity > ((uint64_t)st.st_size - h->ring_offset) / sizeof(solar_shm_record)) {
+        munmap(base, (size_t)st.st_size);
+        errno = EPROTO;
+        return -1;
+    }
+    r->header = h;
+    r->ring = (const solar_shm_record*)((const char*)base + h->ring_offset);
+    r->size = (size_t)st.st_size;
+    r->cursor = __atomic_load_n(&h->ring_head, __ATOMIC_ACQUIRE);
+    r->lost = 0;
+    return 0;
+}
+
+static inline void solar_shm_close(solar_shm_reader* r) {
+    if (r->header) munmap((void*)r->header, r->size);
+    r->header = NULL;
+    r->ring = NULL;
+}
+
+/* Word-wise relaxed copy, so a racing write is not undefined behaviour */
+static inline void solar_shm_copy_(void* out, const void* in, size_t size) {
+    const uint64_t* src = (const uint64_t*)in;
+    size_t i;
+    for (i = 0; i < size / 8; ++i) {
+        uint64_t word = __atomic_load_n(&src[i], __ATOMIC_RELAXED);
+        memcpy((char*)out + i * 8, &word, 8);
+    }
+}
+
+/* Consistent copy of the latest values. Returns 0, or -1 (EAGAIN) if the
+   producer stopped in the middle of a write. */
+static inline int solar_shm_latest(const solar_shm_reader* r, solar_shm_snapshot* out) {
+    const solar_shm_header* h = r->header;
+    long attempt;
+    for (attempt = 0; attempt < 1000000; ++attempt) {
+        uint64_t before = __atomic_load_n(&h->snapshot_seq, __ATOMIC_ACQUIRE);
+        if (before & 1) continue;
+        solar_shm_copy_(out, &h->snapshot, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&h->snapshot_seq, __ATOMIC_RELAXED) == before) return 0;
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+/* Record at ring index i: 1 if copied, 0 if it has been overwritten, -1 if
+   it is not written yet (the producer's threads finish pushes out of order) */
+static inline int solar_shm_read_(const solar_shm_reader* r, uint64_t i, solar_shm_record* out) {
+    const solar_shm_record* slot = &r->ring[i & (r->header->ring_capacity - 1)];
+    uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    if (before != i + 1) return before > i + 1 ? 0 : -1;
+    solar_shm_copy_(out, slot, sizeof(*out));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == before ? 1 : 0;
+}
+
+/* Records written since the last poll, oldest first, at most max of them.
+   Whatever the producer overwrote first is added to r->lost. */
+static inline size_t solar_shm_poll(solar_shm_reader* r, solar_shm_record* out, size_t max) {
+    uint64_t head = __atomic_load_n(&r->header->ring_head, __ATOMIC_ACQUIRE);
+    uint64_t capacity = r->header->ring_capacity;
+    size_t n = 0;
+    if (head - r->cursor > capacity) {
+        r->lost += head - r->cursor - capacity;
+        r->cursor = head - capacity;
+    }
+    while (r->cursor < head && n < max) {
+        int read = solar_shm_read_(r, r->cursor, &out[n]);
+        if (read < 0) break; /* picked up by the next poll */
+        if (read) {
+            ++n;
+        } else {
+            ++r->lost;
+        }
+        ++r->cursor;
+    }
+    return n;
+}
+
+/* Up to max of the newest records, oldest first, without moving the cursor */
+static inline size_t solar_shm_recent(const solar_shm_reader* r, solar_shm_record* out, size_t max) {
+    uint64_t head = __atomic_load_n(&r->header->ring_head, __ATOMIC_ACQUIRE);
+    uint64_t count = head < r->header->ring_capacity ? head : r->header->ring_capacity;
+    uint64_t i;
+    size_t n = 0;
+    if (count > max) count = max;
+    for (i = head - count; i < head; ++i) {
+        if (solar_shm_read_(r, i, &out[n]) > 0) ++n;
+    }
+    return n;
+}
+
+/* "density", "bz_gsm" ...; "" for an unknown field */
+static inline const char* solar_shm_field_name(const solar_shm_reader* r, uint32_t field) {
+    if (field >= r->header->field_count || field >= SOLAR_SHM_MAX_FIELDS) return "";
+    return r->header->field_names[field];
+}
+
+/* 0 once the producer has exited; reopen to follow a new one */
+static inline int solar_shm_producer_alive(const solar_shm_reader* r) {
+    if (__atomic_load_n(&r->header->closed, __ATOMIC_ACQUIRE)) return 0;
+    return kill((pid_t)r->header->producer_pid, 0) == 0 || errno == EPERM;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SOLAR_SHM_H */
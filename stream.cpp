@@ -0,0 +1,222 @@
+#include "stream.h"
+
+#include <cerrno>
+#include <cmath>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+
+using Clock = std::chrono::steady_clock;
+
+bool parseSmoothing(const std::string& name, Smoothing& out) {
+    if (name == "linear") {
+        out = Smoothing::Linear;
+    } else if (name == "cubic") {
+        out = Smoothing::Cubic;
+    } else if (name == "exp" || name == "exponential") {
+        out = Smoothing::Exponential;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* smoothingName(Smoothing smoothing) {
+    switch (smoothing) {
+        case Smoothing::Linear: return "linear";
+        case Smoothing::Cubic: return "cubic";
+        case Smoothing::Exponential: return "exponential";
+    }
+    return "?";
+}
+
+JitterHistogram::JitterHistogram() {
+    for (auto& bucket : buckets_) bucket.store(0);
+}
+
+void JitterHistogram::record(int64_t lateNanos) {
+    if (lateNanos < 0) lateNanos = 0;
+    uint64_t micros = (uint64_t)lateNanos / 1000;
+    int bucket = 0;
+    while (micros > 0 && bucket < bucketCount - 1) {
+        micros >>= 1;
+        ++bucket;
+    }
+    buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t seen = maxNanos_.load(std::memory_order_relaxed);
+    while (lateNanos > seen && !maxNanos_.compare_exchange_weak(seen, lateNanos)) {}
+}
+
+uint64_t JitterHistogram::total() const {
+    uint64_t sum = 0;
+    for (const auto& bucket : buckets_) sum += bucket.load(std::memory_order_relaxed);
+    return sum;
+}
+
+double JitterHistogram::quantileMicros(double q) const {
+    uint64_t count = total();
+    if (count == 0) return 0.0;
+    uint64_t target = (uint64_t)std::ceil(q * count);
+    uint64_t seen = 0;
+    for (int i = 0; i < bucketCount; ++i) {
+        seen += buckets_[i].load(std::memory_order_relaxed);
+        if (seen >= target) return (double)(1ULL << i);
+    }
+    return (double)(1ULL << (bucketCount - 1));
+}
+
+void JitterHistogram::print(std::ostream& out) const {
+    uint64_t count = total();
+    for (int i = 0; i < bucketCount; ++i) {
+        uint64_t n = buckets_[i].load(std::memory_order_relaxed);
+        if (n == 0) continue;
+        uint64_t lo = i == 0 ? 0 : 1ULL << (i - 1);
+        uint64_t hi = 1ULL << i;
+        out << "      " << std::setw(7) << lo << "-" << std::left << std::setw(7) << hi << std::right
+            << " us " << std::setw(9) << n << "  " << std::fixed << std::setprecision(2)
+            << (100.0 * n / count) << "%\n";
+    }
+}
+
+InterpolatedStream::InterpolatedStream(OSCSender& sender, double rateHz, Smoothing smoothing, OSCValueMode mode)
+    : sender_(sender), rateHz_(rateHz), smoothing_(smoothing), mode_(mode) {}
+
+InterpolatedStream::~InterpolatedStream() {
+    stop();
+}
+
+size_t InterpolatedStream::addChannel(const OSCAddressView& address, int precision) {
+    channels_.emplace_back(new Channel(address, precision));
+    return channels_.size() - 1;
+}
+
+void InterpolatedStream::push(size_t channel, int64_t time, float value) {
+    if (std::isnan(value) || channel >= channels_.size()) return;
+
+    // Each channel is fed by one feed, so this read-modify-write is uncontended
+    channels_[channel]->history.update([&](History& h) {
+        if (h.count > 0 && time <= h.samples[3].time) return;
+
+        for (int i = 0; i < 3; ++i) h.samples[i] = h.samples[i + 1];
+        h.samples[3].time = time;
+        h.samples[3].value = value;
+        if (h.count < 4) ++h.count;
+        h.arrivalNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+    });
+}
+
+bool InterpolatedStream::evaluate(Channel& c, const History& h, Clock::time_point now, double frameSeconds,
+                                  float& value) {
+    if (h.count == 0) return false;
+
+    const Sample& last = h.samples[3];
+    if (h.count == 1) {
+        value = last.value;
+        c.smoothed = last.value;
+        return true;
+    }
+
+    // Play the newest segment over one sample interval, starting on arrival,
+    // so the output reaches the newest value just as the next one is due
+    const Sample& prev = h.samples[2];
+    double interval = (double)(last.time - prev.time);
+    if (interval <= 0.0) interval = 60.0;
+    Clock::time_point arrival(std::chrono::duration_cast<Clock::duration>(std::chrono::nanoseconds(h.arrivalNanos)));
+    double elapsed = std::chrono::duration<double>(now - arrival).count();
+    double u = elapsed / interval;
+    if (u < 0.0) u = 0.0;
+    if (u > 1.0) u = 1.0;
+
+    switch (smoothing_) {
+        case Smoothing::Linear:
+            value = (float)(prev.value + (last.value - prev.value) * u);
+            break;
+        case Smoothing::Cubic: {
+            // Catmull-Rom through the last samples, holding the newest one
+            double p0 = h.count >= 3 ? h.samples[1].value : prev.value;
+            double p1 = prev.value;
+            double p2 = last.value;
+            double p3 = last.value;
+            double u2 = u * u;
+            double u3 = u2 * u;
+            value = (float)(0.5 * (2.0 * p1 + (p2 - p0) * u + (2.0 * p0 - 5.0 * p1 + 4.0 * p2 - p3) * u2 +
+                                   (3.0 * p1 - p0 - 3.0 * p2 + p3) * u3));
+            break;
+        }
+        case Smoothing::Exponential: {
+            // First-order low-pass settling within about one interval
+            double tau = interval / 4.0;
+            double alpha = 1.0 - std::exp(-frameSeconds / tau);
+            c.smoothed += (float)((last.value - c.smoothed) * alpha);
+            value = c.smoothed;
+            break;
+        }
+    }
+    return true;
+}
+
+void InterpolatedStream::start() {
+    if (running_.exchange(true)) return;
+    thread_ = std::thread(&InterpolatedStream::run, this);
+}
+
+void InterpolatedStream::stop() {
+    if (!running_.exchange(false)) return;
+    if (thread_.joinable()) thread_.join();
+}
+
+static void sleepUntil(Clock::time_point deadline) {
+#ifdef __linux__
+    // steady_clock is CLOCK_MONOTONIC on Linux
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+    timespec ts;
+    ts.tv_sec = (time_t)(ns / 1000000000);
+    ts.tv_nsec = (long)(ns % 1000000000);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {}
+#else
+    // No clock_nanosleep on macOS: sleep to just short of the deadline, then spin
+    std::this_thread::sleep_until(deadline - std::chrono::microseconds(500));
+    while (Clock::now() < deadline) std::this_thread::yield();
+#endif
+}
+
+void InterpolatedStream::run() {
+    const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rateHz_));
+    const double frameSeconds = 1.0 / rateHz_;
+    const auto startTime = Clock::now();
+    uint64_t frame = 0;
+
+    while (running_.load(std::memory_order_relaxed)) {
+        // Deadlines are start + k * period, so errors never accumulate
+        ++frame;
+        Clock::time_point deadline = startTime + period * (int64_t)frame;
+        sleepUntil(deadline);
+
+        Clock::time_point now = Clock::now();
+        jitter_.record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - deadline).count());
+
+        // Lock-free: a push landing mid-frame never delays it
+        OSCBundle bundle(mode_);
+        int64_t frameMicros = frameObserver_ ? std::chrono::duration_cast<std::chrono::microseconds>(
+                                                   std::chrono::system_clock::now().time_since_epoch()).count()
+                                             : 0;
+        for (size_t i = 0; i < channels_.size(); ++i) {
+            Channel& c = *channels_[i];
+            float value = 0.0f;
+            if (evaluate(c, c.history.load(), now, frameSeconds, value)) {
+                bundle.addFloat(c.address, value, c.precision);
+                if (frameObserver_) frameObserver_(i, frameMicros, value);
+            }
+        }
+        sender_.send(bundle);
+        frames_.fetch_add(1, std::memory_order_relaxed);
+
+        // Fell more than a frame behind: skip to the next deadline in the future
+        uint64_t due = (uint64_t)((Clock::now() - startTime) / period);
+        if (due > frame) {
+            missed_.fetch_add(due - frame, std::memory_order_relaxed);
+            frame = due;
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "osc.h"
+#include "seqlock.h"
+
+enum class Smoothing { Linear, Cubic, Exponential };
+
+bool parseSmoothing(const std::string& name, Smoothing& out);
+const char* smoothingName(Smoothing smoothing);
+
+// Frame lateness in log2 microsecond buckets: [0,1us), [1,2us), [2,4us) ...
+class JitterHistogram {
+public:
+    static const int bucketCount = 24;  // last bucket: >= 4.2 s
+
+    JitterHistogram();
+
+    void record(int64_t lateNanos);
+    uint64_t total() const;
+    // Upper bound of the bucket that holds the given quantile, in microseconds
+    double quantileMicros(double q) const;
+    double maxMicros() const { return maxNanos_.load() / 1000.0; }
+    void print(std::ostream& out) const;
+
+private:
+    std::atomic<uint64_t> buckets_[bucketCount];
+    std::atomic<int64_t> maxNanos_{0};
+};
+
+// Emits every channel at a fixed frame rate, smoothly moving between the
+// samples ingested from NOAA. Runs on its own thread with absolute
+// deadlines, so frames do not drift however long fetching and parsing take.
+class InterpolatedStream {
+public:
+    InterpolatedStream(OSCSender& sender, double rateHz, Smoothing smoothing, OSCValueMode mode);
+    ~InterpolatedStream();
+
+    // Channels are fixed once start() has been called
+    size_t addChannel(const OSCAddressView& address, int precision);
+
+    // New sample for a channel (data time in Unix seconds); thread-safe,
+    // and never blocks the frame thread
+    void push(size_t channel, int64_t time, float value);
+
+    // Sees every value of every frame (e.g. to copy it to shared memory).
+    // Runs on the frame thread, so it must not block; set before start().
+    typedef std::function<void(size_t channel, int64_t unixMicros, float value)> FrameObserver;
+    void setFrameObserver(FrameObserver observer) { frameObserver_ = observer; }
+
+    void start();
+    void stop();
+
+    double rateHz() const { return rateHz_; }
+    Smoothing smoothing() const { return smoothing_; }
+    uint64_t frames() const { return frames_.load(); }
+    uint64_t missedFrames() const { return missed_.load(); }
+    const JitterHistogram& jitter() const { return jitter_; }
+
+private:
+    struct Sample {
+        int64_t time = 0;
+        float value = 0.0f;
+    };
+
+    // What push() publishes: the last samples and when the newest arrived
+    struct History {
+        Sample samples[4];      // newest last
+        int count = 0;
+        int64_t arrivalNanos = 0;  // steady_clock
+    };
+
+    struct Channel {
+        OSCAddressView address;
+        int precision;
+        Seqlock<History> history;
+        float smoothed = 0.0f;  // state of the exponential filter, frame thread only
+
+        Channel(const OSCAddressView& a, int p) : address(a), precision(p) {}
+    };
+
+    void run();
+    bool evaluate(Channel& channel, const History& history, std::chrono::steady_clock::time_point now,
+                  double frameSeconds, float& value);
+
+    OSCSender& sender_;
+    double rateHz_;
+    Smoothing smoothing_;
+    OSCValueMode mode_;
+
+    std::vector<std::unique_ptr<Channel>> channels_;
+    FrameObserver frameObserver_;
+
+    std::thread thread_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> frames_{0};
+    std::atomic<uint64_t> missed_{0};
+    JitterHistogram jitter_;
+};
@@ -0,0 +1,63 @@
+// solar-tests: checks of the derived indices that a benchmark cannot catch
+// (run by ctest)
+
+#include <cmath>
+#include <cstdio>
+#include <initializer_list>
+
+#include "../derived.h"
+#include "../timeseries.h"
+
+static int failures = 0;
+
+static void expectNear(const char* what, float actual, float expected, float tolerance = 1e-4f) {
+    if (std::fabs(actual - expected) <= tolerance) return;
+    fprintf(stderr, "FAIL %s: %g, expected %g\n", what, actual, expected);
+    ++failures;
+}
+
+// Magnetometer rows one minute apart: lon_gsm, bt, bz_gsm, by_gsm
+static float southMinutes(std::initializer_list<float> bzRows) {
+    TimeSeriesTable plasma(16, 3), mag(16, 4);
+    int64_t time = 1715360100;
+    for (float bz : bzRows) {
+        const float row[] = {90.0f, 5.0f, bz, 1.0f};
+        mag.append(time, row);
+        time += 60;
+    }
+    DerivedIndices indices({10});
+    return indices.update(plasma, mag).southMinutes;
+}
+
+static void testSouthwardRun() {
+    expectNear("no southward row", southMinutes({2.0f, 1.0f}), 0.0f);
+    expectNear("one southward row", southMinutes({2.0f, 1.0f, -3.0f}), 1.0f);
+    expectNear("two southward rows", southMinutes({2.0f, -1.0f, -3.0f}), 2.0f);
+    expectNear("gap inside the run", southMinutes({2.0f, -1.0f, NAN, -3.0f}), 3.0f);
+    // Nothing stored before the run: the oldest row counts one interval
+    expectNear("one row, nothing before", southMinutes({-3.0f}), 1.0f);
+    expectNear("two rows, nothing before", southMinutes({-1.0f, -3.0f}), 2.0f);
+}
+
+static void testClockAngle() {
+    const float by[] = {0.0f, 3.0f, 0.0f, -4.0f, 0.0f};
+    const float bz[] = {-5.0f, 4.0f, 5.0f, 0.0f, 0.0f};
+    float sinHalfSquared[5], transverse[5];
+    clockAngle(by, bz, sinHalfSquared, transverse, 5);
+
+    expectNear("southward sin^2", sinHalfSquared[0], 1.0f);
+    expectNear("southward B_T", transverse[0], 5.0f);
+    expectNear("3-4-5 sin^2", sinHalfSquared[1], 0.1f);
+    expectNear("3-4-5 B_T", transverse[1], 5.0f);
+    expectNear("northward sin^2", sinHalfSquared[2], 0.0f);
+    expectNear("duskward sin^2", sinHalfSquared[3], 0.5f);
+    expectNear("zero field sin^2", sinHalfSquared[4], 0.0f);
+}
+
+int main() {
+    testSouthwardRun();
+    testClockAngle();
+    if (failures) return 1;
+    printf("derived: ok\n");
+    return 0;
+}
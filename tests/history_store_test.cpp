@@ -0,0 +1,134 @@
+// solar-history-tests: the archive's commit and recovery rules (run by ctest)
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "../history_store.h"
+
+static int failures = 0;
+
+static void expect(const char* what, bool condition) {
+    if (condition) return;
+    fprintf(stderr, "FAIL %s\n", what);
+    ++failures;
+}
+
+static const char* const storePath = "history_test.dat";
+static const char* const copyPath = "history_test_copy.dat";
+static const size_t fieldCount = 3;
+
+static void appendRow(HistoryStore& store, int64_t time) {
+    const float values[fieldCount] = {(float)time, (float)time / 2, NAN};
+    const int64_t fieldTimes[fieldCount] = {time - 60, time - 120, 0};
+    store.append(time, 0x3u, values, fieldTimes);
+}
+
+// The bytes the store has written so far, as a crash would leave them
+static void copyFile(const char* from, const char* to) {
+    std::ifstream in(from, std::ios::binary);
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out << in.rdbuf();
+}
+
+static void testRoundTrip() {
+    std::remove(storePath);
+    {
+        HistoryStore store;
+        expect("create", store.open(storePath, fieldCount));
+        for (int64_t t = 1000; t < 1010; ++t) appendRow(store, t);
+        expect("sync", store.sync());
+    }
+
+    HistoryStore store;
+    expect("reopen", store.open(storePath, fieldCount));
+    expect("rows after reopen", store.rowCount() == 10 && store.committedRows() == 10);
+
+    int64_t time = 0;
+    uint32_t mask = 0;
+    float values[fieldCount];
+    int64_t fieldTimes[fieldCount];
+    expect("last row", store.lastRow(time, mask, values, fieldTimes));
+    expect("last row time", time == 1009 && mask == 0x3u);
+    expect("last row values", values[0] == 1009.0f && values[1] == 504.5f);
+    expect("last row field times", fieldTimes[0] == 949 && fieldTimes[1] == 889);
+
+    int64_t times[16];
+    float column[16];
+    size_t n = store.query(1, 1003, 1006, times, column, 16);
+    expect("query range", n == 3 && times[0] == 1003 && times[2] == 1005 && column[0] == 501.5f);
+    n = store.query(2, 1000, 1010, nullptr, column, 16);
+    expect("invalid field reads as NaN", n == 10 && std::isnan(column[0]));
+
+    HistoryStore other;
+    expect("other field count refused", !other.open(storePath, fieldCount + 1));
+}
+
+static void testNewestSlotCorrupted() {
+    std::remove(storePath);
+    {
+        HistoryStore store;
+        store.open(storePath, fieldCount);  // header sequence 1, slot 1
+        for (int64_t t = 0; t < 5; ++t) appendRow(store, t);
+        store.sync();  // sequence 2, slot 0: 5 rows
+        for (int64_t t = 5; t < 8; ++t) appendRow(store, t);
+        store.sync();  // sequence 3, slot 1: 8 rows
+    }
+
+    // Slots are 64 bytes at the start of the file; break the newest one
+    std::string bytes;
+    {
+        std::ifstream in(storePath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    bytes[64 + 32] ^= 0x5a;  // its committed row count
+    {
+        std::ofstream out(storePath, std::ios::binary | std::ios::trunc);
+        out << bytes;
+    }
+
+    HistoryStore store;
+    expect("open with a torn slot", store.open(storePath, fieldCount));
+    expect("older slot wins", store.committedRows() == 5);
+    int64_t time = 0;
+    uint32_t mask = 0;
+    float values[fieldCount];
+    expect("older slot's last row", store.lastRow(time, mask, values) && time == 4);
+}
+
+static void testUnsyncedRowsDropped() {
+    std::remove(storePath);
+    std::remove(copyPath);
+    {
+        HistoryStore store;
+        store.open(storePath, fieldCount);
+        for (int64_t t = 0; t < 4; ++t) appendRow(store, t);
+        store.sync();
+        for (int64_t t = 4; t < 9; ++t) appendRow(store, t);
+        // Crash before the next sync: the file as it is now
+        copyFile(storePath, copyPath);
+    }
+
+    HistoryStore store;
+    expect("open after crash", store.open(copyPath, fieldCount));
+    expect("only synced rows", store.rowCount() == 4 && store.committedRows() == 4);
+    appendRow(store, 100);
+    int64_t time = 0;
+    uint32_t mask = 0;
+    float values[fieldCount];
+    expect("appends after the synced rows",
+           store.rowCount() == 5 && store.lastRow(time, mask, values) && time == 100);
+}
+
+int main() {
+    testRoundTrip();
+    testNewestSlotCorrupted();
+    testUnsyncedRowsDropped();
+    std::remove(storePath);
+    std::remove(copyPath);
+    if (failures) return 1;
+    printf("history store: ok\n");
+    return 0;
+}
@@ -0,0 +1,123 @@
+// solar-json-tests: the backward NOAA table scanner and what the table
+// extractor makes of its results (run by ctest)
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../feed_schema.h"
+#include "../json_tail.h"
+
+static int failures = 0;
+
+static void expect(const char* what, bool condition) {
+    if (condition) return;
+    fprintf(stderr, "FAIL %s\n", what);
+    ++failures;
+}
+
+static bool textIs(const JsonScalar& value, const char* text) {
+    return value.size == strlen(text) && memcmp(value.data, text, value.size) == 0;
+}
+
+static const std::string header = "[[\"time_tag\",\"speed\"]";
+
+static void testStringsWithBrackets() {
+    // Quotes and brackets inside strings must not end a row early
+    std::string body = header + ",[\"a\\\"]b[\",\"1\"],[\"x]\\\\\",\"2\"],[\"[y\",\"3\"]]";
+    JsonTailReader reader(body);
+    expect("select", reader.selectColumns({"time_tag", "speed"}));
+    expect("last row", reader.previousRow() && textIs(reader.column(0), "[y") && textIs(reader.column(1), "3"));
+    // A string ending in an escaped backslash: its quote is the real one
+    expect("escaped backslash", reader.previousRow() && textIs(reader.column(0), "x]\\\\"));
+    // Escapes are kept as they are in the buffer
+    expect("escaped quote", reader.previousRow() && textIs(reader.column(0), "a\\\"]b["));
+    expect("start of array", !reader.previousRow() && reader.ok());
+}
+
+static void testScalars() {
+    std::string body = header + ",[\"a\",null],[\"b\",\"null\"],[\"c\",\"\"],[\"d\",12.5],[\"e\",\"-3.25\"]]";
+    JsonTailReader reader(body);
+    reader.selectColumns({"time_tag", "speed"});
+    float value = 0.0f;
+
+    expect("string number", reader.previousRow() && reader.column(1).type == JsonScalar::String);
+    expect("string number value", jsonScalarToFloat(reader.column(1), value) && value == -3.25f);
+    expect("number", reader.previousRow() && reader.column(1).type == JsonScalar::Number);
+    expect("number value", jsonScalarToFloat(reader.column(1), value) && value == 12.5f);
+    expect("empty string",
+           reader.previousRow() && reader.column(1).isNull() && !jsonScalarToFloat(reader.column(1), value));
+    expect("\"null\" string", reader.previousRow() && reader.column(1).type == JsonScalar::String &&
+                                  reader.column(1).isNull() && !jsonScalarToFloat(reader.column(1), value));
+    expect("JSON null", reader.previousRow() && reader.column(1).type == JsonScalar::Null &&
+                            reader.column(1).isNull() && !jsonScalarToFloat(reader.column(1), value));
+    expect("done", !reader.previousRow() && reader.ok());
+}
+
+static void testEmpty() {
+    JsonTailReader empty(std::string(" [ ] "));
+    expect("empty array is not an error", !empty.selectColumns({"time_tag"}) && empty.ok() && empty.empty());
+
+    std::string headerOnly = header + "]";
+    JsonTailReader reader(headerOnly);
+    expect("header only", reader.selectColumns({"time_tag", "speed"}) && !reader.previousRow() && reader.ok());
+}
+
+static void testTruncated() {
+    std::string full = header + ",[\"a\",\"1\"],[\"b\",\"2\"]]";
+    // Cut anywhere inside the array: an error, never rows
+    for (size_t size = 1; size < full.size(); ++size) {
+        JsonTailReader reader(full.data(), size);
+        size_t rows = 0;
+        if (reader.selectColumns({"time_tag", "speed"})) {
+            while (reader.previousRow()) ++rows;
+        }
+        if (reader.ok() || rows != 0) {
+            fprintf(stderr, "FAIL truncated at %zu: %s, %zu rows\n", size, reader.ok() ? "ok" : "error", rows);
+            ++failures;
+        }
+    }
+
+    // A broken row in the middle ends the walk with an error
+    std::string broken = header + ",[\"a\",\"1\"]x[\"b\",\"2\"]]";
+    JsonTailReader reader(broken);
+    reader.selectColumns({"time_tag", "speed"});
+    while (reader.previousRow()) {
+    }
+    expect("broken row is an error", !reader.ok());
+}
+
+static void testExtractor() {
+    TimeSeriesTable table(16, 1);
+    FieldSpec field{"speed", "speed", FieldType::Float, 1, noOscAddress, noOscAddress, noOscAddress};
+    FeedSpec spec{"test", "", FeedShape::Table, 60, 60, 0, 1, &table};
+    FeedExtractor extractor(spec, &field);
+    FeedValues latest;
+    std::vector<FeedRow> rows;
+
+    std::string body = header + ",[\"2024-05-10 17:00:00.000\",\"1\"],[\"2024-05-10 17:01:00.000\",\"2\"]]";
+    expect("table rows", extractor.extract(body, 0, 16, latest, rows) == FeedExtractor::Ok && rows.size() == 2);
+    expect("empty array is no data", extractor.extract("[]", 0, 16, latest, rows) == FeedExtractor::NoData);
+
+    std::string broken = header + ",[\"2024-05-10 17:00:00.000\",\"1\"]x[\"2024-05-10 17:01:00.000\",\"2\"]]";
+    expect("broken row is malformed",
+           extractor.extract(broken, 0, 16, latest, rows) == FeedExtractor::Malformed && rows.empty());
+    std::string truncated = body.substr(0, body.size() - 1);
+    expect("truncated is malformed",
+           extractor.extract(truncated, 0, 16, latest, rows) == FeedExtractor::Malformed && rows.empty());
+    // Cut right after the header, with the header already cached
+    expect("truncated after the cached header",
+           extractor.extract(header, 0, 16, latest, rows) == FeedExtractor::Malformed && rows.empty());
+}
+
+int main() {
+    testStringsWithBrackets();
+    testScalars();
+    testEmpty();
+    testTruncated();
+    testExtractor();
+    if (failures) return 1;
+    printf("json tail: ok\n");
+    return 0;
+}
@@ -0,0 +1,50 @@
+// solar-osc-tests: OSC address pattern matching for --dest and /subscribe
+// filters (run by ctest)
+
+#include <cstdio>
+#include <cstring>
+
+#include "../osc.h"
+
+static int failures = 0;
+
+static void expectMatch(const char* pattern, const char* address, bool expected) {
+    OSCPattern compiled;
+    bool matched = compiled.compile(pattern) && compiled.matches(address, strlen(address));
+    if (matched == expected) return;
+    fprintf(stderr, "FAIL %s %s %s\n", pattern, expected ? "should match" : "should not match", address);
+    ++failures;
+}
+
+static void testWithinPart() {
+    expectMatch("/{dens,speed}*", "/dens", true);
+    expectMatch("/{dens,speed}*", "/speed", true);
+    expectMatch("/{dens,speed}*", "/speed/sample", false);
+    expectMatch("/*/sample", "/bzGSM/sample", true);
+    expectMatch("/*/sample", "/derived/pdyn/sample", false);
+    expectMatch("/derived/*", "/derived/pdyn", true);
+    expectMatch("/derived/*", "/derived/pdyn/60m/mean", false);
+    expectMatch("/derived/*/60m/mean", "/derived/pdyn/60m/mean", true);
+    expectMatch("/b?GSM", "/bzGSM", true);
+    expectMatch("/bz?GSM", "/bz/GSM", false);
+    expectMatch("/bz[!a-z]GSM", "/bz/GSM", false);
+    expectMatch("/kp[0-9]", "/kp5", true);
+}
+
+static void testAcrossParts() {
+    expectMatch("/derived//mean", "/derived/pdyn/60m/mean", true);
+    expectMatch("/derived//mean", "/derived/mean", true);
+    expectMatch("/derived//*", "/derived/pdyn", true);
+    expectMatch("/derived//*", "/derived/pdyn/60m/max", true);
+    expectMatch("/derived//mean", "/derived/pdyn/60m/max", false);
+    expectMatch("//sample", "/bzGSM/sample", true);
+    expectMatch("//sample", "/bzGSM/smooth", false);
+}
+
+int main() {
+    testWithinPart();
+    testAcrossParts();
+    if (failures) return 1;
+    printf("osc pattern: ok\n");
+    return 0;
+}
@@ -0,0 +1,122 @@
+// solar-recorder-tests: recordings read back as they were written (run by
+// ctest)
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "../recorder.h"
+
+static int failures = 0;
+
+static void expect(const char* what, bool condition) {
+    if (condition) return;
+    fprintf(stderr, "FAIL %s\n", what);
+    ++failures;
+}
+
+static const char* const recordingPath = "recorder_test.rec";
+
+static RecordedResponse response(RecordedResponse::Kind kind, const char* feed, int64_t timeMillis,
+                                 const std::string& body) {
+    RecordedResponse r;
+    r.kind = kind;
+    r.feed = feed;
+    r.timeMillis = timeMillis;
+    r.body = body;
+    return r;
+}
+
+static bool same(const RecordedResponse& a, const RecordedResponse& b) {
+    return a.kind == b.kind && a.feed == b.feed && a.timeMillis == b.timeMillis && a.body == b.body;
+}
+
+static const RecordedResponse written[] = {
+    // First section: plasma gets id 0, mag id 1
+    response(RecordedResponse::Body, "plasma", 1000, "[[\"time_tag\"]]"),
+    response(RecordedResponse::Body, "mag", 1500, std::string("binary\0body", 11)),
+    response(RecordedResponse::NotModified, "plasma", 2000, ""),
+    // Second section, appended by a later run: the ids are announced again,
+    // the other way round
+    response(RecordedResponse::Failed, "mag", 3000, "timeout"),
+    response(RecordedResponse::Body, "plasma", 3500, "[]"),
+};
+static const size_t writtenCount = sizeof(written) / sizeof(written[0]);
+static const size_t firstSection = 3;
+
+static void writeRecording() {
+    std::remove(recordingPath);
+    FeedRecorder recorder;
+    expect("open", recorder.open(recordingPath));
+    for (size_t i = 0; i < firstSection; ++i) recorder.record(written[i]);
+    expect("record count", recorder.recordCount() == firstSection);
+    recorder.close();
+
+    FeedRecorder later;
+    expect("reopen to append", later.open(recordingPath));
+    for (size_t i = firstSection; i < writtenCount; ++i) later.record(written[i]);
+}
+
+static void testRoundTrip() {
+    writeRecording();
+    RecordingReader reader;
+    expect("open for reading", reader.open(recordingPath));
+    RecordedResponse r;
+    size_t n = 0;
+    while (reader.next(r)) {
+        if (n < writtenCount && !same(r, written[n])) {
+            fprintf(stderr, "FAIL record %zu: %s at %lld\n", n, r.feed.c_str(), (long long)r.timeMillis);
+            ++failures;
+        }
+        ++n;
+    }
+    expect("every record, both sections", n == writtenCount);
+    expect("clean end", reader.error().empty());
+}
+
+static void testTruncatedLastRecord() {
+    writeRecording();
+    std::string bytes;
+    {
+        std::ifstream in(recordingPath, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+
+    // Cut inside the last payload, then inside the last record header
+    const size_t cuts[] = {1, written[writtenCount - 1].body.size() + 4};
+    for (size_t cut : cuts) {
+        {
+            std::ofstream out(recordingPath, std::ios::binary | std::ios::trunc);
+            out.write(bytes.data(), (std::streamsize)(bytes.size() - cut));
+        }
+        RecordingReader reader;
+        reader.open(recordingPath);
+        RecordedResponse r;
+        size_t n = 0;
+        while (reader.next(r)) ++n;
+        if (n != writtenCount - 1 || reader.error().empty()) {
+            fprintf(stderr, "FAIL cut %zu bytes: %zu records, error \"%s\"\n", cut, n, reader.error().c_str());
+            ++failures;
+        }
+    }
+}
+
+static void testNotARecording() {
+    {
+        std::ofstream out(recordingPath, std::ios::binary | std::ios::trunc);
+        out << "[[\"time_tag\"]]";
+    }
+    RecordingReader reader;
+    expect("foreign file refused", !reader.open(recordingPath) && !reader.error().empty());
+}
+
+int main() {
+    testRoundTrip();
+    testTruncatedLastRecord();
+    testNotARecording();
+    std::remove(recordingPath);
+    if (failures) return 1;
+    printf("recorder: ok\n");
+    return 0;
+}
@@ -0,0 +1,139 @@
+#include "timeseries.h"
+
+#include <cmath>
+#include <limits>
+
+static bool readDigits(const char* p, int count, int& out) {
+    out = 0;
+    for (int i = 0; i < count; ++i) {
+        if (p[i] < '0' || p[i] > '9') return false;
+        out = out * 10 + (p[i] - '0');
+    }
+    return true;
+}
+
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's algorithm)
+static int64_t daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+bool parseTimeTag(const char* data, size_t size, int64_t& seconds) {
+    // YYYY-MM-DD HH:MM:SS, optionally followed by fractional seconds
+    if (size < 19 || data[4] != '-' || data[7] != '-' || (data[10] != ' ' && data[10] != 'T') ||
+        data[13] != ':' || data[16] != ':') {
+        return false;
+    }
+    int year, month, day, hour, minute, second;
+    if (!readDigits(data, 4, year) || !readDigits(data + 5, 2, month) || !readDigits(data + 8, 2, day) ||
+        !readDigits(data + 11, 2, hour) || !readDigits(data + 14, 2, minute) ||
+        !readDigits(data + 17, 2, second)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+        return false;
+    }
+    seconds = daysFromCivil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    return true;
+}
+
+TimeSeriesTable::TimeSeriesTable(size_t capacity, size_t fieldCount)
+    : capacity_(capacity ? capacity : 1),
+      fieldCount_(fieldCount),
+      watermark_(std::numeric_limits<int64_t>::min()),
+      times_(capacity_),
+      columns_(fieldCount, std::vector<float>(capacity_)) {}
+
+bool TimeSeriesTable::append(int64_t time, const float* values) {
+    if (time <= watermark_) return false;
+
+    size_t slot;
+    if (size_ < capacity_) {
+        slot = physical(size_);
+        ++size_;
+    } else {
+        // Full: overwrite the oldest row
+        slot = head_;
+        head_ = (head_ + 1) % capacity_;
+    }
+    times_[slot] = time;
+    for (size_t f = 0; f < fieldCount_; ++f) {
+        columns_[f][slot] = values[f];
+    }
+    watermark_ = time;
+    return true;
+}
+
+size_t TimeSeriesTable::lowerBound(int64_t since) const {
+    size_t lo = 0, hi = size_;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (timeAt(mid) < since) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+WindowStats TimeSeriesTable::recentStats(size_t field, int64_t seconds) const {
+    // watermark() is INT64_MIN while empty: no window to subtract from
+    if (size_ == 0) return WindowStats();
+    return stats(field, watermark_ - seconds);
+}
+
+WindowStats TimeSeriesTable::stats(size_t field, int64_t since) const {
+    WindowStats result;
+    if (field >= fieldCount_ || size_ == 0) return result;
+
+    size_t begin = lowerBound(since);
+    if (begin == size_) return result;
+
+    const float* column = columns_[field].data();
+    double sum = 0.0;
+    float lo = std::numeric_limits<float>::infinity();
+    float hi = -std::numeric_limits<float>::infinity();
+
+    // The window is at most two contiguous spans of the ring
+    size_t first = physical(begin);
+    size_t last = physical(size_ - 1) + 1;
+    bool wraps = first >= last;
+    size_t spans[2][2] = {{first, wraps ? capacity_ : last}, {0, wraps ? last : 0}};
+
+    for (const auto& span : spans) {
+        for (size_t i = span[0]; i < span[1]; ++i) {
+            float v = column[i];
+            if (std::isnan(v)) continue;
+            sum += v;
+            lo = v < lo ? v : lo;
+            hi = v > hi ? v : hi;
+            ++result.count;
+        }
+    }
+    if (result.count > 0) {
+        result.min = lo;
+        result.max = hi;
+        result.mean = (float)(sum / result.count);
+    }
+    return result;
+}
+
+size_t TimeSeriesTable::copyWindow(size_t field, int64_t since, int64_t* times, float* values, size_t maxRows) const {
+    if (field >= fieldCount_) return 0;
+    size_t begin = lowerBound(since);
+    // Keep the newest rows if the window is larger than the output
+    if (size_ - begin > maxRows) begin = size_ - maxRows;
+
+    size_t written = 0;
+    for (size_t i = begin; i < size_; ++i, ++written) {
+        size_t p = physical(i);
+        if (times) times[written] = times_[p];
+        if (values) values[written] = columns_[field][p];
+    }
+    return written;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// "2024-05-10 12:34:00.000" (UTC) -> Unix seconds
+bool parseTimeTag(const char* data, size_t size, int64_t& seconds);
+
+struct WindowStats {
+    size_t count = 0;   // valid samples in the window
+    float min = 0.0f;
+    float max = 0.0f;
+    float mean = 0.0f;
+};
+
+// Fixed-capacity ring of samples for one NOAA product, stored as columns:
+// one time array plus one float array per field, so window queries walk
+// contiguous memory. Rows are keyed by time_tag and only rows newer than
+// the watermark are accepted; missing values are stored as NaN.
+class TimeSeriesTable {
+public:
+    TimeSeriesTable(size_t capacity, size_t fieldCount);
+
+    // Newest time_tag stored so far (INT64_MIN when empty)
+    int64_t watermark() const { return watermark_; }
+
+    // Rejects rows at or before the watermark; returns true if stored
+    bool append(int64_t time, const float* values);
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    size_t fieldCount() const { return fieldCount_; }
+
+    // i = 0 is the oldest stored row
+    int64_t timeAt(size_t i) const { return times_[physical(i)]; }
+    float valueAt(size_t field, size_t i) const { return columns_[field][physical(i)]; }
+
+    // min/max/mean of one field over rows with time >= since, O(window)
+    WindowStats stats(size_t field, int64_t since) const;
+    // The same over the last seconds up to the newest row; empty for an empty table
+    WindowStats recentStats(size_t field, int64_t seconds) const;
+
+    // Copies rows with time >= since, oldest first; returns rows written
+    size_t copyWindow(size_t field, int64_t since, int64_t* times, float* values, size_t maxRows) const;
+
+private:
+    size_t physical(size_t i) const { return (head_ + i) % capacity_; }
+    // First logical index with time >= since (binary search, times are sorted)
+    size_t lowerBound(int64_t since) const;
+
+    size_t capacity_;
+    size_t fieldCount_;
+    size_t head_ = 0;   // physical index of the oldest row
+    size_t size_ = 0;
+    int64_t watermark_;
+    std::vector<int64_t> times_;
+    std::vector<std::vector<float>> columns_;
+};